@@ -345,8 +345,8 @@ struct HashBookAnalyzer{
     
 #ifdef USE_ANALYZER
     const std::string name;
-    const uint64_t entry;
-    const uint64_t memory;
+    uint64_t entry;
+    uint64_t memory;
     
     // state
     std::atomic<uint64_t> filled;
@@ -367,6 +367,11 @@ struct HashBookAnalyzer{
         registration = 0; registrationFailure = 0;
     }
     
+    void setSize(const uint64_t aent, const uint64_t amem)noexcept{
+        entry = aent; memory = amem;
+    }
+    void resetFilled()noexcept{ filled = 0; }
+    
     void addFilled()noexcept{ ++filled; }
     void addDeleted()noexcept{ ++deleted; }
     
@@ -383,7 +388,8 @@ struct HashBookAnalyzer{
         double idealRate = 1.0 - pow((double)((double)(1.0 - 1.0) / (double)entry), (double)registration);
         cerr << "****** Analysis(HashBook) of " << name;
         cerr << " (" << entry << " entries, " << memory << " bytes) ******" << endl;
-        cerr << "State  : filled = " << realRate << " ( ideally... " << idealRate << " )" << endl;
+        cerr << "State  : filled = " << realRate << " ( ideally... " << idealRate << " )";
+        cerr << "  deleted = " << deleted << endl;
         cerr << "Regist : success = " << registration << "  failure = " << registrationFailure << endl;
         cerr << "Read   : hit = " << hit << "  unfounded = " << unfounded << "  white = " << white << endl;
     }
@@ -392,6 +398,9 @@ struct HashBookAnalyzer{
     
     void init()const noexcept{}
     
+    void setSize(const uint64_t aent, const uint64_t amem)const noexcept{}
+    void resetFilled()const noexcept{}
+    
     void addFilled()const noexcept{}
     void addDeleted()const noexcept{}
     
@@ -113,6 +113,7 @@ sfmt_init_gen_rand(&sfmt,s);
 
 // 並列化
 #include "util/lock.hpp"
+#include "util/thread.hpp"
 
 // 置換表
 #include "util/node.hpp"
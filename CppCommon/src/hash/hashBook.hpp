@@ -9,10 +9,23 @@
 // ハッシュによる置換表
 // 用途により様々なタイプを用意しておくつもり
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "../analyze/analyzer.hpp"
 
 class TwoValuePage32{
 public:
+    void clear()noexcept{ data_.store(0, std::memory_order_relaxed); }
     uint32_t any()const noexcept{ return data_; }
     void setHash(const uint64_t hash)noexcept{ data_ = (uint32_t)(hash >> 32); }
     void setResult(const uint32_t res)noexcept{
@@ -29,6 +42,7 @@ private:
 
 class TwoValuePage64{
 public:
+    void clear()noexcept{ data_.store(0, std::memory_order_relaxed); }
     uint64_t any()const noexcept{ return data_; }
     void setHash(const uint64_t hash)noexcept{ data_ = hash; }
     void setResult(const uint64_t res)noexcept{
@@ -54,7 +68,7 @@ public:
     using page_t = TwoValuePage32;
     
     void init(){
-        memset(page_, 0, sizeof(page_));
+        for(page_t& page : page_){ page.clear(); }
     }
     
     TwoValueBook(){
@@ -106,6 +120,320 @@ private:
     }
 };
 
+template<class packing_t>
+class BucketBook{
+    // 複数スレッドで共有するハッシュ表
+    // 4エントリで64バイト(キャッシュライン1本)のバケットを作る4ウェイセットアソシアティブ
+    // エントリはキー語と値語の2語からなり、キー語には (ハッシュ値 ^ 値語) を書く
+    // 読み出し時に2語の排他的論理和がハッシュ値に戻るかを確かめるので、
+    // ロックなしで書き込み途中のエントリや別のキーの値を読んでも取り違えない
+    // 置き換え先は 同じキー > 空き > (登録時の仕事量 - 経過世代数 * AGE_WEIGHT) が最小 の順に選ぶ
+    // 大きさは実行時に決め、Linuxでは透過的ヒュージページを使うよう指定できる
+    // ファイルに書き出しておき、次の起動時にメモリマップして再開できる
+    // 結果を値語にどう詰めるかは packing_t で決める(TwoValuePacking, BitPacking)
+public:
+    using value_t = typename packing_t::value_t;
+    static constexpr int RESULT_BITS = 50; // 値語のうち結果に使えるビット数
+    static_assert(packing_t::BITS <= RESULT_BITS, "BucketBook : packing_t::BITS");
+    
+    static constexpr int WAYS = 4;
+    static constexpr int AGE_WEIGHT = 4;
+    // 世代は8ビットで一周するので、AGE_SWEEP_INTERVAL 世代ごとに表を見回り、
+    // 経過世代数が AGE_LIMIT を超えたエントリを AGE_LIMIT に揃える
+    // 経過世代数は一周する前に AGE_LIMIT から AGE_LIMIT + AGE_SWEEP_INTERVAL の間で頭打ちになる
+    static constexpr uint32_t AGE_LIMIT = 128;
+    static constexpr uint32_t AGE_SWEEP_INTERVAL = 64;
+    
+    BucketBook(const std::string& argName, const uint64_t bytes, const bool hugePage = false)
+    :ana(argName, 0, 0), bucket_(nullptr), mask_(0), hugePage_(false),
+    mapped_(nullptr), mappedBytes_(0), generation_(0)
+    {
+        resize(bytes, hugePage);
+    }
+    
+    ~BucketBook(){
+        release();
+    }
+    
+    // 2のべき乗個のバケットで bytes 以下の最大の大きさにする
+    // 大きさが変わらなければ何もしない
+    void resize(const uint64_t bytes, const bool hugePage = false){
+        uint64_t buckets = 1;
+        while(buckets * 2 * sizeof(Bucket) <= bytes){ buckets *= 2; }
+        if(bucket_ != nullptr && buckets == mask_ + 1 && (hugePage == hugePage_ || mapped_ != nullptr)){ return; }
+        release();
+        const uint64_t size = buckets * sizeof(Bucket);
+        bucket_ = static_cast<Bucket*>(_mm_malloc(size, hugePage ? (1 << 21) : sizeof(Bucket)));
+        if(bucket_ == nullptr){ return; }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if(hugePage){ madvise(bucket_, size, MADV_HUGEPAGE); }
+#endif
+        mask_ = buckets - 1;
+        hugePage_ = hugePage;
+        ana.setSize(buckets * WAYS, size);
+        init();
+    }
+    
+    void init(){
+        if(bucket_ != nullptr){
+            memset((void*)bucket_, 0, (mask_ + 1) * sizeof(Bucket));
+        }
+        generation_ = 0;
+        ana.resetFilled();
+    }
+    
+    // 世代を進める(着手決定ごとなど)
+    // 古い世代のエントリは置き換えられやすくなる
+    void nextGeneration()noexcept{
+        const uint32_t gen = (generation_ + 1) & GEN_MASK;
+        generation_ = gen;
+        if(!(gen % AGE_SWEEP_INTERVAL)){ clampAges(gen); }
+    }
+    
+    value_t read(const uint64_t hash)noexcept{
+        if(bucket_ == nullptr){ return packing_t::EMPTY; }
+        const Bucket& b = bucket_[hash & mask_];
+        bool occupied = false;
+        for(const Entry& e : b.entry){
+            const uint64_t data = e.data.load(std::memory_order_relaxed);
+            const uint64_t key = e.key.load(std::memory_order_relaxed);
+            if(!(data & VALID)){ continue; }
+            if((key ^ data) == hash){ // 結果が記入されている
+                ana.addHit();
+                return packing_t::unpack(data >> RESULT_SHIFT);
+            }
+            occupied = true;
+        }
+        if(occupied){ // 他のキーで埋まっている
+            ana.addUnfounded();
+        }else{
+            ana.addWhite();
+        }
+        return packing_t::EMPTY;
+    }
+    
+    // nodes は結果を得るのにかかった探索ノード数
+    void regist(const value_t value, const uint64_t hash, const uint64_t nodes = 0)noexcept{
+        if(bucket_ == nullptr){ return; }
+        store(hash, packData(packing_t::pack(value), generation_, nodes));
+    }
+    
+    uint64_t bytes()const noexcept{
+        return bucket_ == nullptr ? 0 : (mask_ + 1) * sizeof(Bucket);
+    }
+    
+    // ファイルへの書き出しと読み込み
+    // tag にはハッシュ値の定義を表す値を入れ、違うものは読み込まない
+    // 読み込みは大きさが同じならファイルをそのままメモリマップし(書き込みはファイルに反映しない)、
+    // 違えば今の表に登録し直す
+    // 他のスレッドが読み書きしていない時に呼ぶこと
+    bool save(const std::string& path, const uint64_t tag)const{
+        if(bucket_ == nullptr){ return false; }
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, packing_t::fileMagic(), sizeof(header.magic));
+        header.version = FILE_VERSION;
+        header.generation = generation_;
+        header.tag = tag;
+        header.buckets = mask_ + 1;
+        // 読み込んだファイルをマップしたまま書き出すこともあるので別名で書いてから置き換える
+        const std::string tmpPath = path + ".tmp";
+        std::ofstream ofs(tmpPath, std::ios::binary);
+        if(!ofs){ return false; }
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(bucket_), bytes());
+        ofs.close();
+        if(!ofs){
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        return rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+    bool load(const std::string& path, const uint64_t tag){
+        const int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0){ return false; }
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FileHeader)){
+            ::close(fd);
+            return false;
+        }
+        void *const p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED){ return false; }
+        const FileHeader *const header = static_cast<const FileHeader*>(p);
+        if(memcmp(header->magic, packing_t::fileMagic(), sizeof(header->magic))
+           || header->version != FILE_VERSION || header->tag != tag
+           || header->buckets == 0 || (header->buckets & (header->buckets - 1))
+           || (uint64_t)st.st_size != sizeof(FileHeader) + header->buckets * sizeof(Bucket)){
+            munmap(p, st.st_size);
+            return false;
+        }
+        Bucket *const loaded = reinterpret_cast<Bucket*>(static_cast<uint8_t*>(p) + sizeof(FileHeader));
+        if(bucket_ == nullptr || header->buckets == mask_ + 1){
+            // そのまま使う
+            const uint32_t gen = header->generation;
+            const uint64_t buckets = header->buckets;
+            release();
+            bucket_ = loaded;
+            mask_ = buckets - 1;
+            mapped_ = p;
+            mappedBytes_ = st.st_size;
+            generation_ = gen;
+            ana.setSize(buckets * WAYS, bytes());
+            ana.resetFilled();
+        }else{
+            // 今の大きさの表に登録し直す
+            // エントリは保存時の世代を持っているので、世代も保存時のものから続ける
+            generation_ = header->generation & GEN_MASK;
+            for(uint64_t i = 0; i < header->buckets; ++i){
+                for(const Entry& e : loaded[i].entry){
+                    const uint64_t data = e.data.load(std::memory_order_relaxed);
+                    if(data & VALID){
+                        store(e.key.load(std::memory_order_relaxed) ^ data, data);
+                    }
+                }
+            }
+            munmap(p, st.st_size);
+        }
+        return true;
+    }
+    
+private:
+    
+    static constexpr uint32_t FILE_VERSION = 2;
+    
+    struct FileHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t generation;
+        uint64_t tag;
+        uint64_t buckets;
+        uint8_t reserved[32];
+    };
+    static_assert(sizeof(FileHeader) == 64, "file header must keep buckets aligned");
+    
+    void store(const uint64_t hash, const uint64_t newData)noexcept{
+        Bucket& b = bucket_[hash & mask_];
+        const uint32_t gen = generation_;
+        Entry *victim = nullptr;
+        int victimValue = INT_MAX;
+        for(Entry& e : b.entry){
+            const uint64_t data = e.data.load(std::memory_order_relaxed);
+            const uint64_t key = e.key.load(std::memory_order_relaxed);
+            int value;
+            if(!(data & VALID)){
+                value = INT_MIN;
+            }else if((key ^ data) == hash){ // 同じキーは上書き
+                victim = &e;
+                victimValue = INT_MAX;
+                break;
+            }else{
+                const int age = (gen - dataGeneration(data)) & GEN_MASK;
+                value = dataWork(data) - AGE_WEIGHT * age;
+            }
+            if(victim == nullptr || value < victimValue){
+                victim = &e;
+                victimValue = value;
+            }
+        }
+        if(victimValue == INT_MIN){
+            ana.addFilled();
+        }else if(victimValue != INT_MAX){
+            ana.addDeleted();
+        }
+        victim->data.store(newData, std::memory_order_relaxed);
+        victim->key.store(hash ^ newData, std::memory_order_relaxed);
+        ana.addRegistration();
+    }
+    
+    void clampAges(const uint32_t gen)noexcept{
+        // 経過世代数が AGE_LIMIT を超えたエントリの世代を書き換える
+        if(bucket_ == nullptr){ return; }
+        const uint64_t limitGen = (gen - AGE_LIMIT) & GEN_MASK;
+        for(uint64_t i = 0; i <= mask_; ++i){
+            for(Entry& e : bucket_[i].entry){
+                const uint64_t data = e.data.load(std::memory_order_relaxed);
+                if(!(data & VALID) || ((gen - dataGeneration(data)) & GEN_MASK) <= AGE_LIMIT){ continue; }
+                const uint64_t hash = e.key.load(std::memory_order_relaxed) ^ data;
+                const uint64_t newData = (data & ~(GEN_MASK << GEN_SHIFT)) | (limitGen << GEN_SHIFT);
+                e.data.store(newData, std::memory_order_relaxed);
+                e.key.store(hash ^ newData, std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    // 値語
+    // 0 登録済み, 1-8 世代, 9-13 仕事量(ノード数のビット長、31で頭打ち), 14-63 結果
+    static constexpr uint64_t VALID = 1ULL;
+    static constexpr int GEN_SHIFT = 1;
+    static constexpr uint64_t GEN_MASK = 0xFF;
+    static constexpr int WORK_SHIFT = 9;
+    static constexpr uint64_t WORK_MASK = 0x1F;
+    static constexpr int RESULT_SHIFT = 14;
+    
+    static uint64_t packData(const uint64_t result, const uint32_t gen, const uint64_t nodes)noexcept{
+        assert(!(result >> RESULT_BITS));
+        const uint64_t bitLength = nodes ? (64 - __builtin_clzll(nodes)) : 0;
+        const uint64_t work = bitLength < WORK_MASK ? bitLength : WORK_MASK;
+        return VALID | ((uint64_t)gen << GEN_SHIFT) | (work << WORK_SHIFT) | (result << RESULT_SHIFT);
+    }
+    static uint32_t dataGeneration(const uint64_t data)noexcept{ return (data >> GEN_SHIFT) & GEN_MASK; }
+    static int dataWork(const uint64_t data)noexcept{ return (data >> WORK_SHIFT) & WORK_MASK; }
+    
+    struct Entry{
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> data;
+    };
+    struct alignas(64) Bucket{
+        Entry entry[WAYS];
+    };
+    static_assert(sizeof(Bucket) == 64, "bucket must fit in a cache line");
+    
+    HashBookAnalyzer ana;
+    
+    Bucket *bucket_;
+    uint64_t mask_;
+    bool hugePage_;
+    void *mapped_; // ファイルから読み込んだ場合のマップ領域
+    uint64_t mappedBytes_;
+    std::atomic<uint32_t> generation_;
+    
+    void release(){
+        if(mapped_ != nullptr){
+            munmap(mapped_, mappedBytes_);
+            mapped_ = nullptr;
+            mappedBytes_ = 0;
+        }else if(bucket_ != nullptr){
+            _mm_free(bucket_);
+        }
+        bucket_ = nullptr;
+        mask_ = 0;
+    }
+};
+
+struct TwoValuePacking{
+    // 2(+中間1)値を2ビットで持つ
+    // 値1...1
+    // 値2...2
+    // 中間値...0
+    // 未登録...-1
+    using value_t = int;
+    static constexpr int BITS = 2;
+    static constexpr int EMPTY = -1;
+    
+    static uint64_t pack(const int result)noexcept{
+        assert(0 <= result && result <= 3);
+        return (uint64_t)result;
+    }
+    static int unpack(const uint64_t bits)noexcept{ return bits & 3ULL; }
+    static const char *fileMagic()noexcept{
+        static const char magic[8] = {'T', 'V', 'B', 'B', 'O', 'O', 'K', 0};
+        return magic;
+    }
+};
+
+using TwoValueBucketBook = BucketBook<TwoValuePacking>;
+
 template<int N_BITS>
 class BitPage{
     // Nビットを保存する形式
@@ -115,6 +443,7 @@ public:
     
     constexpr uint64_t any()const noexcept{ return data_; }
     void set(const uint64_t arg)noexcept{ data_ = arg; }
+    void clear()noexcept{ data_.store(0, std::memory_order_relaxed); }
     constexpr uint64_t cmpHash(const uint64_t hash)const noexcept{
         return (data_ ^ hash) & (~MASK);
     }
@@ -139,7 +468,7 @@ private:
 public:
     
     void init(){
-        memset(page_, 0, sizeof(BitPage<N_BITS>) * SIZE);
+        for(BitPage<N_BITS>& page : page_){ page.clear(); }
     }
     
     BitBook(){
@@ -179,6 +508,30 @@ public:
     }
 };
 
+template<int N_BITS>
+struct BitPacking{
+    // N_BITS ビットの結果をそのまま持つ
+    // 結果 0 は未登録と区別できないので登録しないこと
+    // 未登録...0
+    using value_t = uint64_t;
+    static constexpr int BITS = N_BITS;
+    static constexpr uint64_t MASK = (1ULL << N_BITS) - 1ULL;
+    static constexpr uint64_t EMPTY = 0ULL;
+    
+    static uint64_t pack(const uint64_t bits)noexcept{
+        assert(bits != 0ULL && !(bits & ~MASK));
+        return bits;
+    }
+    static uint64_t unpack(const uint64_t bits)noexcept{ return bits & MASK; }
+    static const char *fileMagic()noexcept{
+        static const char magic[8] = {'B', 'T', 'B', 'B', 'O', 'O', 'K', 0};
+        return magic;
+    }
+};
+
+template<int N_BITS>
+using BitBucketBook = BucketBook<BitPacking<N_BITS>>;
+
 template<class _data_t>
 struct HashData{
     
@@ -58,6 +58,23 @@ uint64_t crossHash(const uint64_t h[]){
     return crossBits64<N>(h);
 }
 
+/**************************回転ハッシュ**************************/
+
+// 交叉では1つあたりのビット数が 64 / N に減るので、
+// 数が多い場合は順番ごとに回転させて重ね、全ビットを使う
+constexpr uint64_t rotateHash(uint64_t h, int n)noexcept{
+    return (h << n) | (h >> (64 - n));
+}
+constexpr uint64_t stackHash(uint64_t h0, uint64_t h1, uint64_t h2)noexcept{
+    return h0 ^ rotateHash(h1, 21) ^ rotateHash(h2, 42);
+}
+constexpr uint64_t stackHash(uint64_t h0, uint64_t h1, uint64_t h2, uint64_t h3)noexcept{
+    return h0 ^ rotateHash(h1, 16) ^ rotateHash(h2, 32) ^ rotateHash(h3, 48);
+}
+constexpr uint64_t stackHash(uint64_t h0, uint64_t h1, uint64_t h2, uint64_t h3, uint64_t h4)noexcept{
+    return h0 ^ rotateHash(h1, 13) ^ rotateHash(h2, 26) ^ rotateHash(h3, 39) ^ rotateHash(h4, 52);
+}
+
 // 部分生成
 template<int N>
 constexpr uint64_t genPartCrossedHash(const int n, const uint64_t hash)noexcept{
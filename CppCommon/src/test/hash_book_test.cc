@@ -0,0 +1,306 @@
+/*
+ hash_book_test.cc
+ Katsuki Ohto
+ */
+
+// 複数スレッド共有のバケット置換表のテスト
+// 登録と読み出し、置き換え方針、並列書き込み時の整合性を確認し、
+// 容量を超えたときに残る結果の割合を単純な置換表と比較する
+
+#include <cstring>
+#include <unistd.h>
+#include <sys/time.h>
+#include <ctime>
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <random>
+
+#include "../defines.h"
+#include "../hash/hashBook.hpp"
+
+using namespace std;
+
+// キーから決まる登録値
+int resultOf(uint64_t key){
+    return (key >> 40) % 3;
+}
+
+int testReadWrite(){
+    // 容量に余裕がある場合は登録したものが全て読めるか
+    TwoValueBucketBook book("test", 1 << 20);
+    std::mt19937_64 mt(1);
+    std::vector<uint64_t> keys;
+    for(int i = 0; i < 1000; ++i){
+        keys.push_back(mt());
+        book.regist(resultOf(keys.back()), keys.back());
+    }
+    for(uint64_t key : keys){
+        if(book.read(key) != resultOf(key)){
+            cerr << "could not read key " << key << endl;
+            return -1;
+        }
+    }
+    for(int i = 0; i < 1000; ++i){
+        if(book.read(mt()) != -1){
+            cerr << "read unregistered key" << endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int testBitBucketBook(){
+    // 多ビットの値を登録して、世代を進めても同じ値が読めるか
+    BitBucketBook<50> book("test", 1 << 20);
+    std::mt19937_64 mt(1);
+    std::vector<std::pair<uint64_t, uint64_t>> entries;
+    for(int i = 0; i < 1000; ++i){
+        const uint64_t key = mt();
+        const uint64_t bits = (mt() & ((1ULL << 50) - 1)) | 1ULL;
+        entries.emplace_back(key, bits);
+        book.regist(bits, key, i);
+    }
+    book.nextGeneration();
+    for(const auto& e : entries){
+        if(book.read(e.first) != e.second){
+            cerr << "could not read key " << e.first << endl;
+            return -1;
+        }
+    }
+    for(int i = 0; i < 1000; ++i){
+        if(book.read(mt()) != 0){
+            cerr << "read unregistered key" << endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int testReplacement(){
+    // 同じバケットに入るキーでは仕事量の少ないエントリから置き換えられるか
+    TwoValueBucketBook book("test", 1 << 12);
+    const uint64_t buckets = book.bytes() / 64;
+    std::vector<uint64_t> keys;
+    for(int i = 0; i < 5; ++i){
+        keys.push_back(((uint64_t)(i + 1) << 32) * buckets + 7);
+    }
+    book.regist(0, keys[0], 1000000);
+    book.regist(1, keys[1], 100000);
+    book.regist(2, keys[2], 1);
+    book.regist(0, keys[3], 10000);
+    book.regist(1, keys[4], 1000);
+    if(book.read(keys[2]) != -1){
+        cerr << "entry with least work was not replaced" << endl;
+        return -1;
+    }
+    if(book.read(keys[0]) != 0 || book.read(keys[1]) != 1 || book.read(keys[3]) != 0 || book.read(keys[4]) != 1){
+        cerr << "wrong entry was replaced" << endl;
+        return -1;
+    }
+    // 十分古くなった結果は仕事量が多くても置き換えられる
+    for(int g = 0; g < 8; ++g){ book.nextGeneration(); }
+    book.regist(2, keys[2], 1);
+    if(book.read(keys[2]) != 2 || book.read(keys[4]) != -1){
+        cerr << "old entry was not replaced" << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int testAgeSaturation(){
+    // 世代が一周しても古いエントリが新しく見えないか
+    TwoValueBucketBook book("test", 1 << 12);
+    const uint64_t buckets = book.bytes() / 64;
+    std::vector<uint64_t> keys;
+    for(int i = 0; i < 5; ++i){
+        keys.push_back(((uint64_t)(i + 1) << 32) * buckets + 7);
+    }
+    for(int i = 0; i < 3; ++i){ book.regist(resultOf(keys[i]), keys[i], 1000); }
+    for(int g = 0; g < 250; ++g){ book.nextGeneration(); }
+    book.regist(resultOf(keys[3]), keys[3], 1000);
+    for(int g = 0; g < 50; ++g){ book.nextGeneration(); }
+    // 300世代前の3つのうちどれかが置き換えられ、50世代前のものは残る
+    book.regist(resultOf(keys[4]), keys[4], 1);
+    if(book.read(keys[3]) != resultOf(keys[3]) || book.read(keys[4]) != resultOf(keys[4])){
+        cerr << "newer entry was replaced after generation wrap-around" << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int testConcurrency(int threads){
+    // 並列に書き込み、読み出しをしても別のキーの値を返さないか
+    TwoValueBucketBook book("test", 1 << 16);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> thr;
+    for(int t = 0; t < threads; ++t){
+        thr.emplace_back([&book, &errors, t](){
+            std::mt19937_64 mt(t);
+            for(int i = 0; i < 200000; ++i){
+                const uint64_t key = mt() & 0xFFFFF00000003FFFULL; // 同じバケットに集める
+                if(i % 2){
+                    book.regist(resultOf(key), key, i % 1000);
+                }else{
+                    const int res = book.read(key);
+                    if(res != -1 && res != resultOf(key)){ errors += 1; }
+                }
+            }
+        });
+    }
+    for(auto& th : thr){ th.join(); }
+    if(errors){
+        cerr << errors << " wrong results" << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int testRetention(){
+    // 容量の2倍のキーを登録したときに残っている割合と誤ヒット数を単純な置換表と比較
+    // 10個に1個は探索ノード数が多かったものとし、それらが残っている割合も見る
+    constexpr int SIZE = 1 << 16;
+    static TwoValueBook<SIZE> oldBook;
+    TwoValueBucketBook book("test", SIZE * 16);
+    std::mt19937_64 mt(2);
+    std::vector<uint64_t> keys;
+    for(int i = 0; i < SIZE * 2; ++i){
+        keys.push_back(mt());
+        const uint64_t nodes = (i % 10 == 0) ? 100000 : 100;
+        oldBook.regist(resultOf(keys.back()), keys.back());
+        book.regist(resultOf(keys.back()), keys.back(), nodes);
+    }
+    int oldKept[2] = {0}, kept[2] = {0};
+    for(int i = 0; i < (int)keys.size(); ++i){
+        const int heavy = (i % 10 == 0) ? 1 : 0;
+        if(oldBook.read(keys[i]) == resultOf(keys[i])){ ++oldKept[heavy]; }
+        if(book.read(keys[i]) == resultOf(keys[i])){ ++kept[heavy]; }
+    }
+    int oldFalseHits = 0, falseHits = 0;
+    for(int i = 0; i < SIZE * 16; ++i){
+        const uint64_t key = mt();
+        if(oldBook.read(key) != -1){ ++oldFalseHits; }
+        if(book.read(key) != -1){ ++falseHits; }
+    }
+    const double heavyKeys = keys.size() / 10.0, lightKeys = keys.size() - heavyKeys;
+    cerr << "TwoValueBook       : kept = " << (oldKept[0] + oldKept[1]) / (double)keys.size();
+    cerr << " (heavy " << oldKept[1] / heavyKeys << ", light " << oldKept[0] / lightKeys << ")";
+    cerr << "  false hits = " << oldFalseHits << endl;
+    cerr << "TwoValueBucketBook : kept = " << (kept[0] + kept[1]) / (double)keys.size();
+    cerr << " (heavy " << kept[1] / heavyKeys << ", light " << kept[0] / lightKeys << ")";
+    cerr << "  false hits = " << falseHits << endl;
+    if(falseHits){ return -1; }
+    return 0;
+}
+
+int testSaveLoad(){
+    // 書き出した表を同じ大きさ、違う大きさの表に読み込んで同じ結果が得られるか
+    const std::string path = "/tmp/hash_book_test.dat";
+    const uint64_t tag = 0x123456789ULL;
+    TwoValueBucketBook book("test", 1 << 20);
+    std::mt19937_64 mt(3);
+    std::vector<uint64_t> keys;
+    for(int i = 0; i < 1000; ++i){
+        keys.push_back(mt());
+        book.regist(resultOf(keys.back()), keys.back());
+    }
+    book.nextGeneration();
+    if(!book.save(path, tag)){
+        cerr << "could not save book" << endl;
+        return -1;
+    }
+    for(uint64_t bytes : {1 << 20, 1 << 21}){
+        TwoValueBucketBook loaded("test", bytes);
+        if(!loaded.load(path, tag)){
+            cerr << "could not load book (" << bytes << " bytes)" << endl;
+            return -1;
+        }
+        if(loaded.bytes() != bytes){
+            cerr << "book size changed to " << loaded.bytes() << endl;
+            return -1;
+        }
+        for(uint64_t key : keys){
+            if(loaded.read(key) != resultOf(key)){
+                cerr << "could not read key " << key << " after load (" << bytes << " bytes)" << endl;
+                return -1;
+            }
+        }
+        // 読み込んだ後も書き込めるか
+        const uint64_t key = mt();
+        loaded.regist(resultOf(key), key);
+        if(loaded.read(key) != resultOf(key)){
+            cerr << "could not write to loaded book" << endl;
+            return -1;
+        }
+        // 読み込んだファイルに上書きできるか
+        if(!loaded.save(path, tag)){
+            cerr << "could not save loaded book (" << bytes << " bytes)" << endl;
+            return -1;
+        }
+    }
+    TwoValueBucketBook other("test", 1 << 20);
+    if(other.load(path, tag + 1)){
+        cerr << "loaded book with different tag" << endl;
+        return -1;
+    }
+    unlink(path.c_str());
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    
+    if(testReadWrite()){
+        cerr << "failed read write test." << endl;
+        return -1;
+    }
+    cerr << "passed read write test." << endl;
+    
+    if(testBitBucketBook()){
+        cerr << "failed bit bucket book test." << endl;
+        return -1;
+    }
+    cerr << "passed bit bucket book test." << endl;
+    
+    if(testReplacement()){
+        cerr << "failed replacement test." << endl;
+        return -1;
+    }
+    cerr << "passed replacement test." << endl;
+    
+    if(testAgeSaturation()){
+        cerr << "failed age saturation test." << endl;
+        return -1;
+    }
+    cerr << "passed age saturation test." << endl;
+    
+    for(int t : {1, 2, 4, 8}){
+        if(testConcurrency(t)){
+            cerr << "failed concurrency test. (" << t << " threads)" << endl;
+            return -1;
+        }
+    }
+    cerr << "passed concurrency test." << endl;
+    
+    if(testRetention()){
+        cerr << "failed retention test." << endl;
+        return -1;
+    }
+    cerr << "passed retention test." << endl;
+    
+    if(testSaveLoad()){
+        cerr << "failed save load test." << endl;
+        return -1;
+    }
+    cerr << "passed save load test." << endl;
+    
+    return 0;
+}
@@ -24,7 +24,69 @@ int testProbCalculation(selector_t& selector){
     return 0;
 }
 
+int testFastExp(){
+    // 近似指数関数の相対誤差が保証値以内か
+    double maxError = 0;
+    for(double x = -700; x <= 700; x += 0.0137){
+        maxError = max(maxError, fabs(fastExp(x) / exp(x) - 1));
+#ifdef __SSE4_1__
+        double v[2];
+        _mm_storeu_pd(v, fastExp(_mm_set_pd(-x, x)));
+        maxError = max(maxError, fabs(v[0] / exp(x) - 1));
+        maxError = max(maxError, fabs(v[1] / exp(-x) - 1));
+#endif
+    }
+    cerr << "fastExp max relative error = " << maxError << endl;
+    if(maxError > FAST_EXP_MAX_RELATIVE_ERROR){ return -1; }
+    return 0;
+}
+
+template<class selector_t, class... args_t>
+int testFastProbCalculation(const std::vector<double>& test, args_t... args){
+    // 高速版と通常版の確率計算の比較
+    constexpr int N = 100000;
+    std::vector<double> prob, fastProb, tmp;
+    Clock cl;
+    
+    cl.start();
+    for(int i = 0; i < N; ++i){
+        tmp = test;
+        selector_t selector(tmp.data(), tmp.size(), args...);
+        selector.amplify();
+        selector.to_prob();
+        if(i == N - 1){ selector.to_real_prob(); }
+    }
+    const uint64_t calcTime = cl.stop();
+    prob = tmp;
+    
+    cl.start();
+    for(int i = 0; i < N; ++i){
+        tmp = test;
+        selector_t selector(tmp.data(), tmp.size(), args...);
+        selector.amplify_fast();
+        selector.to_prob_fast();
+        if(i == N - 1){ selector.to_real_prob(); }
+    }
+    const uint64_t fastCalcTime = cl.stop();
+    fastProb = tmp;
+    
+    double maxError = 0;
+    for(int i = 0; i < (int)test.size(); ++i){
+        maxError = max(maxError, fabs(fastProb[i] / prob[i] - 1));
+    }
+    cerr << "max relative error = " << maxError;
+    cerr << " calculation time = " << calcTime << " -> " << fastCalcTime << endl;
+    if(maxError > 2 * FAST_EXP_MAX_RELATIVE_ERROR / (1 - FAST_EXP_MAX_RELATIVE_ERROR) + 1e-12){ return -1; }
+    return 0;
+}
+
 int main(int argc, char* argv[]){
+    
+    if(testFastExp()){
+        cerr << "failed fast exp test." << endl;
+        return -1;
+    }
+    cerr << "passed fast exp test." << endl;
 
     // 得点セット
     std::vector<double> test0 = {0, -1, -2, -3, -4, -5, -6, -7};
@@ -60,6 +122,20 @@ int main(int argc, char* argv[]){
             testProbCalculation(selector);
         }
         
+        // 高速版
+        {
+            cerr << "Fast Biased Softmax : " << endl;
+            if(testFastProbCalculation<BiasedSoftmaxSelector>(test, 1.1, 0.22, 2.0)){
+                cerr << "failed fast biased softmax test." << endl;
+                return -1;
+            }
+            cerr << "Fast Exp-Biased Softmax : " << endl;
+            if(testFastProbCalculation<ExpBiasedSoftmaxSelector>(test, 1.1, 0.22, 1 / log(2))){
+                cerr << "failed fast exp-biased softmax test." << endl;
+                return -1;
+            }
+        }
+        
         // sparsemax
         {
             auto tmp_test = test;
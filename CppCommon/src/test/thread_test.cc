@@ -0,0 +1,180 @@
+/*
+ thread_test.cc
+ Katsuki Ohto
+ */
+
+// 常駐ワーカースレッド群のテスト
+// 毎回スレッドを生成してjoinする場合とジョブ投入までの遅延を比較する
+
+#include <cstring>
+#include <unistd.h>
+#include <sys/time.h>
+#include <ctime>
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string>
+
+#include "../defines.h"
+#include "../util/thread.hpp"
+
+using namespace std;
+
+constexpr int N_MAX_WORKERS = 64;
+
+std::array<std::atomic<uint64_t>, N_MAX_WORKERS> counter;
+
+// 1回の着手決定を模した軽いジョブ
+void job(int index){
+    counter[index] += 1;
+}
+
+int testCorrectness(int workers, int jobs){
+    // 各ジョブで参加ワーカーがちょうど1回ずつ呼ばれるか
+    WorkerPool pool;
+    pool.start(workers);
+    for(auto& c : counter){ c = 0; }
+    for(int j = 0; j < jobs; ++j){
+        const int n = 1 + (j % workers); // 参加数も変えて試す
+        pool.run(n, job);
+    }
+    pool.stop();
+    for(int i = 0; i < workers; ++i){
+        uint64_t expected = 0;
+        for(int j = 0; j < jobs; ++j){
+            if(i < 1 + (j % workers)){ ++expected; }
+        }
+        if(counter[i] != expected){
+            cerr << "worker " << i << " ran " << counter[i] << " times (expected " << expected << ")" << endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+std::array<std::atomic<int>, N_MAX_WORKERS> cpuOfWorker;
+
+void recordCPU(int index){
+    cpuOfWorker[index] = sched_getcpu();
+}
+
+int testAffinity(int workers){
+    // CPU番号を指定して起動したとき、各ワーカーが指定のCPUで動いているか
+    // また呼び出し元スレッドの CPU の固定が元のままか
+    const int cpus = hardwareThreads();
+    cpu_set_t before, after;
+    pthread_getaffinity_np(pthread_self(), sizeof(before), &before);
+    WorkerPool pool;
+    pool.start(workers, 0);
+    pool.run(workers, recordCPU);
+    pthread_getaffinity_np(pthread_self(), sizeof(after), &after);
+    pool.stop();
+    for(int i = 0; i < workers; ++i){
+        if(cpuOfWorker[i] != i % cpus){
+            cerr << "worker " << i << " ran on cpu " << cpuOfWorker[i] << " (expected " << (i % cpus) << ")" << endl;
+            return -1;
+        }
+    }
+    if(!CPU_EQUAL(&before, &after)){
+        cerr << "caller thread affinity was changed" << endl;
+        return -1;
+    }
+    return 0;
+}
+
+struct alignas(64) PerThreadCounter{
+    std::atomic<uint64_t> count;
+};
+
+int testAlignedAllocator(){
+    // 動的に確保したスレッドごとの領域がキャッシュライン境界に揃っているか
+    for(int n : {1, 3, 8, 64}){
+        std::vector<PerThreadCounter, AlignedAllocator<PerThreadCounter>> v(n);
+        for(int i = 0; i < n; ++i){
+            if(reinterpret_cast<uintptr_t>(&v[i]) % 64 != 0){
+                cerr << "element " << i << " of " << n << " is not aligned" << endl;
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int testLatency(int workers, int decisions){
+    // 着手決定1回あたりのスレッド起動、終了待ちにかかる時間(microsec)
+    ClockMicS clms;
+
+    clms.start();
+    for(int d = 0; d < decisions; ++d){
+        std::vector<std::thread> thr;
+        for(int i = 0; i < workers; ++i){
+            thr.emplace_back(std::thread(job, i));
+        }
+        for(auto& th : thr){ th.join(); }
+    }
+    const double spawnTime = clms.stop() / (double)decisions;
+
+    WorkerPool pool;
+    pool.start(workers);
+    clms.start();
+    for(int d = 0; d < decisions; ++d){
+        pool.run(workers, job);
+    }
+    const double poolTime = clms.stop() / (double)decisions;
+    pool.stop();
+
+    cerr << workers << " workers : spawn & join = " << spawnTime << " micsec/decision";
+    cerr << "  pool = " << poolTime << " micsec/decision";
+    cerr << "  saved = " << (spawnTime - poolTime) << " micsec/decision" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+
+    int decisions = 10000;
+
+    for(int c = 1; c < argc; ++c){
+        if(!strcmp(argv[c], "-n")){
+            decisions = atoi(argv[c + 1]);
+        }
+    }
+
+    for(int w : {1, 2, 4, 8, 16}){
+        if(testCorrectness(w, 1000)){
+            cerr << "failed worker pool correctness test. (" << w << " workers)" << endl;
+            return -1;
+        }
+    }
+    cerr << "passed worker pool correctness test." << endl;
+
+    if(testAlignedAllocator()){
+        cerr << "failed aligned allocator test." << endl;
+        return -1;
+    }
+    cerr << "passed aligned allocator test." << endl;
+
+#ifdef __linux__
+    for(int w : {1, 2, 4, 8}){
+        if(testAffinity(w)){
+            cerr << "failed thread affinity test. (" << w << " workers)" << endl;
+            return -1;
+        }
+    }
+    cerr << "passed thread affinity test." << endl;
+#endif
+
+    for(int w : {1, 2, 4, 8, 16}){
+        testLatency(w, decisions);
+    }
+    cerr << "finished worker pool latency test." << endl;
+
+    return 0;
+}
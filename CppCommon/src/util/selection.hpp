@@ -10,9 +10,41 @@
 #include <vector>
 #include <cmath>
 
+#include "fmath.hpp"
+
 // 何らかの候補ごとの評価関数が与えられた場合に
 // そこから選択するための方法を実装
 
+static double calcFastSoftmaxWeights(double *const score, const int moves, const double temp){
+    // score を exp((score - 最大値) / temp) に置き換えて和を返す
+    // 重みの相対誤差は FAST_EXP_MAX_RELATIVE_ERROR (= e) 未満なので、
+    // 選択確率の相対誤差は 2e / (1 - e) 未満となる
+    double maxScore = -DBL_MAX;
+    for(int i = 0; i < moves; ++i){
+        maxScore = std::max(maxScore, score[i]);
+    }
+    const double itemp = 1 / temp;
+    double sum = 0;
+    int i = 0;
+#ifdef __SSE4_1__
+    const __m128d vmax = _mm_set1_pd(maxScore);
+    const __m128d vitemp = _mm_set1_pd(itemp);
+    __m128d vsum = _mm_setzero_pd();
+    for(; i + 2 <= moves; i += 2){
+        const __m128d w = fastExp(_mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(score + i), vmax), vitemp));
+        _mm_storeu_pd(score + i, w);
+        vsum = _mm_add_pd(vsum, w);
+    }
+    sum = _mm_cvtsd_f64(_mm_add_sd(vsum, _mm_unpackhi_pd(vsum, vsum)));
+#endif
+    for(; i < moves; ++i){
+        const double w = fastExp((score[i] - maxScore) * itemp);
+        score[i] = w;
+        sum += w;
+    }
+    return sum;
+}
+
 template<class dice_t>
 int selectBySoftmax(double *const score, const int moves, const double temp,
                     dice_t *const pdice){
@@ -397,6 +429,18 @@ struct BiasedSoftmaxSelector{
             score[i] = score[i] - coef * pow(maxScore - score[i], rate);
         }
     }
+    void amplify_fast(){
+        // 指数が2のときは pow を使わない
+        if(rate != 2){ amplify(); return; }
+        double maxScore = -DBL_MAX;
+        for(int i = 0; i < moves; ++i){
+            maxScore = max(maxScore, score[i]);
+        }
+        for(int i = 0; i < moves; ++i){
+            const double d = maxScore - score[i];
+            score[i] = score[i] - coef * d * d;
+        }
+    }
     
     void to_prob(){
         sum = 0;
@@ -406,6 +450,10 @@ struct BiasedSoftmaxSelector{
             sum += es;
         }
     }
+    void to_prob_fast(){
+        // 近似指数関数を使う(誤差は calcFastSoftmaxWeights を参照)
+        sum = calcFastSoftmaxWeights(score, moves, temp);
+    }
     
     double prob(size_t i)const{
         return score[i] / sum;
@@ -486,6 +534,16 @@ struct ExpBiasedSoftmaxSelector{
             score[i] = score[i] - coef * exp((maxScore - score[i]) / etemp);
         }
     }
+    void amplify_fast(){
+        double maxScore = -DBL_MAX;
+        for(int i = 0; i < moves; ++i){
+            maxScore = max(maxScore, score[i]);
+        }
+        const double ietemp = 1 / etemp;
+        for(int i = 0; i < moves; ++i){
+            score[i] = score[i] - coef * fastExp((maxScore - score[i]) * ietemp);
+        }
+    }
     
     void to_prob(){
         sum = 0;
@@ -495,6 +553,10 @@ struct ExpBiasedSoftmaxSelector{
             sum += es;
         }
     }
+    void to_prob_fast(){
+        // 近似指数関数を使う(誤差は calcFastSoftmaxWeights を参照)
+        sum = calcFastSoftmaxWeights(score, moves, temp);
+    }
     
     double prob(size_t i)const{
         return score[i] / sum;
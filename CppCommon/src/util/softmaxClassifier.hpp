@@ -11,6 +11,7 @@
 #include <fstream>
 #include <cmath>
 #include <map>
+#include <limits>
 #include <mutex>
 
 #include "../defines.h"
@@ -191,6 +192,85 @@ public:
     }
 };
 
+template<int _N_PARAMS_, int _N_PHASES_ = 1, int _N_STAGES_ = 1, typename _int_t = int16_t>
+class QuantizedSoftmaxClassifier{
+    // 学習済みのパラメータを整数に量子化した推論専用の写し
+    // param_[i] * scale() が元のパラメータの近似値になる
+private:
+    static void assert_index(int i)noexcept{ ASSERT(0 <= i && i < N_PARAMS_, cerr << i << endl;); }
+    static void assert_stage(int st)noexcept{ ASSERT(0 <= st && st < N_STAGES_, cerr << st << endl;); }
+    
+public:
+    using real_t = float;
+    using int_t = _int_t;
+    
+    constexpr static int N_PARAMS_ = _N_PARAMS_;
+    constexpr static int N_PHASES_ = _N_PHASES_;
+    constexpr static int N_STAGES_ = _N_STAGES_;
+    
+    double T_; // temperature
+    real_t scale_; // 整数1あたりの値
+    
+    alignas(16) int_t param_[N_STAGES_ * N_PARAMS_];
+    
+    constexpr static int params()noexcept{ return N_PARAMS_; }
+    constexpr static int phases()noexcept{ return N_PHASES_; }
+    constexpr static int stages()noexcept{ return N_STAGES_; }
+    
+    real_t temperature()const noexcept{ return T_; }
+    real_t scale()const noexcept{ return scale_; }
+    
+    real_t param(int i, int st = 0)const{
+        assert_index(i); assert_stage(st);
+        return param_[st * params() + i] * scale_;
+    }
+    
+    void setLearningMode()const{}
+    
+    bool isLearning()const{ return false; }
+    
+    void initCalculatingScore(int candidates)const{}
+    void initCalculatingCandidateScore()const{}
+    void feedFeatureScore(int c, int f, double v)const{}
+    void feedCandidateScore(int c, double s)const{}
+    void finishCalculatingScore()const{}
+    
+    template<class classifier_t>
+    void set(const classifier_t& src){
+        // 絶対値最大のパラメータが整数型の最大値になるように倍率を決めて丸める
+        static_assert(classifier_t::N_PARAMS_ == N_PARAMS_ && classifier_t::N_STAGES_ == N_STAGES_,
+                      "QuantizedSoftmaxClassifier::set() : shape mismatch.");
+        double maxAbs = 0;
+        for(int i = 0; i < N_STAGES_ * N_PARAMS_; ++i){
+            maxAbs = std::max(maxAbs, std::fabs((double)src.param_[i]));
+        }
+        scale_ = maxAbs > 0 ? maxAbs / std::numeric_limits<int_t>::max() : 1;
+        for(int i = 0; i < N_STAGES_ * N_PARAMS_; ++i){
+            param_[i] = (int_t)std::lround(src.param_[i] / scale_);
+        }
+        T_ = src.temperature();
+    }
+    
+    void setTemperature(double at)noexcept{
+        T_ = at;
+    }
+    
+    QuantizedSoftmaxClassifier():
+    T_(1.0), scale_(1)
+    {
+        for(int i = 0; i < N_STAGES_ * N_PARAMS_; ++i){
+            param_[i] = 0;
+        }
+    }
+    
+    std::string toOverviewString()const{
+        std::ostringstream oss;
+        oss << params() << " params, " << phases() << " phases, " << stages() << " stages";
+        oss << ", " << (8 * sizeof(int_t)) << " bit (scale " << scale_ << ")";
+        return oss.str();
+    }
+};
+
 template<class classifier_t>
 class SoftmaxClassifyLearner{
 private:
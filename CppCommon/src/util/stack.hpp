@@ -93,7 +93,7 @@ struct Stack{
     
     void clear(){
         init();
-        memset(data,0,sizeof(data_t)*SIZE);//memory clear
+        for(int i=0;i<SIZE;++i){ data[i]=data_t(); }//memory clear
     }
     
     Stack(){
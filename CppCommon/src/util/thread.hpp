@@ -7,15 +7,196 @@
 #ifndef _THREAD_HPP_
 #define _THREAD_HPP_
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include"../defines.h"
 
 //スレッド周りの環境依存をここでまとめて対応
 
-class MyThread{
-    
-    
-    
-    
+inline int hardwareThreads(){
+    // 使えるハードウェアスレッド数(分からなければ1)
+    return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+inline bool bindThisThread(int cpu){
+    // 呼び出し元スレッドを CPU 番号 cpu に固定する
+    // 番号がハードウェアスレッド数を超える場合は折り返す
+    // 対応していない環境では何もせず false を返す
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu % hardwareThreads(), &cpuset);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#else
+    return false;
+#endif
+}
+
+// スコープの間だけ呼び出し元スレッドを CPU 番号 cpu に固定し、抜けるときに元の設定に戻す
+// cpu が負なら何もしない
+class ThreadBindingGuard{
+public:
+    explicit ThreadBindingGuard(int cpu):
+    saved_(false){
+#ifdef __linux__
+        if(cpu >= 0 && pthread_getaffinity_np(pthread_self(), sizeof(saved_cpuset_), &saved_cpuset_) == 0){
+            saved_ = bindThisThread(cpu);
+        }
+#endif
+    }
+    ~ThreadBindingGuard(){
+#ifdef __linux__
+        if(saved_){ pthread_setaffinity_np(pthread_self(), sizeof(saved_cpuset_), &saved_cpuset_); }
+#endif
+    }
+    ThreadBindingGuard(const ThreadBindingGuard&) = delete;
+    ThreadBindingGuard& operator=(const ThreadBindingGuard&) = delete;
+
+private:
+    bool saved_;
+#ifdef __linux__
+    cpu_set_t saved_cpuset_;
+#endif
+};
+
+// キャッシュライン境界などに揃えて確保するアロケータ
+// C++14 の std::allocator は alignas で指定した境界を守らないので、
+// スレッドごとの領域を動的に確保するときに使う
+template<class T, std::size_t ALIGN = 64>
+struct AlignedAllocator{
+    using value_type = T;
+    template<class U> struct rebind{ using other = AlignedAllocator<U, ALIGN>; };
+
+    AlignedAllocator()noexcept{}
+    template<class U> AlignedAllocator(const AlignedAllocator<U, ALIGN>&)noexcept{}
+
+    T* allocate(std::size_t n){
+        void *p = nullptr;
+        if(posix_memalign(&p, std::max(ALIGN, alignof(T)), n * sizeof(T)) != 0){ return nullptr; }
+        return static_cast<T*>(p);
+    }
+    void deallocate(T *p, std::size_t)noexcept{ free(p); }
+
+    template<class U> bool operator==(const AlignedAllocator<U, ALIGN>&)const noexcept{ return true; }
+    template<class U> bool operator!=(const AlignedAllocator<U, ALIGN>&)const noexcept{ return false; }
+};
+
+// 常駐ワーカースレッド群
+// ジョブ毎にスレッドを生成、joinするコストを避けるため、
+// スレッドは起動後ジョブが投入されるまで待機し続ける
+// ワーカー番号0は呼び出し元スレッドが担当するので、実際に生成するスレッドは(size - 1)個
+// ワーカー番号とスレッドの対応は固定なので、番号ごとの持ち物(キャッシュ)がスレッドに紐づく
+// 起動時に CPU 番号を指定すると、ワーカー i を CPU (firstCPU + i) に固定する
+// ワーカー0 は run() を呼んだスレッドをジョブの実行中だけ固定し、終わったら元に戻す
+
+class WorkerPool{
+public:
+    using job_t = std::function<void(int)>;
+
+    int size()const noexcept{ return size_; }
+
+    void start(int n, int firstCPU = -1){
+        // n個のワーカーを用意する
+        // firstCPU が負なら CPU の固定はしない
+        stop();
+        size_ = std::max(1, n);
+        quit_ = false;
+        generation_ = 0;
+        firstCPU_ = firstCPU;
+        for(int i = 1; i < size_; ++i){
+            threads_.emplace_back(std::thread(&WorkerPool::loop, this, i));
+        }
+    }
+    void stop(){
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            quit_ = true;
+        }
+        wakeCond_.notify_all();
+        for(auto& th : threads_){ th.join(); }
+        threads_.clear();
+        size_ = 1;
+    }
+
+    void run(int n, const job_t& job){
+        // ワーカー 0 ~ (n - 1) に job(ワーカー番号) を実行させ、全員の終了を待つ
+        assert(0 < n && n <= size_);
+        if(n > 1){
+            {
+                std::lock_guard<std::mutex> lk(mutex_);
+                job_ = &job;
+                activeWorkers_ = n;
+                running_ = n - 1;
+                ++generation_;
+            }
+            wakeCond_.notify_all();
+        }
+        {
+            ThreadBindingGuard binding(firstCPU_); // ワーカー0は呼び出し元
+            job(0);
+        }
+        if(n > 1){
+            std::unique_lock<std::mutex> lk(mutex_);
+            doneCond_.wait(lk, [this]{ return running_ == 0; });
+            job_ = nullptr;
+        }
+    }
+
+    WorkerPool():
+    job_(nullptr), generation_(0),
+    size_(1), firstCPU_(-1), activeWorkers_(0), running_(0), quit_(false){}
+
+    ~WorkerPool(){
+        stop();
+    }
+
+private:
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wakeCond_, doneCond_;
+
+    const job_t *job_;
+    uint64_t generation_; // 投入されたジョブの通し番号
+    int size_;
+    int firstCPU_; // ワーカー0を固定する CPU 番号(負なら固定しない)
+    int activeWorkers_; // 現在のジョブに参加するワーカー数
+    int running_; // 現在のジョブを実行中のワーカー数(呼び出し元を除く)
+    bool quit_;
+
+    void loop(int index){
+        if(firstCPU_ >= 0){ bindThisThread(firstCPU_ + index); }
+        uint64_t lastGeneration = 0;
+        while(1){
+            const job_t *pjob;
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                wakeCond_.wait(lk, [this, lastGeneration]{
+                    return quit_ || generation_ != lastGeneration;
+                });
+                if(quit_){ return; }
+                lastGeneration = generation_;
+                if(index >= activeWorkers_){ continue; } // 今回のジョブには不参加
+                pjob = job_;
+            }
+            (*pjob)(index);
+            bool last;
+            {
+                std::lock_guard<std::mutex> lk(mutex_);
+                last = (--running_ == 0);
+            }
+            if(last){ doneCond_.notify_one(); }
+        }
+    }
 };
 
-#endif //_THREAD_HPP_
\ No newline at end of file
+#endif //_THREAD_HPP_
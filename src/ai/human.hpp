@@ -96,6 +96,7 @@ namespace UECda{
             void afterOthersPlay(){}
             void waitBeforeWon(){}
             void waitAfterWon(){}
+            void stopPondering(){}
             void tellOpponentsCards(){}
             void closeGame(){}
             void closeMatch(){}
@@ -58,6 +58,12 @@ int main(int argc, char* argv[]){ // for UECda
         if(ifs){ ifs >> DIRECTORY_PARAMS_IN; }
         if(ifs){ ifs >> DIRECTORY_PARAMS_OUT; }
         if(ifs){ ifs >> DIRECTORY_LOGS; }
+#ifdef _ENGINE_FUJI_
+        // 以下は省略可(スレッド数, 探索スレッドを固定する最初のCPU番号)
+        int NThreads, firstCPU;
+        if(ifs >> NThreads){ Settings::setNThreads(NThreads); }
+        if(ifs >> firstCPU){ Settings::firstCPU = firstCPU; }
+#endif
     }
     
     // 全試合前の初期化
@@ -86,12 +92,32 @@ int main(int argc, char* argv[]){ // for UECda
             seed = atoi(argv[c + 1]);
         }
 #ifdef _ENGINE_FUJI_
+        // 実行環境設定 大会版ビルドでも変更可能
+        else if(!strcmp(argv[c], "-th")){ // num of threads
+            Settings::setNThreads(atoi(argv[c + 1]));
+        }else if(!strcmp(argv[c], "-cpu")){ // bind search threads to CPUs from this number
+            Settings::firstCPU = atoi(argv[c + 1]);
+        }else if(!strcmp(argv[c], "-l2mb")){ // size of L2 transposition table (MB)
+            Settings::L2BookMB = atoi(argv[c + 1]);
+        }else if(!strcmp(argv[c], "-hp")){ // use huge pages for transposition tables
+            Settings::hugePages = true;
+        }else if(!strcmp(argv[c], "-l2f")){ // file to load and save L2 transposition table
+            Settings::L2BookPath = std::string(argv[c + 1]);
+        }
 #ifndef MATCH
         // プレー設定 大会版ビルドでは定数として埋め込む
-        else if(!strcmp(argv[c], "-th")){ // num of threads
-            int NThreads = atoi(argv[c + 1]);
-            Settings::NPlayThreads = NThreads;
-            Settings::NChangeThreads = max(1, NThreads / 2);
+        else if(!strcmp(argv[c], "-tg")){ // time budget per game (ms)
+            Settings::gameTimeBudget = atof(argv[c + 1]);
+        }else if(!strcmp(argv[c], "-td")){ // time limit per decision (ms)
+            Settings::decisionTimeBudget = atof(argv[c + 1]);
+        }else if(!strcmp(argv[c], "-po")){ // pondering
+            Settings::pondering = true;
+        }else if(!strcmp(argv[c], "-nopo")){ // no pondering
+            Settings::pondering = false;
+        }else if(!strcmp(argv[c], "-tree")){ // search tree below the root
+            Settings::searchTree = true;
+        }else if(!strcmp(argv[c], "-notree")){ // flat Monte Carlo
+            Settings::searchTree = false;
         }else if(!strcmp(argv[c], "-pm")){ // play modeling
             Settings::simulationPlayModel = true;
         }else if(!strcmp(argv[c], "-npm")){ // no play modeling
@@ -100,6 +126,8 @@ int main(int argc, char* argv[]){ // for UECda
             Settings::L2SearchOnRoot = true;
         }else if(!strcmp(argv[c], "-nol2r")){ // no L2 search on the root state
             Settings::L2SearchOnRoot = false;
+        }else if(!strcmp(argv[c], "-l2dfpnn")){ // node budget of L2 df-pn search on the root state
+            Settings::L2DfpnNodesOnRoot = atoi(argv[c + 1]);
         }else if(!strcmp(argv[c], "-mater")){ // Mate search on the root state
             Settings::MateSearchOnRoot = true;
         }else if(!strcmp(argv[c], "-nomater")){ // no Mate search on the root state
@@ -116,10 +144,20 @@ int main(int argc, char* argv[]){ // for UECda
             Settings::L2SearchInSimulation = true;
         }else if(!strcmp(argv[c], "-nol2s")){ // no L2 search in simulations
             Settings::L2SearchInSimulation = false;
+        }else if(!strcmp(argv[c], "-lncis")){ // LnCI search in simulations
+            Settings::LnCISearchInSimulation = true;
+        }else if(!strcmp(argv[c], "-nolncis")){ // no LnCI search in simulations
+            Settings::LnCISearchInSimulation = false;
+        }else if(!strcmp(argv[c], "-lncin")){ // node budget of LnCI search in simulations
+            Settings::LnCINodesInSimulation = atoi(argv[c + 1]);
         }else if(!strcmp(argv[c], "-mates")){ // Mate search in simulations
             Settings::MateSearchInSimulation = true;
         }else if(!strcmp(argv[c], "-nomates")){ // no Mate search in simulations
             Settings::MateSearchInSimulation = false;
+        }else if(!strcmp(argv[c], "-crn")){ // common random numbers in simulations
+            Settings::commonRandomNumbers = true;
+        }else if(!strcmp(argv[c], "-nocrn")){ // independent random numbers in simulations
+            Settings::commonRandomNumbers = false;
         }else if(!strcmp(argv[c], "-ss")){ // selector in simulation
             std::string selectorName = std::string(argv[c + 1]);
             if(!strcmp(argv[c + 1], "e")){ // exp
@@ -146,6 +184,16 @@ int main(int argc, char* argv[]){ // for UECda
             }else{
                 cerr << " : unknown deal type [" << std::string(std::string()) << "] : default deal type will be used." << endl;
             }
+        }else if(!strcmp(argv[c], "-sr")){ // stopping rule of root search
+            if(!strcmp(argv[c + 1], "rg")){ // regret
+                Settings::rootStoppingRule = StoppingRule::REGRET;
+            }else if(!strcmp(argv[c + 1], "ra")){ // racing
+                Settings::rootStoppingRule = StoppingRule::RACING;
+            }else if(!strcmp(argv[c + 1], "pb")){ // probability of best
+                Settings::rootStoppingRule = StoppingRule::PROB_BEST;
+            }else{
+                cerr << " : unknown stopping rule [" << std::string(argv[c + 1]) << "] : default stopping rule will be used." << endl;
+            }
         }
 #endif
 #endif
@@ -475,6 +523,10 @@ int main(int argc, char* argv[]){ // for UECda
             receiveCards(recv_table);
             tmpTime = clms.stop();
             
+            if(!myTurn){
+                client.stopPondering(); // 局面を更新する前に裏での思考を止める
+            }
+            
             // サーバーが受理した役(場に出ている役)
             
             //cerr << toString(recv_table) << endl;
@@ -33,6 +33,7 @@
 
 // 末端探索
 #include "search/l2Judge.hpp"
+#include "search/l2DfpnJudge.hpp"
 
 // ヒューリスティクス
 #include "heuristics.hpp"
@@ -76,11 +77,67 @@ namespace UECda{
         private:
             using dice64_t = XorShift64;
             
-            ThreadTools threadTools[N_THREADS];
+            // スレッドごとの持ち物(スレッド数は起動時に決まるので initMatch() で確保する)
+            std::vector<ThreadTools> threadTools;
             SharedData shared;
             
-            // 0番スレッドのサイコロをメインサイコロとして使う
-            dice64_t& dice = threadTools[0].dice;
+            // ルートのラスト2人の証明数探索器
+            // 子局面バッファが大きいので、初めて使う時に確保して使い回す(着手生成バッファは threadTools[0] のもの)
+            std::unique_ptr<L2DfpnJudge> rootDfpnJudge;
+            
+            bool matchOpened = false; // initMatch() 後、closeMatch() 前か
+            
+#ifndef POLICY_ONLY
+            // 探索スレッド群
+            // 着手決定の度にスレッドを生成せず、試合中は待機させておく
+            // ワーカー番号 th のスレッドは常に threadTools[th] を使う
+            WorkerPool searchWorkers;
+            
+            // 相手の手番中の世界作成(pondering)
+            // 呼び出し元はサーバーからの受信を待っているので、別スレッドから探索スレッド群に仕事を投げる
+            std::thread ponderThread;
+            std::atomic<bool> ponderStop;
+            
+            // 相手の手番が始まった時点の主観的局面
+            // pondering での世界作成と、相手の着手による世界の重み更新に使う
+            PlayouterField ponderField;
+            bool ponderFieldReady;
+            
+            // 相手の着手の各世界での尤度
+            double worldLikelihood[MAX_N_WORLDS];
+            
+            // 世界の重み更新待ちの着手
+            // 相手の手番中に重い処理をしないよう、尤度計算は次の自分の着手決定の最初にまとめて行う
+            // (着手決定の経過時間に含まれるので時間管理にも計上される)
+            struct PendingMove{
+                PlayouterField field; // 着手前の主観的局面
+                int player;
+                Move move;
+                bool weighted; // 尤度を計算するか
+            };
+            static constexpr int N_PENDING_MOVES = 16;
+            PendingMove pendingMoves[N_PENDING_MOVES];
+            int NPendingMoves;
+            
+            void ponderWorlds(int ith){
+                // 空いている世界作成スペースを埋める
+                using world_t = SharedData::galaxy_t::world_t;
+                auto& gal = shared.gal;
+                RandomDealer<N_PLAYERS> estimator;
+                estimator.set(ponderField, shared);
+                while(!ponderStop){
+                    world_t *pWorld = gal.claim();
+                    if(pWorld == nullptr){ break; } // 満杯
+                    estimator.create(pWorld, Settings::monteCarloDealType,
+                                     ponderField, shared, &threadTools[ith]);
+                    gal.regist(pWorld);
+                }
+            }
+#endif
+            
+            // メインサイコロ
+            // 探索スレッド数によらず同じ系列になるように、スレッドのものとは分けておく
+            dice64_t dice;
             
         public:
             using field_t = UECda::Fuji::FujiField;
@@ -98,29 +155,42 @@ namespace UECda{
                 // 乱数系列を初期化
                 XorShift64 tdice;
                 tdice.srand(s);
-                for(int th = 0; th < N_THREADS; ++th){
+                dice.srand(tdice.rand());
+                for(int th = 0; th < (int)threadTools.size(); ++th){
                     threadTools[th].dice.srand(tdice.rand() * (th + 111));
                 }
             }
             
             void initMatch(){
                 // field にプレーヤー番号が入っている状態で呼ばれる
+                matchOpened = true;
                 shared.setMyPlayerNum(field.getMyPlayerNum());
                 
+                // スレッドごとのデータ確保
+#ifdef POLICY_ONLY
+                threadTools.resize(1);
+#else
+                threadTools.resize(std::max(1, Settings::NThreads));
+#endif
+                rootDfpnJudge.reset(); // 着手生成バッファが変わりうるので作り直す
+                
                 // サイコロ初期化
                 // シード指定の場合はこの後に再設定される
                 setRandomSeed((uint32_t)time(NULL));
                 
                 // スレッドごとのデータ初期化
-                for(int th = 0; th < N_THREADS; ++th){
+                for(int th = 0; th < (int)threadTools.size(); ++th){
                     threadTools[th].init(th);
                 }
                 
 #ifndef POLICY_ONLY
                 // 世界プール監視員を設定
-                for(int th = 0; th < N_THREADS; ++th){
-                    shared.ga.set(th, &threadTools[th].gal);
-                }
+                shared.ga.set(0, &shared.gal);
+                // 探索スレッド起動
+                searchWorkers.start(threadTools.size(), Settings::firstCPU);
+                ponderStop = false;
+                ponderFieldReady = false;
+                NPendingMoves = 0;
 #endif
                 
                 auto& playPolicy = shared.basePlayPolicy;
@@ -146,11 +216,35 @@ namespace UECda{
                     shared.estimationChangePolicy.fin(DIRECTORY_PARAMS_IN + "change_policy_param.dat");
                 }
                 ifs.close();
+                
+#ifdef USE_L2BOOK
+                // ラスト2人置換表(保存したものがあれば続きから使う)
+                L2::book.resize((uint64_t)std::max(1, Settings::L2BookMB) << 20, Settings::hugePages);
+                L2::book.init();
+                if(Settings::L2BookPath.size()){
+                    if(L2::book.load(Settings::L2BookPath, L2HashKeyTag())){
+                        CERR << "loaded L2 book from " << Settings::L2BookPath << "." << endl;
+                    }
+                }
+#endif
+#if defined(SEARCH_LEAF_LNCI) && defined(USE_LNCIBOOK)
+                // 3人以上の完全情報置換表
+                LnCI::book.resize((uint64_t)std::max(1, LNCI_BOOK_MB) << 20, Settings::hugePages);
+#endif
+#ifdef USE_L2TABLEBASE
+                // ラスト2人勝敗表(無ければ探索のみ)
+                if(L2::tablebase.load(DIRECTORY_PARAMS_IN + "l2_tablebase.dat")){
+                    CERR << "loaded L2 tablebase (up to " << L2::tablebase.maxTotal() << " cards)." << endl;
+                }
+#endif
 #endif
                 
                 // 方策の温度
                 shared.basePlayPolicy.setTemperature(Settings::simulationTemperaturePlay);
                 shared.baseChangePolicy.setTemperature(Settings::simulationTemperatureChange);
+#ifdef QUANTIZED_PLAY_POLICY
+                shared.simulationPlayPolicy.set(shared.basePlayPolicy);
+#endif
 #ifndef POLICY_ONLY
                 shared.estimationPlayPolicy.setTemperature(Settings::simulationTemperaturePlay);
                 shared.estimationChangePolicy.setTemperature(Settings::simulationTemperatureChange);
@@ -158,8 +252,14 @@ namespace UECda{
             }
             void initGame(){
                 
+                shared.initGame();
+                
                 // 汎用変数の設定
 #ifndef POLICY_ONLY
+                // 前の試合の世界は使えない
+                shared.gal.clear();
+                shared.tree.clear();
+                
                 // 報酬設定
                 // ランク初期化まで残り何試合か
                 // 公式には未定だが、多くの場合100試合だろうから100試合としておく
@@ -172,16 +272,27 @@ namespace UECda{
                 
                 // 置換表初期化
 #ifdef USE_L2BOOK
-                L2::book.init();
+                // 共通のL2置換表の結果は局面だけで決まるので試合をまたいで残す
+                for(auto& tools : threadTools){ tools.l2Book->init(); }
 #endif
-#ifdef USE_LNCIBOOK
+#if defined(SEARCH_LEAF_LNCI) && defined(USE_LNCIBOOK)
                 LnCI::book.init();
 #endif
 #endif // !POLICY_ONLY
                 
             }
             
-            Cards change(uint32_t change_qty){ // 交換関数
+            Cards change(uint32_t change_qty){
+#ifndef POLICY_ONLY
+                shared.timeManager.startDecision();
+#endif
+                Cards ret = changeSub(change_qty);
+#ifndef POLICY_ONLY
+                shared.timeManager.finishDecision();
+#endif
+                return ret;
+            }
+            Cards changeSub(uint32_t change_qty){ // 交換関数
                 assert(change_qty == 1U || change_qty == 2U);
                 
                 RootInfo root;
@@ -277,6 +388,9 @@ namespace UECda{
                 
                 // ルートノード設定
                 int limitSimulations = std::min(10000, (int)(pow((double)NCands, 0.8) * 700));
+#ifndef POLICY_ONLY
+                if(shared.timeManager.active())limitSimulations = -1; // 実時間で打ち切るので回数は安全のための上限のみ
+#endif
                 root.setChange(cand, NCands, field, shared, limitSimulations);
                 
                 // 方策関数による評価
@@ -292,22 +406,26 @@ namespace UECda{
                 // モンテカルロ法による評価
                 if(changeCards == CARDS_NULL){
                     // 世界プールを整理する
-                    for(int th = 0; th < N_THREADS; ++th)threadTools[th].gal.clear();
+                    shared.gal.clear();
 #ifdef USE_POLICY_TO_ROOT
                     root.addPolicyScoreToMonteCarloScore();
 #endif
                     PlayouterField tfield;
                     setSubjectiveField(field, &tfield);
-                    // モンテカルロ開始
-                    if(Settings::NChangeThreads > 1){
-                        std::vector<std::thread> thr;
-                        for(int ith = 0; ith < Settings::NChangeThreads; ++ith)
-                            thr.emplace_back(std::thread(&MonteCarloThread<RootInfo, PlayouterField, SharedData, ThreadTools>,
-                                                         ith, &root, &tfield, &shared, &threadTools[ith]));
-                        for(auto& th : thr)th.join();
-                    }else{
-                        MonteCarloThread<RootInfo, PlayouterField, SharedData, ThreadTools>(0, &root, &tfield, &shared, &threadTools[0]);
+#ifndef FIXED_N_PLAYOUTS
+                    if(shared.timeManager.active()){
+                        shared.timeManager.allot(shared.timeAnalyzer, &root.limitTime, &root.hardLimitTime);
                     }
+#endif
+                    shared.timeAnalyzer.my_searches++;
+                    root.randomSeed = dice.rand();
+                    // モンテカルロ開始
+                    root.workers = std::min(Settings::NChangeThreads, searchWorkers.size());
+                    searchWorkers.run(root.workers, [&](int ith){
+                        MonteCarloThread<RootInfo, PlayouterField, SharedData, ThreadTools>(ith, &root, &tfield, &shared, &threadTools[ith]);
+                    });
+                    root.mergeThreadResults(); // スレッドごとの結果をまとめる
+                    root.pruneRejected(); // 打ち切り判定で見込みなしとされた候補を除外
                 }
 #endif // POLICY_ONLY
                 root.sort();
@@ -350,6 +468,8 @@ namespace UECda{
             }
             void prepareForGame(){
 #ifndef POLICY_ONLY
+                shared.gal.clear(); // 交換中に作った世界は交換後には使えない
+                NPendingMoves = 0;
                 field.initWorldPatterns();
 #endif
             }
@@ -357,8 +477,19 @@ namespace UECda{
                 // 自分のプレーについての変数を更新
                 ClockMicS clms;
                 clms.start();
+#ifndef POLICY_ONLY
+                shared.timeManager.startDecision();
+                flushWorlds(); // 相手の着手による世界の重み更新
+#ifdef USE_L2BOOK
+                L2::book.nextGeneration();
+#endif
+#if defined(SEARCH_LEAF_LNCI) && defined(USE_LNCIBOOK)
+                LnCI::book.nextGeneration();
+#endif
+#endif
                 Move ret = playSub();
 #ifndef POLICY_ONLY
+                shared.timeManager.finishDecision();
                 shared.timeAnalyzer.my_play_time_sum += clms.stop();
                 shared.timeAnalyzer.my_plays++;
 #endif
@@ -461,6 +592,16 @@ namespace UECda{
                     
                     setDomState(mv, NMoves, tfield); // 先の場も含めて支配状況をまとめて設定
                     
+                    // L2判定器は全着手で使い回す(結果は共通の置換表に残る)
+                    L2Judge lj(400000, searchBuffer);
+                    // 読み切れなかった着手は、着手決定ごとの節点数と時間の範囲で証明数探索で読み直す
+                    int dfpnNodes = 0;
+#ifndef POLICY_ONLY
+                    const int64_t dfpnDeadline = shared.timeManager.preSearchDeadline(shared.timeAnalyzer);
+#else
+                    const int64_t dfpnDeadline = INT64_MAX; // 時間管理をしない
+#endif
+                    
                     for(int m = 0; m < NMoves; ++m){
                         MoveInfo *const mi = &mv[m];
                         const Move move = mi->mv();
@@ -478,8 +619,15 @@ namespace UECda{
                         }
                         if(Settings::L2SearchOnRoot){
                             if(tfield.getNAlivePlayers() == 2){ // 残り2人の場合はL2判定
-                                L2Judge lj(400000, searchBuffer);
                                 int l2Result = (bd.isNF() && mi->isPASS()) ? L2_LOSE : lj.start_check(*mi, myHand, opsHand, bd, fieldInfo);
+                                const int64_t dfpnRestTime = dfpnDeadline - TimeManager::now();
+                                if(l2Result == L2_DRAW && dfpnNodes < Settings::L2DfpnNodesOnRoot && dfpnRestTime > 0){
+                                    if(!rootDfpnJudge){ rootDfpnJudge.reset(new L2DfpnJudge(0, searchBuffer)); }
+                                    L2DfpnJudge& dj = *rootDfpnJudge;
+                                    dj.set(Settings::L2DfpnNodesOnRoot - dfpnNodes, dfpnRestTime);
+                                    l2Result = dj.start_check(*mi, myHand, opsHand, bd, fieldInfo);
+                                    dfpnNodes += dj.getNodes();
+                                }
                                 //cerr << l2Result << endl;
                                 if(l2Result == L2_WIN){ // 勝ち
                                     DERR << "l2win!" << endl;
@@ -526,6 +674,9 @@ namespace UECda{
                     
                     // ルートノード設定
                     int limitSimulations = std::min(5000, (int)(pow((double)NMoves, 0.8) * 700));
+#ifndef POLICY_ONLY
+                    if(shared.timeManager.active())limitSimulations = -1; // 実時間で打ち切るので回数は安全のための上限のみ
+#endif
                     root.setPlay(mv, NMoves, field, shared, limitSimulations);
                     
                     // 方策関数による評価(必勝のときも行う, 除外された着手も考慮に入れる)
@@ -541,21 +692,37 @@ namespace UECda{
 #ifndef POLICY_ONLY
                     // モンテカルロ法による評価(結果確定のとき以外)
                     if(!fieldInfo.isMate() && !fieldInfo.isGiveUp()){
-                        if(rp_mc == 0) // 最初の場合は世界プールを整理する
-                            for(int th = 0; th < N_THREADS; ++th)threadTools[th].gal.clear();
+                        if(rp_mc == 0){ // 最初の場合は世界プールを整理する
+                            // これまでに作った世界のうち、実際の進行と矛盾しなかったものを引き継ぐ
+                            // 探索中は世界を一様に選ぶので、重みに比例して実質的な数だけ毎回選び直し、
+                            // 足りない分は新しく作る
+                            auto& gal = shared.gal;
+                            gal.checkRationality(field);
+                            gal.resample((int)std::ceil(gal.effectiveSize()), &dice);
+                        }
 #ifdef USE_POLICY_TO_ROOT
                         root.addPolicyScoreToMonteCarloScore();
 #endif
-                        // モンテカルロ開始
-                        if(Settings::NPlayThreads > 1){
-                            std::vector<std::thread> thr;
-                            for(int ith = 0; ith < Settings::NPlayThreads; ++ith)
-                                thr.emplace_back(std::thread(&MonteCarloThread<RootInfo, PlayouterField, SharedData, ThreadTools>,
-                                                             ith, &root, &tfield, &shared, &threadTools[ith]));
-                            for(auto& th : thr)th.join();
-                        }else{
-                            MonteCarloThread<RootInfo, PlayouterField, SharedData, ThreadTools>(0, &root, &tfield, &shared, &threadTools[0]);
+                        if(Settings::searchTree){
+                            // 前回の探索木でこの局面まで読んでいれば、その統計から始める
+                            // 以降は今回の探索で作り直す
+                            root.addTreeScoreToMonteCarloScore(shared.tree, tfield.getSubjectiveHashKey(myPlayerNum));
+                            shared.tree.clear();
+                        }
+#ifndef FIXED_N_PLAYOUTS
+                        if(shared.timeManager.active()){
+                            shared.timeManager.allot(shared.timeAnalyzer, &root.limitTime, &root.hardLimitTime);
                         }
+#endif
+                        shared.timeAnalyzer.my_searches++;
+                        root.randomSeed = dice.rand();
+                        // モンテカルロ開始
+                        root.workers = std::min(Settings::NPlayThreads, searchWorkers.size());
+                        searchWorkers.run(root.workers, [&](int ith){
+                            MonteCarloThread<RootInfo, PlayouterField, SharedData, ThreadTools>(ith, &root, &tfield, &shared, &threadTools[ith]);
+                        });
+                        root.mergeThreadResults(); // スレッドごとの結果をまとめる
+                        root.pruneRejected(); // 打ち切り判定で見込みなしとされた候補を除外
                         rp_mc++;
                     }
 #endif
@@ -657,6 +824,7 @@ namespace UECda{
             void afterMyPlay(){
 #ifndef POLICY_ONLY
                 field.procWorldPatterns(field.lastMove.qty());
+                proceedWorlds();
 #endif
             }
             void afterOthersPlay(){
@@ -666,10 +834,83 @@ namespace UECda{
                 if(!field.lastMove.isPASS() && field.lastWorldPatterns > 1.0){
                     shared.ga.proceed(field.lastTurnPlayer, field.lastMove, field.getWPCmp());
                 }
+                proceedWorlds();
 #endif
             }
+#ifndef POLICY_ONLY
+            void proceedWorlds(){
+                // 作成済みの世界を実際の着手に合わせて進める
+                // 相手の着手(パス含む)は各世界でその着手が選ばれる尤度を重みに掛けるので、
+                // 自分の着手決定まで待たせる(それより前の着手も順番を保つため待たせる)
+                const bool weighted = ponderFieldReady && field.lastTurnPlayer != shared.myPlayerNum;
+                ponderFieldReady = false;
+                if(!weighted && NPendingMoves == 0){
+                    const Move mv = field.lastMove;
+                    shared.gal.proceed(field.lastTurnPlayer, mv, mv.isPASS() ? CARDS_NULL : mv.cards(), nullptr);
+                    return;
+                }
+                if(NPendingMoves >= N_PENDING_MOVES){ flushWorlds(); } // 溢れる場合はその場で処理
+                PendingMove& pm = pendingMoves[NPendingMoves++];
+                if(weighted){ copyField(ponderField, &pm.field); }
+                pm.player = field.lastTurnPlayer;
+                pm.move = field.lastMove;
+                pm.weighted = weighted;
+            }
+            void flushWorlds(){
+                // 待たせていた着手を順に世界に反映する
+                auto& gal = shared.gal;
+                for(int i = 0; i < NPendingMoves; ++i){
+                    const PendingMove& pm = pendingMoves[i];
+                    const int p = pm.player;
+                    const Move mv = pm.move;
+                    const Cards c = mv.isPASS() ? CARDS_NULL : mv.cards();
+                    const double *likelihood = nullptr;
+                    if(pm.weighted && gal.actives > 0){
+                        const int worlds = gal.claimed();
+                        const int workers = std::min(Settings::NPlayThreads, searchWorkers.size());
+                        searchWorkers.run(workers, [&](int ith){
+                            for(int w = ith; w < worlds; w += workers){
+                                const ImaginaryWorld *const pWorld = gal.access(w);
+                                if(pWorld == nullptr || !holdsCards(pWorld->getCards(p), c))continue;
+                                PlayouterField f;
+                                copyField(pm.field, &f);
+                                setWorld(pm.field, *pWorld, &f);
+                                f.prepareForPlay();
+                                worldLikelihood[w] = calcPlayProb(f, mv, shared, threadTools[ith].buf);
+                            }
+                        });
+                        likelihood = worldLikelihood;
+                    }
+                    gal.proceed(p, mv, c, likelihood);
+                }
+                NPendingMoves = 0;
+            }
+#endif
             void waitBeforeWon(){
-                
+#ifndef POLICY_ONLY
+                // 相手の着手の尤度計算のため、着手前の局面を覚えておく
+                setSubjectiveField(field, &ponderField);
+                ponderFieldReady = true;
+                // 相手の手番中に世界を作っておく
+                // サーバーから次の局面を受け取ったら stopPondering() で止める
+                if(Settings::pondering){
+                    flushWorlds(); // 世界を今の局面に揃えてから作る
+                    shared.gal.compact(); // 消えた世界のスペースを空けておく
+                    ponderStop = false;
+                    ponderThread = std::thread([this](){
+                        searchWorkers.run(std::min(Settings::NPlayThreads, searchWorkers.size()),
+                                          [this](int ith){ ponderWorlds(ith); });
+                    });
+                }
+#endif
+            }
+            void stopPondering(){
+#ifndef POLICY_ONLY
+                if(ponderThread.joinable()){
+                    ponderStop = true;
+                    ponderThread.join();
+                }
+#endif
             }
             void waitAfterWon(){
                 
@@ -711,11 +952,25 @@ namespace UECda{
                 shared.closeGame(field);
             }
             void closeMatch(){
+                // デストラクタからも呼ばれるので、2回目以降は何もしない
+                if(!matchOpened){ return; }
+                matchOpened = false;
+#ifndef POLICY_ONLY
+                stopPondering();
+                searchWorkers.stop();
+#endif
                 shared.closeMatch();
                 field.closeMatch();
-                for(int th = 0; th < N_THREADS; ++th){
-                    threadTools[th].close();
+                for(auto& tools : threadTools){
+                    tools.close();
                 }
+#if !defined(POLICY_ONLY) && defined(USE_L2BOOK)
+                if(Settings::L2BookPath.size()){
+                    if(!L2::book.save(Settings::L2BookPath, L2HashKeyTag())){
+                        cerr << "failed to save L2 book to " << Settings::L2BookPath << "." << endl;
+                    }
+                }
+#endif
             }
             ~Client(){
                 closeMatch();
@@ -134,6 +134,53 @@ namespace UECda{
             return 1;
         }
         
+        template<class field_t, class sharedData_t>
+        double calcPlayProb(const field_t& field, const Move chosenMove,
+                            const sharedData_t& shared, MoveInfo *const mv){
+            // 局面 field で手番のプレーヤーが chosenMove を選ぶ確率を推定用方策と相手モデルから計算
+            // field は prepareForPlay() 済みであること
+            const uint32_t tp = field.getTurnPlayer();
+            const PlayerModel *const ppm = &shared.playerModelSpace.model(tp);
+            const Board bd = field.getBoard();
+            const Hand& myHand = field.getHand(tp);
+            const Hand& opsHand = field.getOpsHand(tp);
+            
+            const int NMoves = genMove(mv, myHand, bd);
+            assert(NMoves > 0);
+            if(NMoves <= 1){ return 1; }
+            
+            for(int m = 0; m < NMoves; ++m){
+                bool mate = checkHandMate(0, mv + NMoves, mv[m], myHand, opsHand, bd, field.fieldInfo);
+                if(mate){ mv[m].setMPMate(); }
+            }
+            
+            // search move
+            int chosenIdx = searchMove(mv, NMoves, [chosenMove](const auto& tmp)->bool{
+                return tmp.meldPart() == chosenMove.meldPart();
+            });
+            
+            if(chosenIdx == -1){ // 自分の合法手生成では生成されない手が出された
+                return 1 / (double)(NMoves + 1);
+            }
+            
+            std::array<double, N_MAX_MOVES> score;
+            calcPlayPolicyScoreSlow<0>(score.data(), mv, NMoves, field, shared.estimationPlayPolicy);
+            // Mateの手のスコアを設定
+            double maxScore = *std::max_element(score.begin(), score.begin() + NMoves);
+            for(int m = 0; m < NMoves; ++m)
+                if(mv[m].isMate())score[m] = maxScore + 4;
+            SoftmaxSelector selector(score.data(), NMoves, Settings::simulationTemperaturePlay);
+            if(Settings::simulationPlayModel){
+                addPlayerPlayBias(score.data(), mv, NMoves, field, *ppm, Settings::playerBiasCoef);
+            }
+            selector.to_prob();
+            if(selector.sum != 0){
+                return max(selector.prob(chosenIdx), 1 / 256.0);
+            }else{ // 等確率とする
+                return 1 / (double)NMoves;
+            }
+        }
+        
         template<int N>
         class RandomDealer{
             // ランダムに手札配置を作る
@@ -1197,11 +1244,8 @@ namespace UECda{
                      //cerr<<field.getTurnNum()<<" "<<chosenMove<<" "<<field.getBoard()<<endl;
                      
                      const Cards usedCards = chosenMove.cards();
-                     const PlayerModel *const ppm = &shared.playerModelSpace.model(tp);
                      const Board bd = field.getBoard();
                      const Cards myCards = field.getCards(tp);
-                     const Hand& myHand = field.getHand(tp);
-                     const Hand& opsHand = field.getOpsHand(tp);
                      
                      if(!holdsCards(myCards, usedCards)){
                          return -1; // 終了(エラー?)
@@ -1210,25 +1254,14 @@ namespace UECda{
                      if(tmpPlayFlag.test(tp)){
                          // カードが全確定しているプレーヤー(主に自分と、既に上がったプレーヤー)については考慮しない
                          
-                         // 場の情報をまとめる
-                         const int NMoves = genMove(mv, myHand, bd);
-                         assert(NMoves > 0);
-                         
-                         if(NMoves > 1){
-                             for(int m = 0; m < NMoves; ++m){
-                                 bool mate = checkHandMate(0, mv + NMoves, mv[m], myHand, opsHand, bd, field.fieldInfo);
-                                 if(mate){ mv[m].setMPMate(); }
-                             }
-                         }
-                         
                          // フェーズ(空場0、通常場1、パス支配場2)
                          const int ph = bd.isNF() ? 0 : (field.fieldInfo.isPassDom()? 2 : 1);
                          
 #ifdef ESTIMATION_BY_TIME
                          if(by_time && field.getTurnNum() != 0 && ph == 1 && chosenMove.isPASS()){
-                             const auto& timeModel = ppm->timeModel();
+                             const auto& timeModel = shared.playerModelSpace.model(tp).timeModel();
                              
-                             int idx = dominatesHand(bd, myHand) ? 1 : 0; // pass only
+                             int idx = dominatesHand(bd, field.getHand(tp)) ? 1 : 0; // pass only
                              
                              uint32_t ts = min(6U, max(1U, log2i(usedTime * time_rate / 256 ) / 2) - 1U);
                              ASSERT(0 <= ts && ts <= 6, cerr << "ts = " << ts << endl;);
@@ -1240,34 +1273,7 @@ namespace UECda{
                          }
 #endif
                          // プレー尤度計算
-                         if(NMoves > 1/* && !pwFlag.test(tp)*/){
-                             // search move
-                             int chosenIdx = searchMove(mv, NMoves, [chosenMove](const auto& tmp)->bool{
-                                 return tmp.meldPart() == chosenMove.meldPart();
-                             });
-                             
-                             if(chosenIdx == -1){ // 自分の合法手生成では生成されない手が出された
-                                 playLH += log(1 / (double)(NMoves + 1));
-                             }else{
-                                 
-                                 std::array<double, N_MAX_MOVES> score;
-                                 calcPlayPolicyScoreSlow<0>(score.data(), mv, NMoves, field, shared.estimationPlayPolicy);
-                                 // Mateの手のスコアを設定
-                                 double maxScore = *std::max_element(score.begin(), score.begin() + NMoves);
-                                 for(int m = 0; m < NMoves; ++m)
-                                     if(mv[m].isMate())score[m] = maxScore + 4;
-                                 SoftmaxSelector selector(score.data(), NMoves, Settings::simulationTemperaturePlay);
-                                 if(Settings::simulationPlayModel){
-                                     addPlayerPlayBias(score.data(), mv, NMoves, field, *ppm, Settings::playerBiasCoef);
-                                 }
-                                 selector.to_prob();
-                                 if(selector.sum != 0){
-                                     playLH += log(max(selector.prob(chosenIdx), 1 / 256.0));
-                                 }else{ // 等確率とする
-                                     playLH += log(1 / (double)NMoves);
-                                 }
-                             }
-                         }
+                         playLH += log(calcPlayProb(field, chosenMove, shared, mv));
                      }
                      return 0;
                  });
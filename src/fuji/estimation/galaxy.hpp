@@ -10,19 +10,29 @@
 
 namespace UECda{
     
-    constexpr int MAX_N_WORLDS = 128;
-    
-    template<class wrd_t, int SIZE = (MAX_N_WORLDS / N_THREADS)>
+    template<class wrd_t, int SIZE = MAX_N_WORLDS>
     struct Galaxy{
         
         using world_t = wrd_t;
         
         // 幾多の世界が詰まっている入れ物のような何か
-        // スレッドごとに
+        // 全スレッドで共有する
+        // 各スペースは 空き -> 作成中 -> 公開済み の状態を持ち、状態の遷移はCASで行う
+        // 世界作成中は各スレッドが reserve() で指定の番号を、claim() で任意の空きスペースを確保し、
+        // 作成後に regist() で公開する
+        // スペースの確保と公開はロックなしで行う
+        // proceed(), compact(), clear() は他のスレッドが動いていない時に呼ぶこと
+        
+        enum SlotState : int{
+            FREE, // 空き
+            DEALING, // 作成中
+            READY, // 公開済み
+        };
         
-        int usedLimit;
-        int actives;
-        int nullLimit;
+        std::atomic<int> cursor; // claim() で次に調べるスペース(SIZEを超えることがある)
+        std::atomic<int> claims; // 確保されたことのあるスペースの番号の上限
+        std::atomic<int> actives; // 公開されている世界の数
+        std::atomic<int> state[SIZE]; // スペースの状態
         world_t world[SIZE];
         
         Galaxy()
@@ -35,74 +45,225 @@ namespace UECda{
         }
         
         int size()const{return SIZE;}
+        int claimed()const{ return claims.load(std::memory_order_acquire); }
+        bool full()const{ return cursor.load(std::memory_order_relaxed) >= SIZE; }
         
         void clear(){
             for(int w = 0; w < SIZE; ++w){
                 world[w].clear();
+                state[w].store(FREE, std::memory_order_relaxed);
             }
-            usedLimit = SIZE;
+            cursor = 0;
+            claims = 0;
             actives = 0;
-            nullLimit = 0;
         }
         
         void close(){
             clear();
         }
         
-        void proceed(const int p, const Move mv, const Cards c, const double compRatio){
-            
+        void proceed(const int p, const Move mv, const Cards c, const double *const likelihood = nullptr){
+            // 実際の着手で局面を進める(パーティクルフィルタ)
+            // 矛盾した世界は消し、残った世界はその着手が選ばれる尤度で重みを更新して手札を進めておく
+            // likelihood は世界の番号ごとの尤度で、nullptr なら重みは更新しない
+            for(int w = 0; w < claimed(); ++w){
+                if(isActive(w)){
+                    if(!holdsCards(world[w].getCards(p), c)){
+                        kill(w);
+                    }else{
+                        if(likelihood != nullptr){ world[w].weight *= likelihood[w]; }
+                        if(anyCards(c)){ world[w].proc(p, mv, c); }
+                    }
+                }
+            }
+            normalize();
         }
         
-        void checkRationality(){
-            
+        void normalize(){
+            // 公開済みの世界の重みを平均1にそろえる
+            // 新しく作る世界の重みは1なので、生き残った世界の平均と同じ扱いになる
+            double sum = 0;
+            int n = 0;
+            for(int w = 0; w < claimed(); ++w){
+                if(isActive(w)){
+                    sum += world[w].weight;
+                    ++n;
+                }
+            }
+            if(n <= 0){ return; }
+            // 全ての世界の尤度が0になった場合は重みの情報を捨てる
+            const double scale = sum > 0 ? n / sum : 0;
+            for(int w = 0; w < claimed(); ++w){
+                if(isActive(w)){
+                    world[w].weight = sum > 0 ? world[w].weight * scale : 1.0;
+                }
+            }
+        }
+        
+        double effectiveSize()const{
+            // 重みの偏りを考慮した実質的な世界の数
+            double sum = 0, sum2 = 0;
+            for(int w = 0; w < claimed(); ++w){
+                if(isActive(w)){
+                    sum += world[w].weight;
+                    sum2 += world[w].weight * world[w].weight;
+                }
+            }
+            return sum2 > 0 ? sum * sum / sum2 : 0;
+        }
+        
+        template<class dice_t>
+        void resample(const int num, dice_t *const dice){
+            // 重みに比例して num 個の世界を選び直す(系統サンプリング)
+            // 重みは1に戻す。空いたスペースには新しい世界を重み1で作ってもらう
+            compact();
+            const int n = actives;
+            if(n <= 0 || num <= 0){ return; }
+            std::vector<world_t> org(world, world + n);
+            double sum = 0;
+            for(int w = 0; w < n; ++w){ sum += org[w].weight; }
+            if(sum <= 0){ return; }
+            const int m = std::min(num, n);
+            const double step = sum / m;
+            double line = dice->drand() * step, acc = org[0].weight;
+            int src = 0;
+            for(int w = 0; w < m; ++w){
+                while(acc < line && src < n - 1){ acc += org[++src].weight; }
+                world[w] = org[src];
+                world[w].weight = 1.0;
+                line += step;
+            }
+            for(int w = m; w < n; ++w){
+                world[w].clear();
+                state[w].store(FREE, std::memory_order_relaxed);
+            }
+            cursor = m;
+            claims = m;
+            actives = m;
+        }
+        
+        void compact(){
+            // 生き残った世界を前に詰めて、空いたスペースを再び確保できるようにする
+            // 世界が消えると重みの平均が変わるので、平均1にそろえ直す
+            int n = 0;
+            for(int w = 0; w < claimed(); ++w){
+                if(isActive(w)){
+                    if(w != n){
+                        world[n] = world[w];
+                        state[n].store(READY, std::memory_order_relaxed);
+                        world[w].clear();
+                        state[w].store(FREE, std::memory_order_relaxed);
+                    }
+                    ++n;
+                }else if(state[w].load(std::memory_order_relaxed) != FREE){
+                    // 作成途中で放棄されたスペース
+                    world[w].clear();
+                    state[w].store(FREE, std::memory_order_relaxed);
+                }
+            }
+            cursor = n;
+            claims = n;
+            actives = n;
+            normalize();
+        }
+        
+        template<class field_t>
+        void checkRationality(const field_t& field){
+            // 現実の局面と合わない世界を消す
+            // サーバーの役表現のずれなどで、proceed() だけでは矛盾が残る場合のため
+            const Cards remCards = field.getRemCards();
+            for(int w = 0; w < claimed(); ++w){
+                if(isActive(w)){
+                    for(int p = 0; p < N_PLAYERS; ++p){
+                        if(!field.isAlive(p)){ continue; }
+                        const Cards c = world[w].getCards(p);
+                        if(!holdsCards(remCards, c) || (int)countCards(c) != (int)field.getNCards(p)){
+                            kill(w);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        
+        bool isActive(const int w)const{
+            return state[w].load(std::memory_order_acquire) == READY;
+        }
+        bool isDealing(const int w)const{
+            return state[w].load(std::memory_order_relaxed) == DEALING;
         }
         
         world_t* access(const int w){
+            // 公開済みでなければnullptr
             assert(0 <= w && w < SIZE);
+            return isActive(w) ? &world[w] : nullptr;
+        }
+        
+        world_t* reserve(const int w){
+            // w 番のスペースを世界の作成のために確保する
+            // 空きでなければ(作成中か公開済みなら)nullptr
+            assert(0 <= w && w < SIZE);
+            int expected = FREE;
+            if(!state[w].compare_exchange_strong(expected, DEALING, std::memory_order_acq_rel)){
+                return nullptr;
+            }
+            // 確保されたことのある番号の上限を更新
+            int n = claims.load(std::memory_order_relaxed);
+            while(n < w + 1 && !claims.compare_exchange_weak(n, w + 1, std::memory_order_acq_rel));
             return &world[w];
         }
         
-        world_t* searchSpace(const int line, const int limit){
-            // 空になっている分割スペースを返す
-            for(int w = line; w < line + limit; ++w){
-                if(!world[w].isActive()){//ここに登録
-                    DERR << "WORLD " << w << "IS INACTIVE!" << endl;
-                    return &world[w];
-                }
+        world_t* claim(){
+            // 新しい世界を作成するスペースをどこでもよいので確保する
+            // 満杯ならnullptr
+            while(!full()){
+                const int w = cursor.fetch_add(1, std::memory_order_relaxed);
+                if(w >= SIZE){ break; }
+                world_t *const pWorld = reserve(w);
+                if(pWorld != nullptr){ return pWorld; }
+                // 番号を指定して確保されていたので次を調べる
             }
-            DERR << "NO ACTIVE WORLD..." << endl;
             return nullptr;
         }
         
         template<class dice_t>
-        world_t* pickRand(const int line, const int limit, dice_t *const dice){
-            // activeである世界のどれかにランダムアクセスする
-            int w = line + (dice->rand() % limit);
-            
-            if(0 <= w && w < SIZE && world[w].isActive()){
-                return &world[w];
-            }else{
-                assert(0);
-                return nullptr;
+        world_t* pickRand(dice_t *const dice){
+            // 公開済みの世界のどれかにランダムアクセスする
+            const int n = claimed();
+            if(actives.load(std::memory_order_acquire) <= 0 || n <= 0){ return nullptr; }
+            for(int t = 0; t < 8; ++t){
+                int w = dice->rand() % n;
+                if(isActive(w)){ return &world[w]; }
             }
+            // 作成中のスペースに当たり続けた場合は先頭から探す
+            for(int w = 0; w < n; ++w){
+                if(isActive(w)){ return &world[w]; }
+            }
+            return nullptr;
         }
         
         int regist(world_t *const wld){
-            if(!(0 <= (wld - world) && (wld - world) < SIZE && (!wld->isActive()))){
+            // 作成が終わった世界を公開する
+            const int w = wld - world;
+            if(!(0 <= w && w < SIZE && isDealing(w))){
                 assert(0);
                 return -1;
             }
             wld->activate();
-            actives++;
+            state[w].store(READY, std::memory_order_release);
+            actives.fetch_add(1, std::memory_order_relaxed);
             return 0;
         }
         
-        void addActives(){
-            ++actives;
+        void kill(const int w){
+            // 世界を消す
+            world[w].clear();
+            state[w].store(FREE, std::memory_order_relaxed);
+            actives.fetch_sub(1, std::memory_order_relaxed);
         }
     };
     
-    template<class glxy_t, int N = N_THREADS>
+    template<class glxy_t, int N = 1>
     struct GalaxyAnalyzer{
         
        using galaxy_t = glxy_t;
@@ -181,19 +342,18 @@ namespace UECda{
                         double sp = 0.0;
                         double pops = (double)pgal[g]->actives;
                         
-                        int dieds = 0;
                         //int killeds = 0;
                         
                         //int newW = 0;
                         
-                        for(int w = 0; w < pgal[g]->size(); ++w){
-                            world_t& tmpW = *pgal[g]->access(w);
-                            if(tmpW.isActive()){
+                        for(int w = 0; w < pgal[g]->claimed(); ++w){
+                            world_t *const pW = pgal[g]->access(w);
+                            if(pW != nullptr){
+                                world_t& tmpW = *pW;
                                 //完全矛盾による世界の自然死を判定
                                 if(!holdsCards(tmpW.getCards(p), c)){//矛盾
                                     DERR << "World " << w << " died..." << endl;
-                                    tmpW.clear();//そんな世界は存在しなかった
-                                    dieds++;
+                                    pgal[g]->kill(w);//そんな世界は存在しなかった
                                 }else{
                                     //世界死がおきなかった
                                     
@@ -213,7 +373,6 @@ namespace UECda{
                             }
                         }
                         
-                        pgal[g]->actives -= dieds;
                         //actives -= dieds;
                         //cerr<<"Galaxy : "<<actives<<" worlds are still active."<<std::endl;
                         population += pops;
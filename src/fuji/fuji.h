@@ -30,12 +30,15 @@ namespace UECda{
             
             // プレー設定
             MATCH_CONST bool L2SearchOnRoot = true;
+            MATCH_CONST int L2DfpnNodesOnRoot = 0; // ルートのラスト2人の証明数探索の節点数(着手決定ごと、0なら行わない)
             MATCH_CONST bool MateSearchOnRoot = true;
             
             // シミュレーション設定
             MATCH_CONST bool L2SearchInSimulation = true;
             MATCH_CONST bool LnCISearchInSimulation = false;
+            MATCH_CONST int LnCINodesInSimulation = 12000; // 末端の多人数完全情報探索の節点数
             MATCH_CONST bool MateSearchInSimulation = true;
+            MATCH_CONST bool commonRandomNumbers = false; // 候補着手間で同じ乱数系列を使う
             
             MATCH_CONST double simulationTemperatureChange = SIMULATION_TEMPERATURE_CHANGE;
             MATCH_CONST double simulationTemperaturePlay = SIMULATION_TEMPERATURE_PLAY;
@@ -46,13 +49,50 @@ namespace UECda{
             MATCH_CONST double temperatureChange = TEMPERATURE_CHANGE;
             MATCH_CONST double temperaturePlay = TEMPERATURE_PLAY;
             
-            MATCH_CONST int NPlayThreads = N_PLAY_THREADS;
-            MATCH_CONST int NChangeThreads = N_CHANGE_THREADS;
+            // 思考時間設定(ミリ秒)
+            MATCH_CONST double gameTimeBudget = GAME_TIME_BUDGET;
+            MATCH_CONST double decisionTimeBudget = DECISION_TIME_BUDGET;
+            
+            // スレッド設定
+            // 実行するマシンに合わせて起動時に決めるので、本番用ビルドでも定数にしない
+            int NThreads = N_THREADS; // 用意するスレッド数
+            int NPlayThreads = N_PLAY_THREADS;
+            int NChangeThreads = N_CHANGE_THREADS;
+            int firstCPU = -1; // 探索スレッドを固定するCPU番号の始まり(負なら固定しない)
+            
+            // 置換表設定
+            // スレッド設定と同じく起動時に決める
+            int L2BookMB = L2_BOOK_MB; // ラスト2人置換表の大きさ(MB)
+            bool hugePages = false; // 置換表に透過的ヒュージページを使う(Linuxのみ)
+            std::string L2BookPath = ""; // 空でなければ、ラスト2人置換表を試合開始時に読み込み、終了時に保存する
+            
+            inline void setNThreads(int n){
+#ifndef POLICY_ONLY
+                NThreads = NPlayThreads = std::max(1, n);
+                NChangeThreads = std::max(1, NThreads / 2);
+#endif
+            }
+            
+            // 相手の手番中の世界作成
+#ifdef PONDERING
+            MATCH_CONST bool pondering = true;
+#else
+            MATCH_CONST bool pondering = false;
+#endif
+            
+            // ルート直下の探索木
+#ifdef SEARCH_TREE
+            MATCH_CONST bool searchTree = true;
+#else
+            MATCH_CONST bool searchTree = false;
+#endif
             
             MATCH_CONST Selector simulationSelector = SIMULATION_SELECTOR;
             
             MATCH_CONST DealType monteCarloDealType = MONTECARLO_DEAL_TYPE;
             
+            MATCH_CONST StoppingRule rootStoppingRule = ROOT_STOPPING_RULE;
+            
             // シミュレーション中の相手モデル利用設定
 #ifdef MODELING_PLAY
             MATCH_CONST bool simulationPlayModel = true;
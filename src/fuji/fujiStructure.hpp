@@ -7,10 +7,18 @@
 #define UECDA_FUJI_FUJISTRUCTURE_HPP_
 
 // 思考用の構造体
+#include <memory>
+
 #include "montecarlo/playout.h"
+#include "search/l2Judge.hpp"
+
+#ifdef MOVE_CACHE
+#include "../generator/moveCache.hpp"
+#endif
 
 #include "../structure/field/clientField.hpp"
 #include "estimation/galaxy.hpp"
+#include "montecarlo/searchTree.hpp"
 #include "model/playerModel.hpp"
 
 #include "policy/changePolicy.hpp"
@@ -29,13 +37,6 @@ namespace UECda{
             using dice64_t = XorShift64;
             using move_t = MoveInfo;
             
-#ifndef POLICY_ONLY
-            // MCしないなら世界生成なし
-            using galaxy_t = Galaxy<ImaginaryWorld>;
-            
-            // 世界生成プール
-            galaxy_t gal;
-#endif
             // サイコロ
             dice64_t dice;
             
@@ -47,12 +48,31 @@ namespace UECda{
             
             move_t buf[BUFFER_LENGTH];
             
+#ifdef MOVE_CACHE
+            // 着手生成結果のキャッシュ
+            MoveCache<MOVE_CACHE_ENTRIES, MOVE_CACHE_MOVES> moveCache;
+#endif
+            
+            // プレイアウト中のL2判定器(着手生成バッファを共有する)
+            L2Judge l2;
+#ifdef USE_L2BOOK
+            // L2判定結果の置換表(ThreadTools を vector に入れるので別に確保する)
+            std::unique_ptr<L2::ThreadBook> l2Book;
+#endif
+            
             void init(int index){
-                memset(buf, 0, sizeof(buf));
-                threadIndex = index;
-#ifndef POLICY_ONLY
-                gal.clear();
+                std::fill(std::begin(buf), std::end(buf), move_t());
+#ifdef MOVE_CACHE
+                moveCache.clear();
+#endif
+#ifdef USE_L2BOOK
+                if(!l2Book){ l2Book.reset(new L2::ThreadBook("L2ThreadBook")); }
+                l2Book->init();
+                l2.set(65536, buf, l2Book.get());
+#else
+                l2.set(65536, buf);
 #endif
+                threadIndex = index;
             }
             void close(){}
         };
@@ -75,6 +95,10 @@ namespace UECda{
             // 基本方策
             ChangePolicy<policy_value_t> baseChangePolicy;
             PlayPolicy<policy_value_t> basePlayPolicy;
+#ifdef QUANTIZED_PLAY_POLICY
+            // プレイアウト用の量子化した方策
+            QuantizedPlayPolicy<quantized_policy_value_t> simulationPlayPolicy;
+#endif
             
             MinMatchLog<MinClientGameLog<MinClientPlayLog>> matchLog;
             MinClientGameLog<MinClientPlayLog> gameLog;
@@ -86,9 +110,15 @@ namespace UECda{
 #endif
             
 #ifndef POLICY_ONLY
-            using galaxy_t = ThreadTools::galaxy_t;
-            GalaxyAnalyzer<galaxy_t, N_THREADS> ga;
+            // 世界生成プール(全スレッドで共有)
+            using galaxy_t = Galaxy<ImaginaryWorld>;
+            galaxy_t gal;
+            GalaxyAnalyzer<galaxy_t> ga;
+            
+            // ルート直下の探索木(全スレッドで共有)
+            SearchTree<> tree;
             MyTimeAnalyzer timeAnalyzer;
+            TimeManager timeManager;
             
             // 推定用方策
             ChangePolicy<policy_value_t> estimationChangePolicy;
@@ -115,10 +145,15 @@ namespace UECda{
 #endif
             }
             void initGame(){
-                
+#ifndef POLICY_ONLY
+                timeManager.initGame();
+#endif
             }
             template<class field_t>
             void closeGame(const field_t& field){
+#ifndef POLICY_ONLY
+                timeAnalyzer.closeGame();
+#endif
 #if defined(POLICY_ONLY) && defined(RL_POLICY)
                 // reinforcement learning
                 playLearner.feedReward(((N_PLAYERS - 1) / 2.0 - field.getMyNewClass()) / (N_PLAYERS - 1));
@@ -275,6 +310,109 @@ namespace UECda{
             }
         };
         
+        /**************************スレッドごとのルートの結果**************************/
+        
+        struct RootActionResult{
+            // 1スレッドが1候補について得たモンテカルロ結果(事前分布は含まない)
+            BetaDistribution monteCarloScore;
+            BetaDistribution naiveScore;
+            BetaDistribution myScore;
+            BetaDistribution rivalScore;
+            uint64_t simulations;
+            uint64_t turnSum;
+            
+            void clear(){
+                monteCarloScore.set(0, 0);
+                naiveScore.set(0, 0);
+                myScore.set(0, 0);
+                rivalScore.set(0, 0);
+                simulations = 0;
+                turnSum = 0;
+            }
+        };
+        
+        struct alignas(64) RootThreadResult{
+            // 各スレッドは自分の領域だけをロックなしで更新する
+            // 他スレッドと同じキャッシュラインに乗らないように64バイト境界に置く
+            std::array<RootActionResult, N_MAX_MOVES + 64> child;
+            BetaDistribution allScore;
+            uint64_t simulations;
+            
+            // 他スレッドが読むための写し
+            // 数回のシミュレーションごとに書き直し、書き込み中かどうかを seq の奇偶で示す(seqlock)
+            // 読み書きが競合しても未定義動作にならないように中身も atomic にしておく
+            struct alignas(64) Snapshot{
+                std::atomic<uint32_t> seq;
+                std::array<std::atomic<double>, N_MAX_MOVES + 64> a, b;
+                std::array<std::atomic<uint64_t>, N_MAX_MOVES + 64> simulations;
+                std::atomic<double> allA, allB;
+                std::atomic<uint64_t> allSimulations;
+            } published;
+            
+            void clear(int num){
+                for(int m = 0; m < num; ++m)
+                    child[m].clear();
+                allScore.set(0, 0);
+                simulations = 0;
+                published.seq.store(0, std::memory_order_relaxed);
+                for(int m = 0; m < num; ++m){
+                    published.a[m].store(0, std::memory_order_relaxed);
+                    published.b[m].store(0, std::memory_order_relaxed);
+                    published.simulations[m].store(0, std::memory_order_relaxed);
+                }
+                published.allA.store(0, std::memory_order_relaxed);
+                published.allB.store(0, std::memory_order_relaxed);
+                published.allSimulations.store(0, std::memory_order_release);
+            }
+            void publish(int num){
+                // 書き込むのは自スレッドだけ
+                const uint32_t s = published.seq.load(std::memory_order_relaxed);
+                published.seq.store(s + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                for(int m = 0; m < num; ++m){
+                    published.a[m].store(child[m].monteCarloScore.a, std::memory_order_relaxed);
+                    published.b[m].store(child[m].monteCarloScore.b, std::memory_order_relaxed);
+                    published.simulations[m].store(child[m].simulations, std::memory_order_relaxed);
+                }
+                published.allA.store(allScore.a, std::memory_order_relaxed);
+                published.allB.store(allScore.b, std::memory_order_relaxed);
+                published.allSimulations.store(simulations, std::memory_order_relaxed);
+                published.seq.store(s + 2, std::memory_order_release);
+            }
+        };
+        
+        struct RootView{
+            // 着手選択時に参照する、全スレッドの結果を足し合わせたルートの評価
+            std::array<BetaDistribution, N_MAX_MOVES + 64> score;
+            std::array<uint64_t, N_MAX_MOVES + 64> simulations;
+            BetaDistribution allScore;
+            uint64_t allSimulations;
+            
+            // 事前分布と他スレッドの結果の合計(数回のシミュレーションごとに読み直す)
+            std::array<BetaDistribution, N_MAX_MOVES + 64> baseScore;
+            std::array<uint64_t, N_MAX_MOVES + 64> baseSimulations;
+            BetaDistribution baseAllScore;
+            uint64_t baseAllSimulations;
+            
+            double mean(int m)const{ return score[m].mean(); }
+            double size(int m)const{ return score[m].size(); }
+            double mean_var(int m)const{ return score[m].var(); }
+            
+            double separation(int num)const{
+                // 最善手と次善手の評価差(標準誤差単位)
+                int best = 0, second = -1;
+                for(int m = 1; m < num; ++m){
+                    if(mean(m) > mean(best)){
+                        second = best; best = m;
+                    }else if(second < 0 || mean(m) > mean(second)){
+                        second = m;
+                    }
+                }
+                if(second < 0)return DBL_MAX;
+                return (mean(best) - mean(second)) / sqrt(mean_var(best) + mean_var(second));
+            }
+        };
+        
         /**************************ルートの全体の情報**************************/
         
         struct RootInfo{
@@ -292,20 +430,31 @@ namespace UECda{
             // モンテカルロ用の情報
             bool exitFlag;
             uint64_t limitSimulations;
-            //uint64_t limitTime;
+            uint64_t limitTime; // 目安時刻(0なら時間管理なし)
+            uint64_t hardLimitTime; // 打ち切り時刻
+            uint64_t randomSeed; // 共通乱数の元になる種(着手決定ごとに変える)
             BetaDistribution monteCarloAllScore;
             uint64_t allSimulations;
-#ifdef MULTI_THREADING
-            SpinLock<int> lock_;
-            void lock()noexcept{ lock_.lock(); }
-            void unlock()noexcept{ lock_.unlock(); }
-#else
-            void lock()const noexcept{}
-            void unlock()const noexcept{}
-#endif
+            
+            // スレッドごとのモンテカルロ結果
+            // 着手選択の際に updateView() で足し合わせ、探索終了後に mergeThreadResults() で child にまとめる
+            // 他スレッドの結果は VIEW_INTERVAL 回のシミュレーションごとに公開される写しだけを読む
+            static constexpr int VIEW_INTERVAL = 16;
+            // スレッド数は起動時に決まるので動的に確保する
+            std::vector<RootThreadResult, AlignedAllocator<RootThreadResult>> threadResult;
+            int workers; // 今回の探索に参加するスレッド数(threads() 以下)
+            
+            // 探索中に見込みなしと判定された候補
+            // 探索中は候補の並びを変えられないので印だけ付け、探索後に pruneRejected() で除外する
+            std::array<std::atomic<bool>, N_MAX_MOVES + 64> rejected;
+            
+            int threads()const{ return threadResult.size(); }
+            
             template<class field_t, class shared_t>
             void setCommonInfo(int num, const field_t& field, const shared_t& shared, int limSim){
                 actions = candidates = num;
+                for(int m = 0; m < actions; ++m)
+                    rejected[m] = false;
                 for(int m = 0; m < actions; ++m)
                     monteCarloAllScore += child[m].monteCarloScore;
                 myPlayerNum = field.getMyPlayerNum();
@@ -322,6 +471,8 @@ namespace UECda{
                     }
                 }
                 limitSimulations = (limSim < 0) ? 100000 : limSim;
+                for(int th = 0; th < threads(); ++th)
+                    threadResult[th].clear(actions);
             }
             
             template<class field_t, class shared_t>
@@ -345,6 +496,18 @@ namespace UECda{
                 // m番目の候補を除外し、空いた位置に末尾の候補を代入
                 std::swap(child[m], child[--candidates]);
                 child[candidates].pruned = true;
+                const bool r = rejected[m];
+                rejected[m] = rejected[candidates].load();
+                rejected[candidates] = r;
+                for(int th = 0; th < threads(); ++th)
+                    std::swap(threadResult[th].child[m], threadResult[th].child[candidates]);
+            }
+            bool isRejected(int m)const{ return rejected[m].load(std::memory_order_relaxed); }
+            void reject(int m){ rejected[m].store(true, std::memory_order_relaxed); }
+            void pruneRejected(){
+                // 探索中に見込みなしとされた候補を除外
+                for(int m = candidates - 1; m >= 0; --m)
+                    if(rejected[m])prune(m);
             }
             void addPolicyScoreToMonteCarloScore(){
                 // 方策関数の出力をモンテカルロ結果の事前分布として加算
@@ -368,6 +531,18 @@ namespace UECda{
                     monteCarloAllScore += child[m].monteCarloScore;
             }
             
+            template<class tree_t>
+            void addTreeScoreToMonteCarloScore(const tree_t& tree, uint64_t key){
+                // 前回の探索木にこの局面(情報集合)があれば、その統計を事前分布として加算
+                const auto *const pnode = tree.find(key);
+                if(pnode == nullptr)return;
+                for(int m = 0; m < candidates; ++m){
+                    const BetaDistribution sc = tree.reusedScore(*pnode, child[m].move.mv());
+                    child[m].monteCarloScore += sc;
+                    monteCarloAllScore += sc;
+                }
+            }
+            
             void feedPolicyScore(const double *const score, int num){
                 // 方策関数の出力得点と選択確率を記録
                 assert(num <= actions && actions > 0 && num > 0);
@@ -381,9 +556,11 @@ namespace UECda{
             }
             
             template<class shared_t>
-            void feedSimulationResult(int triedIndex, const PlayouterField& field, shared_t *const pshared){
+            void feedSimulationResult(int threadId, int triedIndex, const PlayouterField& field, shared_t *const pshared){
                 // シミュレーション結果を記録
-                // ロックが必要な演算とローカルでの演算が混ざっているのでこの関数内で排他制御する
+                // 自スレッドの領域にのみ書き込むので排他制御は不要
+                RootThreadResult& result = threadResult[threadId];
+                RootActionResult& tried = result.child[triedIndex];
                 
                 // 新たに得た証拠分布
                 int myRew = field.infoReward[myPlayerNum];
@@ -395,9 +572,8 @@ namespace UECda{
                 
 #ifdef DEFEAT_RIVAL_MC
                 if(rivalPlayerNum < 0){ // 自分の結果だけ考えるとき
-                    lock();
-                    child[triedIndex].monteCarloScore += mySc;
-                    monteCarloAllScore += mySc;
+                    tried.monteCarloScore += mySc;
+                    result.allScore += mySc;
                 }else{
                     // ライバルの結果も考えるとき
                     int rivalRew = field.infoReward[rivalPlayerNum];
@@ -408,35 +584,102 @@ namespace UECda{
                     
                     constexpr double RIVAL_RATE = 1 / 16.0; // ライバルの結果を重視する割合 0.5 で半々
                     
-                    lock();
-                    child[triedIndex].myScore += mySc);
-                    child[triedIndex].rivalScore += rivalSc;
+                    tried.myScore += mySc;
+                    tried.rivalScore += rivalSc;
                     
                     mySc *= 1 - RIVAL_RATE;
                     rivalSc.mul(RIVAL_RATE).rev();
                     
-                    child[triedIndex].monteCarloScore += mySc + rivalSc;
-                    monteCarloAllScore += mySc + rivalSc;
+                    tried.monteCarloScore += mySc + rivalSc;
+                    result.allScore += mySc + rivalSc;
                 }
 #else
-                lock();
-                child[triedIndex].monteCarloScore += mySc;
-                child[triedIndex].naiveScore += mySc;
-                monteCarloAllScore += mySc;
+                tried.monteCarloScore += mySc;
+                tried.naiveScore += mySc;
+                result.allScore += mySc;
 #endif
                 
-                child[triedIndex].simulations += 1;
-                allSimulations += 1;
+                tried.simulations += 1;
                 
                 // 以下参考にする統計量
-                child[triedIndex].turnSum += field.getTurnNum();
+                tried.turnSum += field.getTurnNum();
                 
+                result.simulations += 1;
+                if(result.simulations % VIEW_INTERVAL == 0)result.publish(candidates);
+            }
+            
+            void updateView(int threadId, RootView *const pview, bool refresh)const{
+                // 着手選択用に、これまでの全スレッドの結果を足し合わせる
+                // 他スレッドの結果は refresh のときだけ公開された写しから読み直し、自スレッドの結果は毎回足す
+                if(refresh){
+                    for(int m = 0; m < candidates; ++m){
+                        pview->baseScore[m] = child[m].monteCarloScore;
+                        pview->baseSimulations[m] = child[m].simulations;
+                    }
+                    pview->baseAllScore = monteCarloAllScore;
+                    pview->baseAllSimulations = allSimulations;
+                    for(int th = 0; th < threads(); ++th){
+                        if(th == threadId)continue;
+                        const RootThreadResult::Snapshot& snap = threadResult[th].published;
+                        if(snap.allSimulations.load(std::memory_order_acquire) == 0)continue; // まだ結果を公開していない
+                        BetaDistribution score[N_MAX_MOVES + 64], allScore;
+                        uint64_t simulations[N_MAX_MOVES + 64], allSims;
+                        uint32_t s0, s1;
+                        do{
+                            s0 = snap.seq.load(std::memory_order_acquire);
+                            for(int m = 0; m < candidates; ++m){
+                                score[m].set(snap.a[m].load(std::memory_order_relaxed), snap.b[m].load(std::memory_order_relaxed));
+                                simulations[m] = snap.simulations[m].load(std::memory_order_relaxed);
+                            }
+                            allScore.set(snap.allA.load(std::memory_order_relaxed), snap.allB.load(std::memory_order_relaxed));
+                            allSims = snap.allSimulations.load(std::memory_order_relaxed);
+                            std::atomic_thread_fence(std::memory_order_acquire);
+                            s1 = snap.seq.load(std::memory_order_relaxed);
+                        }while((s0 & 1) || s0 != s1);
+                        for(int m = 0; m < candidates; ++m){
+                            pview->baseScore[m] += score[m];
+                            pview->baseSimulations[m] += simulations[m];
+                        }
+                        pview->baseAllScore += allScore;
+                        pview->baseAllSimulations += allSims;
+                    }
+                }
+                const RootThreadResult& result = threadResult[threadId];
+                for(int m = 0; m < candidates; ++m){
+                    pview->score[m] = pview->baseScore[m] + result.child[m].monteCarloScore;
+                    pview->simulations[m] = pview->baseSimulations[m] + result.child[m].simulations;
+                }
+                pview->allScore = pview->baseAllScore + result.allScore;
+                pview->allSimulations = pview->baseAllSimulations + result.simulations;
+            }
+            
+            bool reachedSimulationLimit(const RootView& view)const{
+                // 全体の試行回数による打ち切り(他スレッドの分は公開された時点までの回数)
 #ifdef FIXED_N_PLAYOUTS
-                if(allSimulations >= (FIXED_N_PLAYOUTS))exitFlag = true;
+                return view.allSimulations >= (FIXED_N_PLAYOUTS);
 #else
-                if(allSimulations >= limitSimulations)exitFlag = true;
+                return view.allSimulations >= limitSimulations;
 #endif
-                unlock();
+            }
+            
+            void mergeThreadResults(){
+                // 全スレッドの探索終了後に、スレッドごとの結果を child にまとめる
+                for(int th = 0; th < threads(); ++th){
+                    RootThreadResult& result = threadResult[th];
+                    if(result.simulations == 0)continue;
+                    for(int m = 0; m < actions; ++m){
+                        const RootActionResult& tried = result.child[m];
+                        child[m].monteCarloScore += tried.monteCarloScore;
+                        child[m].naiveScore += tried.naiveScore;
+                        child[m].myScore += tried.myScore;
+                        child[m].rivalScore += tried.rivalScore;
+                        child[m].simulations += tried.simulations;
+                        child[m].turnSum += tried.turnSum;
+                    }
+                    monteCarloAllScore += result.allScore;
+                    allSimulations += result.simulations;
+                    result.clear(actions);
+                }
             }
             
             void sort(){ // 評価が高い順に候補行動をソート
@@ -535,13 +778,16 @@ namespace UECda{
                 return rew;
             }
             
-            RootInfo(){
+            RootInfo():
+            threadResult(std::max(1, Settings::NThreads)){
                 actions = candidates = -1;
                 monteCarloAllScore.set(0, 0);
                 allSimulations = 0;
                 rivalPlayerNum = -1;
                 exitFlag = false;
-                unlock();
+                limitTime = hardLimitTime = 0;
+                randomSeed = 0;
+                workers = threads();
             }
         };
     }
@@ -209,7 +209,7 @@ namespace UECda{
             }
             int aftTmpOrd = bd.afterTmpOrder(mv);
             if(mv.qty() > 4){ return true; }
-            if(mv.charaPQR() & opsHand.nd[aftTmpOrd]){ // 無支配型と交差あり
+            if(mv.charaPQR() & opsHand.getND(aftTmpOrd)){ // 無支配型と交差あり
                 if(bd.locksSuits(mv)){ // スートロックの場合はまだ支配可能性あり
                     uint32_t qty = mv.qty();
                     qty -= opsHand.jk;
@@ -262,7 +262,7 @@ namespace UECda{
             if(bd.qty() > 4){ return true; }
             Move mv = Move(bd);
             Cards pqr = mv.charaPQR();
-            if(pqr & opsHand.nd[bd.tmpOrder()]){ // 無支配型と交差あり
+            if(pqr & opsHand.getND(bd.tmpOrder())){ // 無支配型と交差あり
                 if(bd.suitsLocked()){ // スートロックの場合はまだ支配可能性あり
                     uint32_t qty = bd.qty();
                     qty -= opsHand.jk;
@@ -244,7 +244,7 @@ namespace UECda{
         
         const int ord = argBd.tmpOrder();
         
-        const Cards ndpqr = myHand.pqr & opsHand.nd[ord] & ~CARDS_8; // 支配出来ていないpqr
+        const Cards ndpqr = myHand.pqr & opsHand.getND(ord) & ~CARDS_8; // 支配出来ていないpqr
         if(!ndpqr){
             // このときほぼ必勝なのだが、一応4枚グループが2つある場合にはそうでないことがある
             // 面倒なので勝ちとしておく
@@ -260,7 +260,7 @@ namespace UECda{
              //革命のうち1つにジョーカーを加えれば勝ち
              return true;
              }else{
-             if( !any2Cards( pqr4 & opsHand.nd[ord] ) ){
+             if( !any2Cards( pqr4 & opsHand.getND(ord) ) ){
              return true;
              }
              }
@@ -277,7 +277,7 @@ namespace UECda{
                     Cards quad = myHand.pqr & PQR_4 & ~CARDS_8 & ~ndpqr;
                     if(quad){
                         // このとき8以外の革命でターンをとる予定
-                        if(quad & opsHand.nd[flipOrder(ord)]){
+                        if(quad & opsHand.getND(flipOrder(ord))){
                             // 革命でターンが取れない。
                             if(!myHand.jk){
                                 return false;
@@ -340,7 +340,7 @@ namespace UECda{
                             Cards l = popLow(&h);
                             
                             // どちらかとndが交差しなければ勝ち
-                            if(!((h << 1) & opsHand.nd[ord]) || !((l << 1) & opsHand.nd[ord])){
+                            if(!((h << 1) & opsHand.getND(ord)) || !((l << 1) & opsHand.getND(ord))){
                                 DERR << "PW1 (+JK) " << OutCards(myHand.cards) << " , " << OutCards(opsHand.cards) << endl;
                                 return true;
                             }
@@ -359,7 +359,7 @@ namespace UECda{
                 if(myHand.pqr & PQR_4){
                     // ジョーカーを使わない革命あり。
                     Cards quad = myHand.pqr & PQR_4;
-                    Cards ndpqr_new = ndpqr & ~quad & opsHand.nd[flipOrder(ord)];
+                    Cards ndpqr_new = ndpqr & ~quad & opsHand.getND(flipOrder(ord));
                     
                     if(!ndpqr_new){
                         // 全部支配できた。勝ち
@@ -378,7 +378,7 @@ namespace UECda{
                                 // 2つだけ
                                 // 革命でターンが取れるならジョーカーは残っているのでジョーカーを使うことを考える
                                 // 革命でターンが取れない場合は5枚出しをする必要があったのでもうジョーカーは無い
-                                if(!(quad & opsHand.nd[flipOrder(ord)] & ~CARDS_8)){
+                                if(!(quad & opsHand.getND(flipOrder(ord)) & ~CARDS_8)){
                                     // 革命でターンがとれる
                                     // このとき、まだターンが取れていなかったやつを逆オーダーで考える
                                     
@@ -387,8 +387,8 @@ namespace UECda{
                                     Cards l = popLow(&h);
                                     
                                     // どちらかが、いずれかのオーダーのndと交差しなければ勝ち
-                                    if(!((h << 1) & opsHand.nd[ord]) || !((h << 1) & opsHand.nd[flipOrder(ord)])
-                                       || !((l << 1) & opsHand.nd[ord]) || !((l << 1) & opsHand.nd[flipOrder(ord)])){
+                                    if(!((h << 1) & opsHand.getND(ord)) || !((h << 1) & opsHand.getND(flipOrder(ord)))
+                                       || !((l << 1) & opsHand.getND(ord)) || !((l << 1) & opsHand.getND(flipOrder(ord)))){
                                         DERR << "NJ_QUAD PW1 (+JK) " << OutCards(myHand.cards) << " , " << OutCards(opsHand.cards) << endl;
                                         return true;
                                     }
@@ -406,7 +406,7 @@ namespace UECda{
                     }else{
                         if(!ndpqr_new_m){
                             // 1つ残し。革命でターンが取れるなら勝ち。
-                            if(!(quad & opsHand.nd[flipOrder(ord)] & ~CARDS_8)){
+                            if(!(quad & opsHand.getND(flipOrder(ord)) & ~CARDS_8)){
                                 DERR << "NJ_QUAD PW1 " << OutCards(myHand.cards) << " , " << OutCards(opsHand.cards) << endl;
                                 return true;
                             }
@@ -418,11 +418,11 @@ namespace UECda{
                     // まず、この革命がターンを取れるか
                     Cards quad = (myHand.pqr & PQR_3) << 1;
                     // トリプルが2つあるのは結構あるだろう。少なくとも1つで支配出来れば良い
-                    Cards tmp = quad & opsHand.nd[flipOrder(ord)] & ~CARDS_8;
+                    Cards tmp = quad & opsHand.getND(flipOrder(ord)) & ~CARDS_8;
                     if(quad != tmp){
                         // 革命でターンがとれる
                         // このとき、まだターンが取れていなかったやつを逆オーダーで考える
-                        Cards ndpqr_new = ndpqr & ~((quad ^ tmp) >> 1) & opsHand.nd[flipOrder(ord)]; // 革命の分も消しとく
+                        Cards ndpqr_new = ndpqr & ~((quad ^ tmp) >> 1) & opsHand.getND(flipOrder(ord)); // 革命の分も消しとく
                         
                         if(!ndpqr_new){
                             //全部支配できた。勝ち
@@ -570,7 +570,7 @@ namespace UECda{
                             if(judgeHandPW_NF(nextHand, opsHand, argBd))return true;
                         }else{
                             // 支配的でない場合、この役を最後に出すことを検討
-                            if(judgeHandPPW_NF(nextHand.cards, nextHand.pqr, nextHand.jk, opsHand.nd, argBd))return true;
+                            if(judgeHandPPW_NF(nextHand.cards, nextHand.pqr, nextHand.jk, opsHand.getND(), argBd))return true;
                         }
                     }
                 }
@@ -61,7 +61,7 @@ namespace UECda{
                  const Board bd = field.getBoard();
                  
                  const Hand& myHand = field.hand[tp];
-                 const Hand& opsHand = field.opsHand[tp];
+                 const Hand& opsHand = field.getOpsHand(tp);
                  const Cards myCards = myHand.getCards();
                  
                  FieldAddInfo fieldInfo = field.fieldInfo;
@@ -6,6 +6,8 @@
 #ifndef UECDA_FUJI_TIME_ANALYSIS_HPP_
 #define UECDA_FUJI_TIME_ANALYSIS_HPP_
 
+#include <chrono>
+
 namespace UECda{
     namespace Fuji{
         
@@ -32,6 +34,21 @@ namespace UECda{
             uint64_t my_play_time_lock;
             uint64_t my_play_time_sum;
             uint64_t my_plays;
+            // モンテカルロ探索を行った着手決定の回数
+            uint64_t my_searches; // この試合
+            uint64_t my_search_sum; // これまでの試合の合計
+            uint64_t my_games;
+            
+            double expectedSearches()const{
+                // 1試合あたりの探索回数の見込み
+                if(my_games == 0){ return 10; } // データが無いので適当に
+                return my_search_sum / (double)my_games;
+            }
+            void closeGame(){
+                my_search_sum += my_searches;
+                my_searches = 0;
+                ++my_games;
+            }
             
             void modifyTimeRate(){
                 //プレーヤーの平均計算時間(自分が計測。通信の影響を受けていないもの)に合わせ、枠を調節する
@@ -58,6 +75,73 @@ namespace UECda{
                 my_play_time_lock = false;
                 my_play_time_sum = 0ULL;
                 my_plays = 0U;
+                my_searches = 0U;
+                my_search_sum = 0ULL;
+                my_games = 0U;
+            }
+        };
+        
+        struct TimeManager{
+            // 実時間による思考時間の管理
+            // 時刻は単調増加時計のmicrosec
+            
+            // 目安時間を過ぎても結果が拮抗している場合は、目安時間のこの倍率まで延長する
+            static constexpr double EXTEND_RATE = 2.5;
+            // 最善手と次善手の評価差がこの値(標準誤差単位)未満なら拮抗しているとみなす
+            static constexpr double UNCERTAIN_SEPARATION = 1.0;
+            // 持ち時間が残っていなくても最低限与える時間
+            static constexpr int64_t MIN_DECISION_TIME = 1000;
+            // ルートでの必勝探索などモンテカルロ探索の前の処理に使ってよい、目安時間に対する割合
+            static constexpr double PRE_SEARCH_RATE = 0.5;
+            
+            int64_t gameRestTime; // この試合の残り持ち時間
+            int64_t decisionStartTime;
+            
+            static int64_t now()noexcept{
+                using namespace std::chrono;
+                return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+            }
+            bool active()const noexcept{
+                return Settings::gameTimeBudget > 0;
+            }
+            void initGame(){
+                gameRestTime = (int64_t)(Settings::gameTimeBudget * 1000);
+            }
+            void startDecision(){
+                decisionStartTime = now();
+            }
+            void finishDecision(){
+                gameRestTime -= now() - decisionStartTime;
+            }
+            void allot(const MyTimeAnalyzer& analyzer,
+                       uint64_t *const softLimitTime, uint64_t *const hardLimitTime)const{
+                // 今回の探索の目安時刻と打ち切り時刻を決める
+                // 残り持ち時間を残りの探索回数の見込みで等分し、1回あたりの上限時間を超えないようにする
+                // 着手決定開始からの経過時間(ルートでの必勝探索等)も持ち時間に含める
+                const int64_t decisionLimit = (int64_t)(Settings::decisionTimeBudget * 1000);
+                const double restSearches = std::max(1.0, analyzer.expectedSearches() - analyzer.my_searches);
+                const int64_t share = (int64_t)(std::max((int64_t)0, gameRestTime) / restSearches);
+                const int64_t soft = std::max(MIN_DECISION_TIME, std::min(share, (int64_t)(decisionLimit / EXTEND_RATE)));
+                const int64_t hard = std::max(soft, std::min({(int64_t)(soft * EXTEND_RATE), decisionLimit, gameRestTime / 2}));
+                *softLimitTime = decisionStartTime + soft;
+                *hardLimitTime = decisionStartTime + hard;
+            }
+            
+            int64_t preSearchDeadline(const MyTimeAnalyzer& analyzer)const{
+                // モンテカルロ探索の前の処理を打ち切る時刻
+                // 時間管理をしない場合も、1回の着手決定の上限時間を目安にする
+                int64_t allotted = (int64_t)(Settings::decisionTimeBudget * 1000);
+                if(active()){
+                    uint64_t softLimitTime, hardLimitTime;
+                    allot(analyzer, &softLimitTime, &hardLimitTime);
+                    allotted = (int64_t)softLimitTime - decisionStartTime;
+                }
+                return decisionStartTime + (int64_t)(allotted * PRE_SEARCH_RATE);
+            }
+            
+            TimeManager(){
+                gameRestTime = 0;
+                decisionStartTime = 0;
             }
         };
         
@@ -7,6 +7,7 @@
 
 #include "../../settings.h"
 #include "../estimation/dealer.hpp"
+#include "../model/timeAnalysis.hpp"
 #include "playouter.hpp"
 
 // マルチスレッディングのときはスレッド、
@@ -15,6 +16,127 @@
 namespace UECda{
     namespace Fuji{
         
+        inline uint64_t commonRandomSeed(uint64_t seed, uint64_t world, uint64_t trial)noexcept{
+            // (世界, 何回目の検討か) ごとに別の乱数系列になるように種を混ぜる
+            uint64_t z = seed ^ (world * 0x9E3779B97F4A7C15ULL) ^ (trial * 0xC2B2AE3D27D4EB4FULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+        
+        // ルートでの探索の打ち切り判定
+        // 打ち切るなら true を返す
+        // 見込みのない候補には reject() で印を付け、以降は検討しない(探索後に RootInfo::prune() で除外される)
+        constexpr uint64_t STOPPING_MIN_TRIALS = 16; // 候補を除外するのに必要な最低トライ数
+        constexpr double RACING_Z = 2.5; // 信頼区間の幅(標準誤差単位)
+        constexpr int PROB_BEST_SAMPLES = 400; // 最善である確率を見積もるためのサンプル数
+        constexpr double PROB_BEST_LINE = 0.97; // 最善手がこの確率で最善なら打ち切る
+        
+        template<class root_t, class dice_t>
+        bool checkStoppingByRegret(root_t *const proot, const RootView& view, const int candidates,
+                                   const uint64_t poTime, dice_t *const pdice){
+            // Regretによる打ち切り判定
+            // 推定平均値の分布からのサンプリングで、現時点で打ち切った場合のリグレットを見積もる
+            struct Dist{ double mean,sem,reg; };
+            // time
+            const double tmpClock = (double)poTime;
+            
+            const double line = -1600.0 * ((double)(2 * tmpClock * VALUE_PER_CLOCK)) / (double)proot->rewardGap;
+            
+            // regret check
+            Dist d[N_MAX_MOVES + 64];
+            for(int m = 0; m < candidates; ++m){
+                d[m].reg = 0.0;
+                d[m].mean = view.mean(m);
+                
+                ASSERT(view.size(m), cerr << view.score[m] << endl;);
+                
+                d[m].sem = sqrt(view.mean_var(m)); // 推定平均値の分散
+            }
+            for(int t = 0; t < 1600; ++t){
+                double tmpBest = -1.0;
+                double tmpScore[256];
+                for(int m = 0; m < candidates; ++m){
+                    const Dist& tmpD = d[m];
+                    NormalDistribution<double> norm(tmpD.mean, tmpD.sem);
+                    double tmpDBL = norm.rand(pdice);
+                    tmpScore[m] = tmpDBL;
+                    if(tmpDBL > tmpBest){
+                        tmpBest = tmpDBL;
+                    }
+                }
+                for(int m = 0; m < candidates; ++m){
+                    d[m].reg += (tmpScore[m] - tmpBest);
+                }
+            }
+            
+            for(int m = 0; m < candidates; ++m){
+                if(d[m].reg > line){
+                    return true;
+                }
+            }
+            return false;
+        }
+        
+        template<class root_t>
+        bool checkStoppingByRacing(root_t *const proot, const RootView& view, const int candidates){
+            // 信頼区間の上限が最善手の信頼区間の下限を下回った候補を除外し、最善手だけが残ったら打ち切る
+            int best = -1;
+            for(int m = 0; m < candidates; ++m){
+                if(proot->isRejected(m))continue;
+                if(best < 0 || view.mean(m) > view.mean(best))best = m;
+            }
+            if(best < 0)return true;
+            const double lower = view.mean(best) - RACING_Z * sqrt(view.mean_var(best));
+            int alives = 0;
+            for(int m = 0; m < candidates; ++m){
+                if(proot->isRejected(m))continue;
+                if(m != best && view.simulations[m] >= STOPPING_MIN_TRIALS
+                   && view.mean(m) + RACING_Z * sqrt(view.mean_var(m)) < lower){
+                    proot->reject(m);
+                    continue;
+                }
+                ++alives;
+            }
+            return alives <= 1;
+        }
+        
+        template<class root_t, class dice_t>
+        bool checkStoppingByProbBest(root_t *const proot, const RootView& view, const int candidates,
+                                     dice_t *const pdice){
+            // 推定平均値の分布からのサンプリングで各候補が最善である確率を見積もる
+            // 最善手が十分な確率で最善なら打ち切り、一度も最善にならなかった候補は除外する
+            int wins[N_MAX_MOVES + 64];
+            for(int m = 0; m < candidates; ++m)wins[m] = 0;
+            for(int t = 0; t < PROB_BEST_SAMPLES; ++t){
+                int tmpBest = -1;
+                double tmpBestScore = -DBL_MAX;
+                for(int m = 0; m < candidates; ++m){
+                    if(proot->isRejected(m))continue;
+                    NormalDistribution<double> norm(view.mean(m), sqrt(view.mean_var(m)));
+                    const double tmpScore = norm.rand(pdice);
+                    if(tmpScore > tmpBestScore){
+                        tmpBestScore = tmpScore;
+                        tmpBest = m;
+                    }
+                }
+                if(tmpBest < 0)return true;
+                wins[tmpBest] += 1;
+            }
+            int best = -1;
+            for(int m = 0; m < candidates; ++m){
+                if(proot->isRejected(m))continue;
+                if(best < 0 || wins[m] > wins[best])best = m;
+            }
+            for(int m = 0; m < candidates; ++m){
+                if(m != best && !proot->isRejected(m)
+                   && wins[m] == 0 && view.simulations[m] >= STOPPING_MIN_TRIALS){
+                    proot->reject(m);
+                }
+            }
+            return wins[best] >= PROB_BEST_SAMPLES * PROB_BEST_LINE;
+        }
+        
         template<class root_t, class field_t, class sharedData_t, class threadTools_t>
         void MonteCarloThread
         (const int threadId, root_t *const proot,
@@ -25,11 +147,11 @@ namespace UECda{
             constexpr uint32_t MINNEC_N_TRIALS = 4; // 全体での最小限のトライ数。UCB-Rootにしたので実質不要になった
             
             // プレー用
-            using galaxy_t = ThreadTools::galaxy_t;
-            using world_t = galaxy_t::world_t;
+            using galaxy_t = typename sharedData_t::galaxy_t;
+            using world_t = typename galaxy_t::world_t;
             
             auto& dice = ptools->dice;
-            auto& gal = ptools->gal;
+            auto& gal = pshared->gal; // 全スレッド共有の世界プール
             
             Clock clock;
             
@@ -44,10 +166,9 @@ namespace UECda{
             
             int threadMaxNTrials = 0; // 当スレッドで現時点で最大のトライ数
             
-            int threadNWorlds = 0; // 当スレッドが作成し使用している世界の数
-            const int threadMaxNWorlds = gal.size();//( gal->size() / N_THREADS ); // 当スレッドに与えられている世界作成スペースの数
+            int threadNWorlds = 0; // 当スレッドが作成した世界の数
             
-            assert(threadMaxNWorlds > 0);
+            assert(gal.size() > 0);
             
             // 世界創世者
             // 連続作成のためここに置いておく
@@ -66,6 +187,13 @@ namespace UECda{
                 pf.attractedPlayers.set(proot->rivalPlayerNum);
             }
             
+            RootView view; // 着手選択用のルートの評価(全スレッドの合計)
+            
+            // 共通乱数モードでは、同じ世界の同じ回目の検討をどの候補着手でも同じ乱数系列で行う
+            // 候補間の比較が対応のある差になり、少ないプレイアウト数で差がはっきりする
+            // 候補の選択など、それ以外の乱数はスレッド本来の系列から取る
+            auto mainDice = dice;
+            
             uint64_t poTime = 0ULL; // プレイアウトと雑多な処理にかかった時間
             uint64_t estTime = 0ULL; // 局面推定にかかった時間
             
@@ -76,29 +204,38 @@ namespace UECda{
                 
                 world_t *pWorld = nullptr;
                 
+                // 全スレッドの結果を集計
+                // 他スレッドの結果は数回に1回だけ読み直す
+                proot->updateView(threadId, &view, threadNTrialsSum % RootInfo::VIEW_INTERVAL == 0);
+                if(proot->reachedSimulationLimit(view)){
+                    proot->exitFlag = true;
+                    goto THREAD_EXIT;
+                }
+                
                 //サンプル着手決定
                 int tryingIndex = -1;
                 if(candidates == 2){
                     // 2つの時は同数(分布サイズ単位)に割り振る
-                    if(child[0].size() == child[1].size())
+                    if(view.size(0) == view.size(1))
                         tryingIndex = dice.rand() % 2;
                     else
-                        tryingIndex = child[0].size() < child[1].size()
+                        tryingIndex = view.size(0) < view.size(1)
                         ? 0 : 1;
                 }else{
                     // UCB-root アルゴリズムに変更
                     double bestScore = -DBL_MAX;
-                    const double allSize = proot->monteCarloAllScore.size();
+                    const double allSize = view.allScore.size();
                     for(int c = 0; c < candidates; ++c){
+                        if(proot->isRejected(c))continue; // 打ち切り判定で除外された
                         double tmpScore;
-                        double size = child[c].size();
-                        if(child[c].simulations < MINNEC_N_TRIALS){
+                        double size = view.size(c);
+                        if(view.simulations[c] < MINNEC_N_TRIALS){
                             // 最低プレイアウト数をこなしていないものは、大きな値にする
                             // ただし最低回数のもののうちどれかがランダムに選ばれるようにする
-                            tmpScore = (double)((1U << 16) - (child[c].simulations << 8) + (dice.rand() % (1U << 6)));
+                            tmpScore = (double)((1U << 16) - (view.simulations[c] << 8) + (dice.rand() % (1U << 6)));
                         }else{
-                            ASSERT(size, cerr << child[c].toString() << endl;);
-                            tmpScore = child[c].mean() + 0.7 * sqrt(sqrt(allSize) / size); // ucbr値
+                            ASSERT(size, cerr << view.score[c] << endl;);
+                            tmpScore = view.mean(c) + 0.7 * sqrt(sqrt(allSize) / size); // ucbr値
                         }
                         if(tmpScore > bestScore){
                             bestScore = tmpScore;
@@ -114,52 +251,34 @@ namespace UECda{
                 const int pastNTrials = threadNTrials[tryingIndex]++; // 選ばれたもののこれまでのトライアル数
                 threadNTrialsSum++;
                 
-                if(threadNWorlds >= threadMaxNWorlds){
-                    // このとき、世界作成は既に終わっている
-                    if(pastNTrials < threadMaxNWorlds){
-                        // まだ全ての世界でこの着手を検討していないので順番通りの世界で検討
-                        pWorld = gal.access(pastNTrials);
-                        if(!pWorld->isActive()){
-                            // 何らかの事情で世界作成スケジュールがずれている
-                            // 仕方が無いので既にある世界からランダムに選ぶ
-                            pWorld = nullptr;
-                        }
-                    }else{
-                        // 全ての世界からランダムに選ぶ
-                    }
-                }else{
-                    // 世界作成が終わっていない
-                    if(pastNTrials < threadNWorlds){
-                        // まだ全ての世界でこの着手を検討していないので順番通りの世界で検討
-                        //pWorld = gal->access(threadMaxNWorlds * threadId + pastNTrials);
-                        pWorld = gal.access(pastNTrials);
-                        
-                        if(!pWorld -> isActive()){
-                            // 何らかの事情で世界作成スケジュールがずれている
-                            // 仕方が無いので既にある世界からランダムに選ぶ
-                            pWorld = nullptr;
-                        }
-                    }else{
-                        // 新しい世界を作成し、そこにプレイアウトを割り振る
-                        //pWorld = gal->searchSpace(threadMaxNWorlds * threadId, threadMaxNWorlds);
-                        
-                        pWorld = gal.searchSpace(0 , threadMaxNWorlds);
-                        
-                        if(pWorld != nullptr){
-                            // 世界作成スペースが見つかった
-                            poTime += clock.restart();
-                            
-                            // 世界作成
-                            estimator.create(pWorld, Settings::monteCarloDealType,
-                                             *pfield, *pshared, ptools);
-                            
-                            estTime += clock.restart();
+                {
+                    // 同じスレッドの中では、各着手のk回目の検討は同じ世界で行う
+                    // スレッドごとに世界の番号をずらして、他のスレッドと同じ世界ばかりにならないようにする
+                    // 探索に参加するスレッド数ごとに進めて、世界プールを隙間なく使う
+                    const int worldIndex = pastNTrials * proot->workers + threadId;
+                    if(worldIndex < gal.size()){
+                        pWorld = gal.access(worldIndex);
+                        if(pWorld == nullptr){
+                            // まだその世界が無いので、その番号のスペースを確保して新しい世界を作成する
+                            // 他のスレッドが作成中なら待たずに、既にある世界からランダムに選ぶ
+                            pWorld = gal.reserve(worldIndex);
                             
-                            if(gal.regist(pWorld) != 0){ // 登録失敗
-                                // 仕方が無いので既にある世界からランダムに選ぶ
-                                pWorld = nullptr;
-                            }else{
-                                ++threadNWorlds; // 当スレッドの作成世界数up
+                            if(pWorld != nullptr){
+                                // 世界作成スペースが確保できた
+                                poTime += clock.restart();
+                                
+                                // 世界作成
+                                estimator.create(pWorld, Settings::monteCarloDealType,
+                                                 *pfield, *pshared, ptools);
+                                
+                                estTime += clock.restart();
+                                
+                                if(gal.regist(pWorld) != 0){ // 登録失敗
+                                    // 仕方が無いので既にある世界からランダムに選ぶ
+                                    pWorld = nullptr;
+                                }else{
+                                    ++threadNWorlds; // 当スレッドの作成世界数up
+                                }
                             }
                         }
                     }
@@ -171,13 +290,8 @@ namespace UECda{
                 
                 // この時点で世界が決まっていない場合はランダムに選ぶ
                 if(pWorld == nullptr){
-                    if(threadNWorlds > 0){
-                        //pWorld=gal->pickRand( threadMaxNWorlds*threadId, threadNWorlds, &dice );
-                        pWorld = gal.pickRand(0, threadNWorlds, &dice);
-                        if(pWorld == nullptr){
-                            goto THREAD_EXIT; // どうしようもないのでスレッド強制終了
-                        }
-                    }else{
+                    pWorld = gal.pickRand(&dice);
+                    if(pWorld == nullptr){
                         goto THREAD_EXIT; // どうしようもないのでスレッド強制終了
                     }
                 }
@@ -189,7 +303,12 @@ namespace UECda{
                 
                 // ここでプレイアウト実行
                 // alphaカットはしない
+                if(Settings::commonRandomNumbers){
+                    mainDice = dice;
+                    dice.srand(commonRandomSeed(proot->randomSeed, pWorld - gal.world, pastNTrials));
+                }
                 PlayouterField f;
+                TreeTrial trial; // 探索木を使う場合は自分の次の手番で使う
                 if(proot->isChange){
                     copyField(pf, &f);
                     setWorld(pf, *pWorld, &f);
@@ -202,73 +321,56 @@ namespace UECda{
                     //CERR << f.phase << endl;
                     setWorld(pf, *pWorld, &f);
                     //CERR << f.phase << endl;
-                    po.startRoot(&f, child[tryingIndex].move, pshared, ptools);
+                    if(Settings::searchTree)trial.set(myPlayerNum);
+                    po.startRoot(&f, child[tryingIndex].move, pshared, ptools, &trial);
+                }
+                if(Settings::commonRandomNumbers){
+                    dice = mainDice;
                 }
                 //int r = std::rand() % 5;
                 
                 //CERR << "TRIAL : " << i << " " << moves.getMoveById(tryingIndex) << " : " << r << endl;
                 
-                proot->feedSimulationResult(tryingIndex, f, pshared); // 結果をセット(排他制御は関数内で)
+                proot->feedSimulationResult(threadId, tryingIndex, f, pshared); // 結果をセット(自スレッドの領域へ)
+                if(trial.edge >= 0){ // 探索木を通った
+                    pshared->tree.feed(trial.edge, (f.infoReward[myPlayerNum] - proot->worstReward) / (double)proot->rewardGap);
+                }
                 if(proot->exitFlag){
                     goto THREAD_EXIT;
                 }
                 
+                if(proot->limitTime){
+                    // 実時間による打ち切り
+                    // 目安時刻を過ぎた時点で最善手が抜けていれば終了、拮抗していれば打ち切り時刻まで続ける
+                    const uint64_t t = TimeManager::now();
+                    if(t >= proot->hardLimitTime
+                       || (t >= proot->limitTime && view.separation(candidates) >= TimeManager::UNCERTAIN_SEPARATION)){
+                        proot->exitFlag = true;
+                        goto THREAD_EXIT;
+                    }
+                }
+                
                 poTime += clock.restart();
                 
 #ifndef FIXED_N_PLAYOUTS
                 if(threadId == 0
-                   && threadNTrialsSum % max(4, 32 / N_THREADS) == 0
+                   && threadNTrialsSum % max(4, 32 / proot->threads()) == 0
                    //root->simulations % 32 == 0
-                   && proot->allSimulations > candidates * MINNEC_N_TRIALS
+                   && view.allSimulations > candidates * MINNEC_N_TRIALS
                    ){
                     
-                    //cerr<<"cut ";
-                    
-                    // Regretによる打ち切り判定
-                    struct Dist{ double mean,sem,reg; };
-                    // time
-                    const double tmpClock = (double)poTime;
-                    
-                    const double line = -1600.0 * ((double)(2 * tmpClock * VALUE_PER_CLOCK)) / (double)proot->rewardGap;
-                    
-                    // regret check
-                    Dist d[N_MAX_MOVES + 64];
-                    for(int m = 0; m < candidates; ++m){
-                        d[m].reg = 0.0;
-                        d[m].mean = child[m].mean();
-                        
-                        ASSERT(child[m].size(), cerr << child[m].toString() << endl;);
-                        
-                        d[m].sem = sqrt(child[m].mean_var()); // 推定平均値の分散
-                        //cerr << d[m].sem << endl;
+                    bool stop;
+                    switch(Settings::rootStoppingRule){
+                        case StoppingRule::RACING:
+                            stop = checkStoppingByRacing(proot, view, candidates); break;
+                        case StoppingRule::PROB_BEST:
+                            stop = checkStoppingByProbBest(proot, view, candidates, &dice); break;
+                        default:
+                            stop = checkStoppingByRegret(proot, view, candidates, poTime, &dice); break;
                     }
-                    for(int t = 0; t < 1600; ++t){
-                        double tmpBest = -1.0;
-                        double tmpScore[256];
-                        for(int m = 0; m < candidates; ++m){
-                            const Dist& tmpD = d[m];
-                            NormalDistribution<double> norm(tmpD.mean, tmpD.sem);
-                            double tmpDBL = norm.rand(&dice);
-                            tmpScore[m] = tmpDBL;
-                            if(tmpDBL > tmpBest){
-                                tmpBest = tmpDBL;
-                            }
-                        }
-                        for(int m = 0; m < candidates; ++m){
-                            d[m].reg += (tmpScore[m] - tmpBest);
-                        }
-                    }
-                    
-                    for(int m = 0; m < candidates; ++m){
-                        if(d[m].reg > line){
-                            /*cerr<<"simulations = " << proot->simulations << " childs = "<<candidates<<" line = "<<line<<endl;
-                             for(int mm=0;mm<candidates;mm++){
-                             cerr<<d[mm].reg<<endl;
-                             }
-                             getchar();*/
-                            proot->exitFlag = 1;
-                            goto THREAD_EXIT;
-                        }
+                    if(stop){
+                        proot->exitFlag = 1;
+                        goto THREAD_EXIT;
                     }
                 }
 #endif // FIXED_N_PLAYOUTS
@@ -57,7 +57,6 @@ namespace UECda{
         BitArray64<11, N_PLAYERS> infoReward; // rewards
         uint32_t domFlags;
         uint32_t NNullFields;
-        std::bitset<32> flags;
         
         // information for playout
         int depth;
@@ -98,18 +97,16 @@ namespace UECda{
         uint64_t aliveKey, fullAwakeKey;
         
         // 手札
+        // 相手手札は残り手札と手札の差から必要な時に作り、局面が進むまでプレーヤーごとに覚えておく
         Hand hand[N_PLAYERS];
-        Hand opsHand[N_PLAYERS];
+        mutable Hand opsHandCache[N_PLAYERS];
+        mutable uint32_t opsHandValid; // opsHandCache のうち有効なプレーヤーのビット集合
         // 手札情報
         Cards usedCards[N_PLAYERS];
         Cards sentCards[N_PLAYERS];
         Cards recvCards[N_PLAYERS];
         Cards dealtCards[N_PLAYERS];
         
-        // value for calculating policy
-        PlayerPolicySubValue playerPolicyValue[N_PLAYERS];
-        PolicySubValue policyValue;
-        
         bool isL2Situation()const noexcept{ return getNAlivePlayers() == 2; }
         bool isLnCISituation()const noexcept{
             return hand[getTurnPlayer()].qty > 1U // 1枚なら探索しても意味無し
@@ -192,12 +189,27 @@ namespace UECda{
         void setFirstTurnPlayer(int p)noexcept{ infoSpecialPlayer.assign(3, p); }
         
         Cards getCards(int p)const{ return hand[p].getCards(); }
-        Cards getOpsCards(int p)const{ return opsHand[p].getCards(); }
+        Cards getOpsCards(int p)const{ return subtrCards(remCards, hand[p].getCards()); }
         uint32_t getNCards(int p)const{ return hand[p].getQty(); }
         Cards getRemCards()const noexcept{ return remCards; }
         Cards getNRemCards()const noexcept{ return remQty; }
         const Hand& getHand(int p)const{ return hand[p]; }
-        const Hand& getOpsHand(int p)const{ return opsHand[p]; }
+        const Hand& getOpsHand(int p)const{
+            // 返した参照は局面が進むまで有効
+            if(!(opsHandValid & (1U << p))){
+                Hand& opsHand = opsHandCache[p];
+                const Cards c = getOpsCards(p);
+                if(anyCards(c)){
+                    opsHand.set(c);
+                }else{
+                    opsHand.init();
+                }
+                opsHand.setHash(remHash ^ hand[p].hash);
+                opsHandValid |= 1U << p;
+            }
+            return opsHandCache[p];
+        }
+        void invalidateOpsHand()const noexcept{ opsHandValid = 0; }
         
         uint64_t getRemCardsHash()const noexcept{ return remHash; }
         Cards getUsedCards(int p)const{ return usedCards[p]; }
@@ -356,18 +368,10 @@ namespace UECda{
             remQty -= dq;
             remHash ^= dhash;
             
-            // 出したプレーヤーの手札とそれ以外のプレーヤーの相手手札を更新
-            for(int p = 0; p < tp; ++p){
-                if(isAlive(p)){
-                    opsHand[p].makeMoveAll(mv, dc, dq, dhash);
-                }
-            }
-            hand[tp].makeMoveAll(mv, dc, dq, dhash);
-            for(int p = tp + 1; p < N_PLAYERS; ++p){
-                if(isAlive(p)){
-                    opsHand[p].makeMoveAll(mv, dc, dq, dhash);
-                }
-            }
+            // 出したプレーヤーの手札を更新
+            // 無支配型等の後半は使う時に計算する
+            hand[tp].makeMove1stHalfAll(mv, dc, dq, dhash);
+            invalidateOpsHand();
             procRecordHash(tp, dhash); // 棋譜ハッシュ値の更新
             procNumCardsHash(tp); // 手札枚数ハッシュ値の更新
         }
@@ -386,11 +390,7 @@ namespace UECda{
             
             assert(!isAlive(tp)); // agari player is not alive
             
-            for(int p = 0; p < N_PLAYERS; ++p){
-                if(isAlive(p)){
-                    opsHand[p].makeMoveAll(mv, dc, dq, dhash);
-                }
-            }
+            invalidateOpsHand();
             procRecordHash(tp, dhash); // 棋譜ハッシュ値の更新
             procNumCardsHash(tp); // 手札枚数ハッシュ値の更新
         }
@@ -500,8 +500,7 @@ namespace UECda{
             uint64_t dhash = CardsToHashKey(dc);
             hand[from].subtrAll(dc, dq, dhash);
             hand[to].addAll(dc, dq, dhash);
-            opsHand[from].addAll(dc, dq, dhash);
-            opsHand[to].subtrAll(dc, dq, dhash);
+            invalidateOpsHand();
             //cerr << "from = " << from << " to = " << to << " dc = " << OutCards(dc) << endl;
             //cerr << toDebugString(); getchar();
         }
@@ -531,25 +530,25 @@ namespace UECda{
                 int dq = N_CHANGE_CARDS(cl);
                 
                 hand[from].subtrAll(dc, dq, dhash);
-                opsHand[from].addAll(dc, dq, dhash);
             }
+            invalidateOpsHand();
         }
         
         void setHand(int p, Cards ac)noexcept{
             hand[p].setAll(ac);
-        }
-        void setOpsHand(int p, Cards ac)noexcept{
-            opsHand[p].setAll(ac);
+            invalidateOpsHand();
         }
         void setRemHand(Cards ac)noexcept{
             remCards = ac;
             remQty = countCards(ac);
             remHash = HASH_CARDS_ALL ^ CardsToHashKey(subtrCards(CARDS_ALL, ac));
+            invalidateOpsHand();
         }
         void fillRemHand(Cards ac)noexcept{
             remCards = CARDS_ALL;
             remQty = countCards(CARDS_ALL);
             remHash = HASH_CARDS_ALL;
+            invalidateOpsHand();
         }
         
         bool exam()const{
@@ -632,10 +631,6 @@ namespace UECda{
             return true;
         }
         
-        void initForPlayout()noexcept{
-            flags.reset();
-        }
-        
         void prepareForPlay(bool isRoot = false)noexcept{
             
             int tp = getTurnPlayer();
@@ -662,7 +657,7 @@ namespace UECda{
                         fieldInfo.setFlushLead();
                         if(fieldInfo.isLastAwake()){
                         }else{
-                            if(dominatesHand(getBoard(), opsHand[tp])){
+                            if(dominatesHand(getBoard(), getOpsHand(tp))){
                                 // 場が全員を支配しているので、パスをすれば自分から
                                 fieldInfo.setBDO();
                                 fieldInfo.setPassDom(); // fl && bdo ならパス支配
@@ -1001,6 +996,7 @@ namespace UECda{
         dst->remCards = arg.remCards;
         dst->remQty = arg.remQty;
         dst->remHash = arg.remHash;
+        dst->invalidateOpsHand();
     }
     
     // initialize and set PlayouterField by subjevtive information
@@ -1060,10 +1056,9 @@ namespace UECda{
         // because card-position will be set in the opening of each playout.
         for(int p = 0; p < N_PLAYERS; ++p){
             dst->hand[p].qty = arg.getNCards(p);
-            dst->opsHand[p].qty = arg.getNRemCards() - arg.getNCards(p);
         }
         dst->hand[arg.getMyPlayerNum()].setAll(arg.getMyCards());
-        dst->opsHand[arg.getMyPlayerNum()].setAll(arg.getOpsCards());
+        dst->invalidateOpsHand();
     }
     
     template<class sbjField_t, class policy_t>
@@ -1077,23 +1072,18 @@ namespace UECda{
     template<class sbjField_t, class world_t>
     void setWorld(const sbjField_t& field, const world_t& world, PlayouterField *const dst)noexcept{
         
-        Cards remCards = field.getRemCards();
-        uint64_t remHash = field.getRemCardsHash();
-        
         for(int p = 0; p < N_PLAYERS; ++p){
             if(field.isAlive(p)){
                 // only alive players
-                uint64_t myHash = world.getCardsHash(p);
-                
-                dst->hand[p].set(world.getCards(p));
-                dst->hand[p].setHash(myHash);
-                dst->opsHand[p].set(subtrCards(remCards, world.getCards(p)));
-                dst->opsHand[p].setHash(remHash ^ myHash);
+                dst->hand[p].set1stHalf(world.getCards(p));
+                dst->hand[p].setHash(world.getCardsHash(p));
             }else{
                 // alive でないプレーヤーも手札枚数だけセットしておく
                 dst->hand[p].qty = 0;
             }
         }
+        // 相手手札は使う時に残り手札から作る
+        dst->invalidateOpsHand();
     }
     
     template<class sbjField_t, class world_t, class policy_t>
@@ -1227,6 +1217,8 @@ namespace UECda{
         
         void proc(const int p, const Move mv, const Cards dc){
             // 世界死がおきずに進行した
+            subtrCards(&cards[p], dc);
+            hash_cards[p] ^= CardsToHashKey(dc);
             //uint64_t dhash = CardsToHashKey(dc);
             //uint32_t dq = mv.qty();
             
@@ -12,6 +12,15 @@
 #include "../../structure/primitive/prim2.hpp"
 
 #include "playout.h"
+#include "searchTree.hpp"
+
+#ifdef TABLE_MOVE_GENERATOR
+#include "../../generator/tableMoveGenerator.hpp"
+#endif
+
+#ifdef STAGED_MOVE_GENERATION
+#include "../../generator/stagedMoveGenerator.hpp"
+#endif
 
 #ifdef MODELING_PLAY
 #include "../model/playerBias.hpp"
@@ -48,11 +57,14 @@ namespace UECda{
             template<int M = 0, class sharedData_t, class threadTools_t>
             int startAll(PlayouterField *const, sharedData_t *const, threadTools_t *const);
             
+            // ptrial を渡すと、そのプレーヤーの最初の手番の着手を探索木で選ぶ
             template<int M = 0, class sharedData_t, class threadTools_t>
-            int startRoot(PlayouterField *const, sharedData_t *const, threadTools_t *const);
+            int startRoot(PlayouterField *const, sharedData_t *const, threadTools_t *const,
+                          TreeTrial *const ptrial = nullptr);
             
             template<int M = 0, class sharedData_t, class threadTools_t>
-            int startRoot(PlayouterField *const, MoveInfo, sharedData_t *const, threadTools_t *const);
+            int startRoot(PlayouterField *const, MoveInfo, sharedData_t *const, threadTools_t *const,
+                          TreeTrial *const ptrial = nullptr);
             
             constexpr Playouter()
             //:mode()
@@ -65,13 +77,17 @@ namespace UECda{
         template<int M, class sharedData_t, class threadTools_t>
         int Playouter::startRoot(PlayouterField *const pfield,
                                  sharedData_t *const pshared,
-                                 threadTools_t *const ptools){
+                                 threadTools_t *const ptools,
+                                 TreeTrial *const ptrial){
             double progress = 1;
-            pfield->initForPlayout();
             while(1){
                 DERR << pfield->toString();
                 DERR << "turn : " << pfield->getTurnPlayer() << endl;
                 uint32_t tp = pfield->getTurnPlayer();
+                
+                // 探索木で着手を選ぶ手番か(一度きり)
+                const bool treeTurn = ptrial != nullptr && ptrial->player == (int)tp;
+                if(treeTurn){ ptrial->player = -1; }
 
                 pfield->prepareForPlay();
 
@@ -82,8 +98,7 @@ namespace UECda{
 
                     ASSERT(pfield->isAlive(blackPlayer) && pfield->isAlive(whitePlayer),);
 
-                    L2Judge l2(65536, pfield->mv);
-                    int l2Result = l2.start_judge(pfield->hand[blackPlayer], pfield->hand[whitePlayer], pfield->bd, pfield->fieldInfo);
+                    int l2Result = ptools->l2.start_judge(pfield->hand[blackPlayer], pfield->hand[whitePlayer], pfield->bd, pfield->fieldInfo);
 
                     //std::swap(blackPlayer, whitePlayer); <- for debug
 
@@ -102,63 +117,113 @@ namespace UECda{
 
 #ifdef SEARCH_LEAF_LNCI
                     // Ln完全情報探索に入る
-                    LnCIJudge cij(pfield->mv);
+                    LnCIJudge cij(pfield->mv, pshared->gameReward, Settings::LnCINodesInSimulation);
                     BitArray64<11, N_PLAYERS> reward(0);
 
                     BitSet32 attractedPlayers = pfield->attractedPlayers;
                     
                     attractedPlayers.set(pfield->getTurnPlayer());
                     
-                    cij.start(&reward, *pfield, attractedPlayers); // ここでCI探索開始
+                    // ここでCI探索開始
+                    // 読み切れなければプレイアウトを続ける
+                    if(cij.start(&reward, *pfield, attractedPlayers) != -1){
 
-                    //cerr<<pfield->toDebugString();
-                    
-                    uint32_t bestReward = pshared->gameReward[pfield->getBestClass()];
-                    
-                    if(search(pfield->attractedPlayers, [reward, bestReward](uint32_t pn)->bool{
-                        if (reward[pn] > bestReward){
-                            //cerr<<"reward = "<<reward<<" bestReward = "<<bestReward<<endl;getchar();
-                            return true; // continue playout due to wrong reward
-                        }else{
-                            return false;
-                        }
-                    }) == -1){
-                        // rewards might be OK
                         //cerr<<pfield->toDebugString();
                         
-                        //cerr<<reward<<endl;getchar();
-                        iterate(pfield->attractedPlayers, [reward, pfield](uint32_t pn)->void{
-                            pfield->infoReward.assign(pn, reward[pn]);
-                        });
-                        return 0;
+                        uint32_t bestReward = pshared->gameReward[pfield->getBestClass()];
+                        
+                        if(search(pfield->attractedPlayers, [reward, bestReward](uint32_t pn)->bool{
+                            if (reward[pn] > bestReward){
+                                //cerr<<"reward = "<<reward<<" bestReward = "<<bestReward<<endl;getchar();
+                                return true; // continue playout due to wrong reward
+                            }else{
+                                return false;
+                            }
+                        }) == -1){
+                            // rewards might be OK
+                            // 上がったプレーヤーの報酬は階級から、残りのプレーヤーの報酬は探索結果から
+                            for(int p = 0; p < N_PLAYERS; ++p){
+                                if(pfield->isAlive(p)){
+                                    pfield->infoReward.replace(p, reward[p]);
+                                }else{
+                                    pfield->infoReward.replace(p, pshared->gameReward[pfield->getPlayerNewClass(p)]);
+                                }
+                            }
+                            return 0;
+                        }
                     }
 #endif // SEARCH_LEAF_LNCI
                 }
 
-                // 合法着手生成
-                pfield->NMoves = pfield->NActiveMoves = genMove(pfield->mv, pfield->hand[tp].cards, pfield->bd);
-                if(pfield->NMoves == 1){
-                    pfield->setPlayMove(pfield->mv[0]);
-                }else{
-                    // search mate-move
-                    //int idxMate = searchHandMate(0, pfield->mv, pfield->NActiveMoves, pfield->hand[tp], pfield->opsHand[tp], pfield->bd, 1, 1);
-                    int idxMate = -1;
+                // 必勝手の探索(mv[first] ~ mv[last - 1] の中から)
+                auto searchMate = [&](int first, int last)->int{
 #ifdef SEARCH_LEAF_MATE
                     if(Settings::MateSearchInSimulation){
                         int mateIndex[N_MAX_MOVES];
                         int mates = 0;
-                        for(int m = 0; m < pfield->NActiveMoves; ++m){
-                            bool mate = checkHandMate(0, pfield->mv + pfield->NActiveMoves, pfield->mv[m],
-                                                      pfield->hand[tp], pfield->opsHand[tp], pfield->bd, pfield->fieldInfo);
+                        for(int m = first; m < last; ++m){
+                            bool mate = checkHandMate(0, pfield->mv + last, pfield->mv[m],
+                                                      pfield->hand[tp], pfield->getOpsHand(tp), pfield->bd, pfield->fieldInfo);
                             if(mate){ mateIndex[mates++] = m; }
                         }
                         if(mates == 1){
-                            idxMate = mateIndex[0];
+                            return mateIndex[0];
                         }else if(mates > 1){ // 探索順バイアス回避のために必勝全部の中からランダムに選ぶ
-                            idxMate = mateIndex[ptools->dice.rand() % mates];
+                            return mateIndex[ptools->dice.rand() % mates];
                         }
                     }
 #endif // SEARCH_LEAF_MATE
+                    return -1;
+                };
+                
+                // 合法着手生成
+                int idxMate = -1;
+#if defined(STAGED_MOVE_GENERATION) && !defined(MOVE_CACHE)
+                {
+                    // 種類ごとに生成しつつ必勝手を探し、見つかればそれより後の種類は生成しない
+                    // 必勝手はその種類の中だけから選ぶので、全必勝手からの一様な選択にはならない
+                    StagedMoveGenerator staged(pfield->hand[tp].cards, pfield->bd);
+                    int known = 0; // 階段以外の着手数
+                    for(int st = 0; st < MOVE_STAGE_SEQ; ++st){ known += staged.count(st); }
+                    // 着手が1つだけの場合には必勝判定をしないので、2つ以上あると分かっている場合のみ途中で探す
+                    const bool lazy = known >= 2;
+                    int moves = 0;
+                    for(int st = 0; st < N_MOVE_STAGES; ++st){
+                        if(staged.empty(st)){ continue; }
+                        const int first = moves;
+                        moves += staged.generate(pfield->mv + moves, st);
+                        if(lazy){
+                            idxMate = searchMate(first, moves);
+                            if(idxMate != -1){ break; }
+                        }
+                    }
+                    pfield->NMoves = pfield->NActiveMoves = moves;
+                    if(!lazy && moves > 1){
+                        idxMate = searchMate(0, moves);
+                    }
+                }
+#else
+#ifdef MOVE_CACHE
+                pfield->NMoves = pfield->NActiveMoves = ptools->moveCache.genMove(pfield->mv, pfield->hand[tp].cards, pfield->hand[tp].hash, pfield->bd,
+                                                                                  [](MoveInfo *const mv, const Cards c, const Board bd)->int{
+#ifdef TABLE_MOVE_GENERATOR
+                    return genMoveByTable(mv, c, bd);
+#else
+                    return genMove(mv, c, bd);
+#endif
+                });
+#elif defined(TABLE_MOVE_GENERATOR)
+                pfield->NMoves = pfield->NActiveMoves = genMoveByTable(pfield->mv, pfield->hand[tp].cards, pfield->bd);
+#else
+                pfield->NMoves = pfield->NActiveMoves = genMove(pfield->mv, pfield->hand[tp].cards, pfield->bd);
+#endif
+                if(pfield->NMoves > 1){
+                    idxMate = searchMate(0, pfield->NMoves);
+                }
+#endif
+                if(pfield->NMoves == 1 && idxMate == -1){
+                    pfield->setPlayMove(pfield->mv[0]);
+                }else{
                     if(idxMate != -1){ // mate
                         pfield->setPlayMove(pfield->mv[idxMate]);
                         pfield->playMove.setMPMate();
@@ -170,11 +235,31 @@ namespace UECda{
                             double score[N_MAX_MOVES + 1];
 
                             // 行動評価関数を計算
+#ifdef FAST_PLAY_POLICY
+                            if(M == 0){
+#ifdef QUANTIZED_PLAY_POLICY
+                                calcPlayPolicyScoreFast(score, *pfield, pshared->simulationPlayPolicy);
+#else
+                                calcPlayPolicyScoreFast(score, *pfield, pshared->basePlayPolicy);
+#endif
+                            }else{
+                                calcPlayPolicyScoreSlow<M>(score, *pfield, pshared->basePlayPolicy);
+                            }
+#else
                             calcPlayPolicyScoreSlow<M>(score, *pfield, pshared->basePlayPolicy);
+#endif
 
                             // 行動評価関数からの着手の選び方は複数パターン用意して実験できるようにする
-                            int idx;
-                            if(Settings::simulationSelector == Selector::EXP_BIASED){
+                            int idx = -1;
+                            if(treeTurn){
+                                // 探索木の節での選択
+                                ptrial->edge = pshared->tree.select(pfield->getSubjectiveHashKey(tp),
+                                                                    pfield->mv, pfield->NActiveMoves, score);
+                                if(ptrial->edge >= 0){ idx = pshared->tree.moveIndex(ptrial->edge); }
+                            }
+                            if(idx >= 0){
+                                // 選択済み
+                            }else if(Settings::simulationSelector == Selector::EXP_BIASED){
                                 // 点差の指数増幅
                                 ExpBiasedSoftmaxSelector selector(score, pfield->NActiveMoves,
                                                                   Settings::simulationTemperaturePlay,
@@ -185,8 +270,13 @@ namespace UECda{
                                     addPlayerPlayBias(score, pfield->mv, pfield->NActiveMoves, *pfield, pshared->playerModelSpace.model(tp), Settings::playerBiasCoef * progress);
 #endif
                                 }
+#ifdef FAST_SOFTMAX_SAMPLING
+                                selector.amplify_fast();
+                                selector.to_prob_fast();
+#else
                                 selector.amplify();
                                 selector.to_prob();
+#endif
                                 idx = selector.select(ptools->dice.drand());
                             }else if(Settings::simulationSelector == Selector::POLY_BIASED){
                                 // 点差の多項式増幅
@@ -199,8 +289,13 @@ namespace UECda{
                                     addPlayerPlayBias(score, pfield->mv, pfield->NActiveMoves, *pfield, pshared->playerModelSpace.model(tp), Settings::playerBiasCoef * progress);
 #endif
                                 }
+#ifdef FAST_SOFTMAX_SAMPLING
+                                selector.amplify_fast();
+                                selector.to_prob_fast();
+#else
                                 selector.amplify();
                                 selector.to_prob();
+#endif
                                 idx = selector.select(ptools->dice.drand());
                             }else if(Settings::simulationSelector == Selector::THRESHOLD){
                                 // 閾値ソフトマックス
@@ -240,13 +335,14 @@ namespace UECda{
         int Playouter::startRoot(PlayouterField *const pfield,
                                  MoveInfo mv,
                                  sharedData_t *const pshared,
-                                 threadTools_t *const ptools){
+                                 threadTools_t *const ptools,
+                                 TreeTrial *const ptrial){
             DERR << pfield->toString();
             DERR << "turn : " << pfield->getTurnPlayer() << endl;
             if(pfield->procSlowest(mv) == -1){
                 return 0;
             }
-            return startRoot(pfield, pshared, ptools);
+            return startRoot(pfield, pshared, ptools, ptrial);
         }
 
         template<int M, class sharedData_t, class threadTools_t>
@@ -0,0 +1,175 @@
+/*
+ searchTree.hpp
+ Katsuki Ohto
+ */
+
+#ifndef UECDA_FUJI_SEARCHTREE_HPP_
+#define UECDA_FUJI_SEARCHTREE_HPP_
+
+// ルート直下の浅い探索木
+// ルートの候補手の後、自分の次の手番の局面を情報集合(自分から見た主観的ハッシュ値)で区別して展開する
+// 節の着手はプレイアウト方策の選択確率を事前確率とした PUCT で選ぶ
+
+#include <mutex>
+
+#include "../../settings.h"
+#include "../fuji.h"
+
+namespace UECda{
+    namespace Fuji{
+        
+        struct TreeTrial{
+            // 1回のプレイアウトでの探索木の通り道
+            int player; // 探索木で着手を選ぶプレーヤー(-1なら使わない、使った後も-1にする)
+            int edge; // 選んだ枝の番号(-1なら探索木を通らなかった)
+            
+            void set(int p)noexcept{
+                player = p; edge = -1;
+            }
+            TreeTrial(): player(-1), edge(-1){}
+        };
+        
+        template<int N_NODES = TREE_NODES, int N_EDGES = TREE_EDGES>
+        class SearchTree{
+            // 全スレッドで共有する
+            // 節の作成と枝の統計の更新は短いのでロック1つで守る
+        public:
+            constexpr static double PUCT_COEF = 1.0; // 事前確率の項の係数
+            constexpr static double REUSE_SIZE = 16; // 次の着手決定に引き継ぐ統計の最大の重み
+            
+            struct Node{
+                uint64_t key; // 情報集合のハッシュ値(0なら空き)
+                int firstEdge; // 枝配列での先頭位置
+                int edges; // 枝数
+                BetaDistribution score; // 全ての枝の結果の和
+            };
+            struct Edge{
+                Move move;
+                float prior; // 方策関数の選択確率
+                BetaDistribution score;
+            };
+            
+            SearchTree(){
+                clear();
+            }
+            
+            void clear(){
+                for(int i = 0; i < N_NODES; ++i)
+                    node_[i].key = 0;
+                nodes_ = 0;
+                usedEdges_ = 0;
+            }
+            int nodes()const noexcept{ return nodes_; }
+            
+            int select(uint64_t key, const MoveInfo *const mv, int num, const double *const score){
+                // 節 key での着手を選んで番号を返す
+                // 節が無ければ score を方策関数の出力として作る
+                // 探索木が満杯か、ハッシュ値の衝突で選べなければ -1 を返す
+                std::lock_guard<std::mutex> lock(mutex_);
+                const int ni = findOrCreate(key, mv, num, score);
+                if(ni < 0)return -1;
+                Node& nd = node_[ni];
+                const double fpu = nd.score.size() > 0 ? nd.score.mean() : 0.5; // 未訪問の枝の評価
+                const double sqrtN = sqrt(nd.score.size() + 1);
+                int best = -1;
+                double bestScore = -DBL_MAX;
+                for(int i = 0; i < num; ++i){
+                    const Edge& e = edge_[nd.firstEdge + i];
+                    const double q = e.score.size() > 0 ? e.score.mean() : fpu;
+                    const double s = q + PUCT_COEF * e.prior * sqrtN / (1 + e.score.size());
+                    if(s > bestScore){
+                        bestScore = s;
+                        best = i;
+                    }
+                }
+                return nd.firstEdge + best;
+            }
+            void feed(int ei, double r){
+                // 枝 ei を通ったプレイアウトの結果 r (0 ~ 1) を記録
+                std::lock_guard<std::mutex> lock(mutex_);
+                const BetaDistribution sc(r, 1 - r);
+                edge_[ei].score += sc;
+                node_[edgeNode_[ei]].score += sc;
+            }
+            int moveIndex(int ei)const{
+                // 枝 ei が節の何番目の着手か
+                return ei - node_[edgeNode_[ei]].firstEdge;
+            }
+            
+            const Node* find(uint64_t key)const{
+                const int ni = search(key);
+                return ni >= 0 ? &node_[ni] : nullptr;
+            }
+            BetaDistribution reusedScore(const Node& nd, Move move)const{
+                // 節 nd で move を選んだときの統計を、引き継ぎ用に重みを抑えて返す
+                for(int i = 0; i < nd.edges; ++i){
+                    const Edge& e = edge_[nd.firstEdge + i];
+                    if(e.move.data() != move.data())continue;
+                    BetaDistribution sc = e.score;
+                    if(sc.size() > REUSE_SIZE)sc *= REUSE_SIZE / sc.size();
+                    return sc;
+                }
+                return BetaDistribution(0, 0);
+            }
+        
+        private:
+            std::mutex mutex_;
+            int nodes_, usedEdges_;
+            Node node_[N_NODES]; // 開番地法のハッシュ表を兼ねる
+            Edge edge_[N_EDGES];
+            int edgeNode_[N_EDGES]; // 枝の属する節
+            
+            constexpr static int MASK = N_NODES - 1;
+            static_assert((N_NODES & MASK) == 0, "N_NODES must be a power of 2.");
+            
+            static uint64_t validKey(uint64_t key)noexcept{
+                return key != 0 ? key : 1; // 0 は空きの印なので避ける
+            }
+            int search(uint64_t key)const{
+                key = validKey(key);
+                for(int i = key & MASK; ; i = (i + 1) & MASK){
+                    if(node_[i].key == key)return i;
+                    if(node_[i].key == 0)return -1;
+                }
+            }
+            int findOrCreate(uint64_t key, const MoveInfo *const mv, int num, const double *const score){
+                key = validKey(key);
+                int i = key & MASK;
+                for(; node_[i].key != 0; i = (i + 1) & MASK){
+                    if(node_[i].key != key)continue;
+                    // 情報集合が同じなら合法手も同じ順に生成されているはず
+                    const Node& nd = node_[i];
+                    if(nd.edges != num)return -1;
+                    for(int m = 0; m < num; ++m)
+                        if(edge_[nd.firstEdge + m].move.data() != mv[m].mv().data())return -1;
+                    return i;
+                }
+                // 新しい節を作る
+                // 表の詰まりで探索が遅くならないように 3/4 までしか使わない
+                if(nodes_ >= N_NODES / 4 * 3 || usedEdges_ + num > N_EDGES)return -1;
+                double prob[N_MAX_MOVES + 64];
+                for(int m = 0; m < num; ++m)
+                    prob[m] = score[m];
+                SoftmaxSelector selector(prob, num, Settings::simulationTemperaturePlay);
+                selector.to_prob();
+                Node& nd = node_[i];
+                nd.key = key;
+                nd.firstEdge = usedEdges_;
+                nd.edges = num;
+                nd.score.set(0, 0);
+                for(int m = 0; m < num; ++m){
+                    Edge& e = edge_[usedEdges_ + m];
+                    e.move = mv[m].mv();
+                    e.prior = selector.prob(m);
+                    e.score.set(0, 0);
+                    edgeNode_[usedEdges_ + m] = i;
+                }
+                usedEdges_ += num;
+                ++nodes_;
+                return i;
+            }
+        };
+    }
+}
+
+#endif // UECDA_FUJI_SEARCHTREE_HPP_
@@ -213,6 +213,7 @@ for (int i = 0;;){os(base + i); ++i; if(i >= num)break; if(i % (x) == 0){ out <<
     //using PlayPolicyLearner = SoftmaxPolicyLearner<PlayPolicy>;
     template<typename T> using PlayPolicy = SoftmaxClassifier<PlayPolicySpace::FEA_NUM_ALL, 1, 1, T>;
     template<typename T> using PlayPolicyLearner = SoftmaxClassifyLearner<PlayPolicy<T>>;
+    template<typename T> using QuantizedPlayPolicy = QuantizedSoftmaxClassifier<PlayPolicySpace::FEA_NUM_ALL, 1, 1, T>;
     
     template<typename T>
     int foutComment(const PlayPolicy<T>& pol, const std::string& fName){
@@ -243,6 +244,22 @@ for (int i = 0;;){os(base + i); ++i; if(i >= num)break; if(i % (x) == 0){ out <<
         }
         return r / (double)cnt;
     }
+    double calcRankScoreByCount(Cards pqr, int jk, int ord){
+        // calcRankScore と同じ値をランクのビットごとの枚数から計算
+        int cnt = countCards(pqr);
+        int r = countCards(pqr & 0xF0F0F0F0F0F0F0F0ULL)
+        + 2 * countCards(pqr & 0xFF00FF00FF00FF00ULL)
+        + 4 * countCards(pqr & 0xFFFF0000FFFF0000ULL)
+        + 8 * countCards(pqr & 0xFFFFFFFF00000000ULL);
+        if(ord != ORDER_NORMAL){
+            r = (RANK_3 + RANK_2) * cnt - r;
+        }
+        if(jk){
+            r += RANK_2 + 1;
+            ++cnt;
+        }
+        return r / (double)cnt;
+    }
     
 #define Foo(i) s += pol.param(i);\
     if(!MODELING && M){ pol.feedFeatureScore(m, (i), 1.0); }
@@ -1085,6 +1102,535 @@ for (int i = 0;;){os(base + i); ++i; if(i >= num)break; if(i % (x) == 0){ out <<
                                 ){
         return calcPlayPolicyScoreSlow<M>(dst, field.mv, field.NActiveMoves, field, pol);
     }
+    
+    // 高速版
+    // 局面で不変な値を着手ループの外で計算し、着手ごとの特徴は番号の列にしてからまとめて足し合わせる
+    // 着手後の手札だけで決まる項はジョーカーの使い方違いで同じ手札が続くことが多いので直前の結果を使い回す
+    // 学習用の特徴記録は行わないので M = 0 の通常計算専用
+    
+    template<typename T>
+    auto sumFeatureParams(const T *const param, const int *const idx, const int n)->decltype(param[0] + 0){
+        decltype(param[0] + 0) s[4] = {0};
+        int k = 0;
+        for(; k + 4 <= n; k += 4){
+            s[0] += param[idx[k]];
+            s[1] += param[idx[k + 1]];
+            s[2] += param[idx[k + 2]];
+            s[3] += param[idx[k + 3]];
+        }
+        for(; k < n; ++k){
+            s[0] += param[idx[k]];
+        }
+        return (s[0] + s[1]) + (s[2] + s[3]);
+    }
+    inline float sumFeatureParams(const float *const param, const int *const idx, const int n){
+        // 4つずつ集めてSSEで加算
+        __m128 acc = _mm_setzero_ps();
+        int k = 0;
+        for(; k + 4 <= n; k += 4){
+            acc = _mm_add_ps(acc, _mm_setr_ps(param[idx[k]], param[idx[k + 1]],
+                                              param[idx[k + 2]], param[idx[k + 3]]));
+        }
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+        float s = _mm_cvtss_f32(acc);
+        for(; k < n; ++k){
+            s += param[idx[k]];
+        }
+        return s;
+    }
+    inline int sumFeatureParams(const int16_t *const param, const int *const idx, const int n){
+        // 8つずつ集めて32ビットに広げながら加算
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i acc = _mm_setzero_si128();
+        int k = 0;
+        for(; k + 8 <= n; k += 8){
+            const __m128i v = _mm_setr_epi16(param[idx[k]], param[idx[k + 1]], param[idx[k + 2]], param[idx[k + 3]],
+                                             param[idx[k + 4]], param[idx[k + 5]], param[idx[k + 6]], param[idx[k + 7]]);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(v, ones));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        int s = _mm_cvtsi128_si32(acc);
+        for(; k < n; ++k){
+            s += param[idx[k]];
+        }
+        return s;
+    }
+    
+    template<class policy_t>
+    typename policy_t::real_t sumPolicyParams(const policy_t& pol, const int *const idx, const int n){
+        return sumFeatureParams(pol.param_, idx, n);
+    }
+    template<int N_PARAMS, int N_PHASES, int N_STAGES, typename int_t>
+    float sumPolicyParams(const QuantizedSoftmaxClassifier<N_PARAMS, N_PHASES, N_STAGES, int_t>& pol,
+                          const int *const idx, const int n){
+        // 整数のまま足してから倍率をかける
+        return sumFeatureParams(pol.param_, idx, n) * pol.scale();
+    }
+    
+    template<int MODELING = 0, class move_t, class field_t, class policy_t>
+    int calcPlayPolicyScoreFast(double *const dst,
+                                move_t *const buf,
+                                const int NMoves,
+                                const field_t& field,
+                                const policy_t& pol){
+        
+        using namespace PlayPolicySpace;
+        using real_t = typename policy_t::real_t;
+        
+        // 恒常パラメータ
+        const Board bd = field.bd;
+        const int tp = field.getTurnPlayer();
+        const int turnSeat = field.getPlayerSeat(tp);
+        const int owner = field.getPMOwner();
+        const int ownerSeat = field.getPlayerSeat(owner);
+        const Hand& myHand = field.getHand(tp);
+        const Hand& opsHand = field.getOpsHand(tp);
+        const Cards myCards = myHand.getCards();
+        const int NMyCards = myHand.getQty();
+        const uint32_t oq = myHand.qty;
+        const Cards curPqr = myHand.pqr;
+        const FieldAddInfo& fieldInfo = field.fieldInfo;
+        const int NParty = calcMinNMelds(buf + NMoves, myCards);
+        const bool canMakeSeq = anyCards(myHand.seq); // 階段が作れなければ着手後も作れない
+        
+        const int myLR = IntCardToRank(pickIntCardLow(myCards));
+        const int myHR = IntCardToRank(pickIntCardHigh(myCards));
+        
+        const int order = bd.tmpOrder();
+        
+        const double nowRS = calcRankScoreByCount(curPqr, containsJOKER(myCards) ? 1 : 0, bd.tmpOrder());
+        
+        int distanceToOwner = 0;
+        if (owner != tp){
+            distanceToOwner = 1;
+            for (int s = getPreviousSeat<N_PLAYERS>(turnSeat); s != ownerSeat; s = getPreviousSeat<N_PLAYERS>(s)){
+                if (field.isAlive(field.getSeatPlayer(s))){
+                    ++distanceToOwner;
+                }
+            }
+            if(field.isAlive(owner)){ ++distanceToOwner; }
+        }
+        
+        const Cards opsCards = opsHand.getCards();
+        const Cards opsPlainCards = maskJOKER(opsCards);
+        const int opsHR = IntCardToRank(pickIntCardHigh(opsPlainCards));
+        const int opsLR = IntCardToRank(pickIntCardLow(opsPlainCards));
+        
+        // 革命の項で使う生存者の中での相対階級
+        int relativeClass = field.getPlayerClass(tp);
+        for (int r = 0; r < (int)field.getPlayerClass(tp); ++r){
+            if (!field.isAlive(field.getClassPlayer(r))){ --relativeClass; }
+        }
+        
+        // パスのみに付く特徴
+        int passIdx[4];
+        int NPassIdx = 0;
+        passIdx[NPassIdx++] = FEA_IDX(POL_PASS_PHASE) + ((field.getNRemCards() > 30) ? 0 : ((field.getNRemCards() > 15) ? 1 : 2));
+        if (fieldInfo.isPassDom()){
+            passIdx[NPassIdx++] = FEA_IDX(POL_PASS_DOM);
+            if(!fieldInfo.isUnrivaled()){
+                passIdx[NPassIdx++] = FEA_IDX(POL_PASS_DOM) + 1;
+            }
+        }
+        if(!fieldInfo.isUnrivaled()){
+            passIdx[NPassIdx++] = FEA_IDX(POL_PASS_OWNER_DISTANCE) + (distanceToOwner - 1);
+        }
+        if(owner != tp && field.isAlive(owner)){
+            passIdx[NPassIdx++] = FEA_IDX(POL_PASS_NAWAKE_OWNER)
+            + (field.getNAwakePlayers() - 2) * 8 + min(field.getNCards(owner), 8U) - 1;
+        }
+        
+        // MOパターンで使う相手のカードのあるランク
+        int NOpsRanks = 0;
+        int opsRank[16];
+        uint32_t opsSuits[16], opsQtyBits[16];
+        for(Cards tmp = CardsToER(opsPlainCards); tmp; ){
+            const int f = IntCardToRank(popIntCard(&tmp));
+            opsRank[NOpsRanks] = f;
+            opsSuits[NOpsRanks] = (opsCards >> (f * 4)) & SUITS_ALL;
+            opsQtyBits[NOpsRanks] = (opsHand.pqr >> (f * 4)) & SUITS_ALL;
+            ++NOpsRanks;
+        }
+        
+        // 着手後の手札の項の使い回し
+        Cards lastAfterCards = CARDS_NULL;
+        int lastAfterOrder = -1;
+        real_t handScore = 0;
+        
+        int idx[256];
+        
+        for (int m = 0; m < NMoves; ++m){
+            
+            MoveInfo& mv = buf[m];
+            real_t s = 0;
+            
+            if(mv.isMate() || !anyCards(subtrCards(myCards, mv.cards()))){
+                s -= 1000; // Mateのときは低い点にする
+            }else{
+                const int aftOrd = bd.afterTmpOrder(mv.mv());
+                const int q4 = min(mv.qty(), 4U);
+                
+                const Cards afterCards = subtrCards(myCards, mv.cards());
+                const Cards afterPqr = CardsToPQR(afterCards);
+                
+                const int afterOrder = aftOrd;
+                
+                int n = 0; // 重み1の特徴の数
+                real_t sx = 0; // 値付きの特徴の点
+                
+                if(afterCards != lastAfterCards || afterOrder != lastAfterOrder){
+                    // 着手後の手札の項
+                    real_t hx = 0;
+                    
+                    // snowl score
+                    {
+                        int base = FEA_IDX(POL_HAND_SNOWL);
+                        
+                        if(!bd.isNF()){
+                            if (fieldInfo.isUnrivaled()){
+                                base += 166 * 2;
+                            }else{
+                                base += 166;
+                            }
+                        }
+                        if (afterOrder != ORDER_NORMAL){ base += 83; }
+                        
+                        if(containsJOKER(afterCards)){
+                            idx[n++] = base + 82;
+                        }
+                        
+                        Cards tmp = maskJOKER(afterCards);
+                        
+                        Cards seq3 = polymRanks<3>(tmp);
+                        if(seq3){
+                            Cards seq4 = polymRanks<2>(seq3);
+                            if(seq4){
+                                Cards seq5 = polymRanks<2>(seq4);
+                                if(seq5){
+                                    maskCards(&seq4, extractRanks<2>(seq5));
+                                    maskCards(&seq3, extractRanks<3>(seq5));
+                                    maskCards(&tmp, extractRanks<5>(seq5));
+                                    while(1){
+                                        IntCard ic = pickIntCardLow(seq5);
+                                        idx[n++] = base + IntCardToRank(ic) - RANK_3;
+                                        maskCards(&seq5, extractRanks<5>(IntCardToCards(ic)));
+                                        if(!seq5){ break; }
+                                    }
+                                }
+                                if(seq4){
+                                    maskCards(&tmp, extractRanks<4>(seq4));
+                                    maskCards(&seq3, extractRanks<2>(seq4));
+                                    while(seq4){
+                                        IntCard ic = popIntCard(&seq4);
+                                        idx[n++] = base + 9 + IntCardToRank(ic) - RANK_3;
+                                    }
+                                }
+                            }
+                            if(seq3){
+                                maskCards(&tmp, extractRanks<3>(seq3));
+                                while(seq3){
+                                    IntCard ic = popIntCard(&seq3);
+                                    idx[n++] = base + 19 + IntCardToRank(ic) - RANK_3;
+                                }
+                            }
+                        }
+                        
+                        tmp = CardsToPQR(tmp); // 枚数位置型なのでそのままインデックスになる
+                        while(tmp){
+                            idx[n++] = base + 30 - 4 + popIntCard(&tmp);
+                        }
+                    }
+                    
+                    // joker, s3 bonus
+                    {
+                        constexpr int base = FEA_IDX(POL_HAND_S3);
+                        if(containsS3(afterCards) && containsJOKER(afterCards)){
+                            idx[n++] = base + 0;
+                        }else if(containsS3(afterCards) && containsJOKER(opsCards)){
+                            idx[n++] = base + 1;
+                        }else if (containsS3(opsCards) && containsJOKER(afterCards)){
+                            idx[n++] = base + 2;
+                        }
+                    }
+                    
+                    // avg pqr rank
+                    {
+                        double rs = calcRankScoreByCount(afterPqr, containsJOKER(afterCards) ? 1 : 0, aftOrd);
+                        hx += pol.param(FEA_IDX(POL_HAND_PQR_RANK)) * (((double)oq) * log (max(rs / nowRS, 0.000001)));
+                    }
+                    
+                    // nf min party
+                    {
+                        const int i = FEA_IDX(POL_HAND_NF_PARTY) + (bd.isNF() ? 0 : 1);
+                        const int NAfterParty = canMakeSeq ? calcMinNMelds(buf + NMoves, afterCards) : countCards(CardsToER(afterCards));
+                        hx += pol.param(i) * (NAfterParty - NParty);
+                    }
+                    
+                    // after hand joker - p8
+                    if(polymJump(maskJOKER(afterCards)) && containsJOKER(afterCards)){
+                        idx[n++] = FEA_IDX(POL_HAND_P8_JOKER);
+                    }
+                    
+                    handScore = sumPolicyParams(pol, idx, n) + hx;
+                    lastAfterCards = afterCards;
+                    lastAfterOrder = afterOrder;
+                    n = 0;
+                }
+                
+                // qty
+                if(bd.isNF()){
+                    idx[n++] = FEA_IDX(POL_MOVE_QTY) + q4 - 1;
+                }
+                
+                // same qr
+                if(bd.isNF() && !mv.isSeq()){
+                    constexpr int base = FEA_IDX(POL_SAME_QR);
+                    int sameQ = countCards(curPqr & (PQR_1 << (q4 - 1)));
+                    if (!mv.containsJOKER()){
+                        sx += pol.param(base) * sameQ;
+                    }else{
+                        sx += pol.param(base + 1) * sameQ;
+                        if(q4 > 0){ // シングルジョーカーで無い
+                            sx += pol.param(base + 2) * countCards(curPqr & (PQR_1 << (q4 - 2)));
+                        }
+                    }
+                }
+                
+                // suit lock
+                if(!mv.isPASS() && !bd.isNF()){
+                    constexpr int base = FEA_IDX(POL_SUITLOCK_EFFECT);
+                    if((!fieldInfo.isLastAwake()) && bd.locksSuits(mv.mv())){ // LAでなく、スートロックがかかる
+                        int i;
+                        if(mv.qty() > 1){
+                            i = base + 2;
+                        }else{
+                            Cards lockedSuitCards = SuitsToCards(bd.suits());
+                            Cards mine = maskJOKER(afterCards) & lockedSuitCards;
+                            if(!anyCards(maskJOKER(afterCards))){
+                                i = base + 0;
+                            }else{
+                                Cards ops = maskJOKER(opsCards) & lockedSuitCards;
+                                bool hasStrong = (afterOrder == ORDER_NORMAL) ? (mine > ops) : (pickLow(mine) < pickLow(ops));
+                                if (hasStrong){
+                                    i = base + 0;
+                                }else if(!containsS3(opsCards)
+                                         && !any2Cards(CardsToPQR(maskJOKER(afterCards)))){
+                                    i = base + 0;
+                                }else{
+                                    i = base + 1;
+                                }
+                            }
+                        }
+                        idx[n++] = i;
+                    }
+                }
+                
+                // rev(only normal order)
+                if ((!bd.isPrmOrderRev()) && mv.flipsPrmOrder()){
+                    idx[n++] = FEA_IDX(POL_REV_CLASS) + relativeClass;
+                }
+                
+                // pass
+                if (mv.isPASS()){
+                    for(int k = 0; k < NPassIdx; ++k){
+                        idx[n++] = passIdx[k];
+                    }
+                }
+                
+                // s3(move)
+                if (bd.isSingleJOKER() && mv.isS3Flush()){
+                    idx[n++] = FEA_IDX(POL_MOVE_S3) + (fieldInfo.isPassDom() ? 1 : 0);
+                }
+                
+                // joker against S3
+                if (mv.isSingleJOKER()){
+                    constexpr int base = FEA_IDX(POL_MOVE_JOKER_AGAINST_S3);
+                    if(containsS3(afterCards)){
+                        idx[n++] = base + 0;
+                    }else if (fieldInfo.isLastAwake() || (!containsCard(opsCards, CARDS_S3))){
+                        idx[n++] = base + 1;
+                    }else{
+                        idx[n++] = base + 2;
+                    }
+                }
+                
+                // sequence
+                if(bd.isNF()){
+                    if (mv.isSeq()){
+                        idx[n++] = FEA_IDX(POL_MOVE_SEQ);
+                        sx += pol.param(FEA_IDX(POL_MOVE_SEQ) + 2) * NMyCards;
+                    }
+                }else{
+                    if(bd.isSeq()){
+                        idx[n++] = FEA_IDX(POL_MOVE_SEQ) + 1;
+                    }
+                }
+                
+                // rf group break
+                if(!bd.isNF() && !fieldInfo.isUnrivaled() && mv.isSingleOrGroup() && !mv.containsJOKER()){
+                    constexpr int base = FEA_IDX(POL_MOVE_RF_GROUP_BREAK);
+                    if(myHand.qr[mv.rank()] != mv.qty()){ // 崩して出した
+                        if(mv.domInevitably()){ // 8切り
+                            idx[n++] = base;
+                        }else if(aftOrd == ORDER_NORMAL ? (mv.rank() >= opsHR) : (mv.rank() <= opsLR)){
+                            idx[n++] = base + (containsJOKER(opsCards) ? 2 : 1);
+                        }
+                    }
+                }
+                
+                // NF_Dominance Move On PassDom
+                if(fieldInfo.isPassDom()){
+                    if(mv.domInevitably() || dominatesHand(mv.mv(), opsHand, OrderToNullBoard(order))){
+                        idx[n++] = FEA_IDX(POL_MOVE_NFDOM_PASSDOM);
+                    }
+                }
+                
+                // NF_EIGHT
+                if(bd.isNF() && mv.domInevitably() && !mv.isSeq()){
+                    if(isNoRev(afterCards)){
+                        Cards seq = polymRanks<3>(afterCards);
+                        Cards weakers = (order == ORDER_NORMAL) ?
+                        RankRangeToCards(RANK_3, RANK_7) : RankRangeToCards(RANK_9, RANK_2);
+                        if(any2Cards(maskCards(afterCards & weakers, seq)) && any2Cards(maskCards(curPqr & weakers, seq))){
+                            idx[n++] = FEA_IDX(POL_MOVE_NF_EIGHT_MANY_WEAKERS);
+                        }
+                    }
+                }
+                
+                // eight
+                if(mv.domInevitably()){
+                    sx += pol.param(FEA_IDX(POL_MOVE_EIGHT_QTY)) * ((oq - mv.qty()) * (oq - mv.qty()));
+                    sx += pol.param(FEA_IDX(POL_MOVE_EIGHT_QTY) + 1) * (oq - mv.qty());
+                }
+                
+                // min rank
+                if(bd.tmpOrder() == ORDER_NORMAL){
+                    if(mv.rank() == myLR){
+                        idx[n++] = FEA_IDX(POL_MOVE_MIN_RANK);
+                    }
+                }else{
+                    if(mv.rank() == myHR){
+                        idx[n++] = FEA_IDX(POL_MOVE_MIN_RANK) + 1;
+                    }
+                }
+                
+                if(!mv.isPASS()){
+                    // MCパターン
+                    const Cards afterRanks = CardsToER(maskJOKER(afterCards));
+                    if(!mv.isSeq()){
+                        constexpr int base = FEA_IDX(POL_GR_CARDS);
+                        using Index = TensorIndexType<2, 16, 2, 16, N_PATTERNS_SUITS_SUITS>;
+                        if(mv.isSingleJOKER()){
+                            for(Cards tmp = afterRanks; tmp; ){
+                                const int f = IntCardToRank(popIntCard(&tmp));
+                                idx[n++] = base + Index::get(order, RANK_MAX + 2, 0, f, (afterPqr >> (f * 4)) & SUITS_ALL);
+                            }
+                        }else{
+                            const int lock = bd.locksSuits(mv.mv()) ? 1 : 0;
+                            for(Cards tmp = afterRanks; tmp; ){
+                                const int f = IntCardToRank(popIntCard(&tmp));
+                                idx[n++] = base + Index::get(order, mv.rank(), lock,
+                                                             f, getSuitsSuitsIndex(mv.suits(), (afterCards >> (f * 4)) & SUITS_ALL));
+                            }
+                            if(containsJOKER(afterCards)){
+                                idx[n++] = base + Index::get(order, mv.rank(), lock, RANK_MAX + 2, mv.qty());
+                            }
+                        }
+                    }else{
+                        constexpr int base = FEA_IDX(POL_SEQ_CARDS);
+                        using Index = TensorIndexType<2, 16, 3, 16, N_PATTERNS_SUIT_SUITS>;
+                        const int q3 = min(int(mv.qty()) - 3, 2);
+                        for(Cards tmp = afterRanks; tmp; ){
+                            const int f = IntCardToRank(popIntCard(&tmp));
+                            idx[n++] = base + Index::get(order, mv.rank(), q3,
+                                                         f, getSuitSuitsIndex(mv.suits(), (afterCards >> (f * 4)) & SUITS_ALL));
+                        }
+                        if(containsJOKER(afterCards)){
+                            idx[n++] = base + Index::get(order, mv.rank(), q3, RANK_MAX + 2, 0);
+                        }
+                    }
+                    
+                    // MOパターン
+                    if(!mv.isSeq()){
+                        constexpr int base = FEA_IDX(POL_GR_MO);
+                        using Index = TensorIndexType<2, 16, 2, 16, N_PATTERNS_SUITS_SUITS>;
+                        if(mv.isSingleJOKER()){
+                            for(int k = 0; k < NOpsRanks; ++k){
+                                idx[n++] = base + Index::get(order, RANK_MAX + 2, 0, opsRank[k], opsQtyBits[k]);
+                            }
+                        }else{
+                            const int lock = bd.locksSuits(mv.mv()) ? 1 : 0;
+                            for(int k = 0; k < NOpsRanks; ++k){
+                                idx[n++] = base + Index::get(order, mv.rank(), lock,
+                                                             opsRank[k], getSuitsSuitsIndex(mv.suits(), opsSuits[k]));
+                            }
+                            if(containsJOKER(opsCards)){
+                                idx[n++] = base + Index::get(order, mv.rank(), lock, RANK_MAX + 2, mv.qty());
+                            }
+                        }
+                    }else{
+                        constexpr int base = FEA_IDX(POL_SEQ_MO);
+                        using Index = TensorIndexType<2, 16, 3, 16, N_PATTERNS_SUIT_SUITS>;
+                        const int q3 = min(int(mv.qty()) - 3, 2);
+                        for(int k = 0; k < NOpsRanks; ++k){
+                            idx[n++] = base + Index::get(order, mv.rank(), q3,
+                                                         opsRank[k], getSuitSuitsIndex(mv.suits(), opsSuits[k]));
+                        }
+                        if(containsJOKER(opsCards)){
+                            idx[n++] = base + Index::get(order, mv.rank(), q3, RANK_MAX + 2, 0);
+                        }
+                    }
+                }
+                
+#ifdef MODELING_PLAY
+                // 相手行動傾向をモデル化する項
+                if(field.isNF()){
+                    constexpr int base = FEA_IDX(POL_MODEL_NF);
+                    if(mv.containsJOKER()){
+                        idx[n++] = base + 2;
+                    }else if(mv.domInevitably()){
+                        idx[n++] = base + 3;
+                    }
+                    if(mv.isGroup()){
+                        idx[n++] = base + 0;
+                    }else if(mv.isSeq()){
+                        idx[n++] = base + 1;
+                    }
+                    if(mv.flipsPrmOrder()){
+                        idx[n++] = base + 4;
+                    }
+                }else{
+                    const int base = FEA_IDX(POL_MODEL_RF) + 4 * (bd.isSeq() ? 2 : (bd.isGroup() ? 1 : 0));
+                    if(!mv.isPASS()){
+                        if(mv.containsJOKER()){
+                            if(mv.isSingleJOKER() && NMoves == 2){
+                                idx[n++] = base + 1;
+                            }else{
+                                idx[n++] = base + 2;
+                            }
+                        }else if(mv.domInevitably()){
+                            idx[n++] = base + 3;
+                        }
+                    }else{
+                        idx[n++] = base + 0;
+                    }
+                }
+#endif
+                ASSERT(n <= 256, cerr << n << endl;);
+                s = handScore + sumPolicyParams(pol, idx, n) + sx;
+            }
+            dst[m] = s;
+        }
+        return 0;
+    }
+    template<int MODELING = 0, class field_t, class policy_t>
+    int calcPlayPolicyScoreFast(double *const dst,
+                                const field_t& field,
+                                const policy_t& pol){
+        return calcPlayPolicyScoreFast<MODELING>(dst, field.mv, field.NActiveMoves, field, pol);
+    }
     template<int M = 1, class move_t, class field_t, class policy_t>
     double calcPlayPolicyExpScoreSlow(double *const dst,
                                       move_t *const buf,
@@ -0,0 +1,357 @@
+/*
+ l2DfpnJudge.hpp
+ Katsuki Ohto
+ */
+
+// ラスト2人の証明数探索(df-pn)
+// 深さ優先の L2Judge がノード数制限で打ち切られるような長い局面を、ルートで時間をかけて読み切るためのもの
+#pragma once
+
+#include "l2Judge.hpp"
+
+namespace UECda{
+    namespace Fuji{
+        
+        namespace L2{
+            
+            // 証明数と反証数の置換表
+            // 値は手番のプレーヤーから見たもので、証明数 0 が勝ち、反証数 0 が負け
+            class DfpnTable{
+            public:
+                constexpr static uint32_t INF = (1U << 30) - 1;
+                
+                void init(){
+                    memset(entry_, 0, sizeof(entry_));
+                }
+                
+                DfpnTable(){
+                    init();
+                }
+                
+                bool read(const uint64_t hash, uint32_t *const ppn, uint32_t *const pdn)const noexcept{
+                    const Entry& e = entry_[hash % SIZE];
+                    if(e.hash != hash || (e.pn == 0 && e.dn == 0)){ return false; }
+                    *ppn = e.pn;
+                    *pdn = e.dn;
+                    return true;
+                }
+                void regist(const uint64_t hash, const uint32_t pn, const uint32_t dn)noexcept{
+                    // 読み切った結果は、読み切っていない結果で上書きしない
+                    Entry& e = entry_[hash % SIZE];
+                    if(e.hash == hash && (e.pn == 0 || e.dn == 0) && pn != 0 && dn != 0){ return; }
+                    e.hash = hash;
+                    e.pn = pn;
+                    e.dn = dn;
+                }
+            
+            private:
+                constexpr static int SIZE = (1 << 18);
+                
+                struct Entry{
+                    uint64_t hash;
+                    uint32_t pn, dn;
+                };
+                Entry entry_[SIZE];
+            };
+            
+            // ルートでの探索は1スレッドからしか呼ばれないので共有しない
+            // 着手決定をまたいで結果を使い回す
+            DfpnTable dfpnTable;
+        }
+        
+        class L2DfpnJudge{
+            
+            // L2判定人(証明数探索版)
+            // L2Judge と同じ局面表現と局面遷移(procL2Field)を使い、結果の定義も同じ
+            // 新しく訪れた局面ではまず小さいノード数制限で L2Judge に判定させ、
+            // 判定できなかった局面だけを証明数と反証数で選んで展開する
+            
+            // 打ち切られても置換表に残った証明数と反証数は次の探索で使われる
+        
+        private:
+            constexpr static uint32_t INF = L2::DfpnTable::INF;
+            constexpr static int LEAF_NODE_LIMIT = 1024; // 末端での L2Judge のノード数制限
+            
+            struct Child{
+                MoveInfo mi;
+                L2Field field;
+                uint64_t hash;
+                int nextPlayer; // 0 なら手番が続く、1 なら相手の手番
+                uint32_t pn, dn; // 子局面の手番から見た証明数と反証数
+            };
+            
+            int NODE_LIMIT;
+            long TIME_LIMIT; // 探索に使える時間(マイクロ秒、0なら無制限)
+            ClockMicS clock;
+            
+            MoveInfo *buf;
+            std::vector<Child> childBuf;
+            L2Judge leafJudge;
+            
+            int nodes;
+        
+        public:
+            void init(){
+                nodes = 0;
+                clock.start();
+            }
+            
+            L2DfpnJudge(int nl, MoveInfo *const argMI, long tl = 0)
+            :
+            NODE_LIMIT(nl),
+            TIME_LIMIT(tl),
+            buf(argMI),
+            childBuf(N_MAX_MOVES * 32)
+            {
+                init();
+            }
+            
+            // 使い回す場合の設定
+            void set(int nl, long tl = 0){
+                NODE_LIMIT = nl;
+                TIME_LIMIT = tl;
+            }
+            
+            int getNodes()const noexcept{ return nodes; }
+            
+            int start_judge(const Hand& myHand, const Hand& opsHand, const Board bd, const FieldAddInfo fInfo);
+            int start_check(const MoveInfo mi, const Hand& myHand, const Hand& opsHand, const Board bd, const FieldAddInfo fInfo);
+        
+        private:
+            static uint64_t fieldHash(const Hand& myHand, const Hand& opsHand, const L2Field& field){
+                // NFでない場合は場の役と、パスや支配の状況も区別する
+                constexpr uint64_t FINFO_MASK = (1ULL << LCT64_SELFFOLLOW) | (1ULL << LCT64_UNRIVALED)
+                | (1ULL << LCT64_LASTAWAKE) | (1ULL << LCT64_FLUSHLEAD)
+                | (1ULL << LCT64_TMPORDSETTLED) | (1ULL << LCT64_DCONST);
+                return knitCardsCardsHashKey(myHand.hash, opsHand.hash) ^ (uint64_t)field.bd
+                ^ ((field.fInfo.data() & FINFO_MASK) * 0x9e3779b97f4a7c15ULL);
+            }
+            
+            int procMove(MoveInfo& tmp, const Hand& myHand, const Hand& opsHand, const L2Field& field,
+                         Hand *const pnextHand, L2Field *const pnext, int *const pnextPlayer);
+            int evaluate(MoveInfo *const mv_buf, const Hand& myHand, const Hand& opsHand, const L2Field& field);
+            int expand(MoveInfo *const mv_buf, Child *const ch_buf, const Hand& myHand, const Hand& opsHand, const L2Field& field);
+            void mid(const int depth, MoveInfo *const mv_buf, Child *const ch_buf,
+                     const Hand& myHand, const Hand& opsHand, const L2Field& field, const uint64_t hash,
+                     const uint32_t thpn, const uint32_t thdn, uint32_t *const ppn, uint32_t *const pdn);
+            int solve(const Hand& myHand, const Hand& opsHand, const L2Field& field);
+        };
+        
+        int L2DfpnJudge::procMove(MoveInfo& tmp, const Hand& myHand, const Hand& opsHand, const L2Field& field,
+                                  Hand *const pnextHand, L2Field *const pnext, int *const pnextPlayer){
+            // 着手後の局面を作る
+            // 着手だけで勝敗が決まる場合はその結果、そうでなければ L2_NONE を返す
+            // 次の手番は 0 なら自分、1 なら相手
+            // L2Judge::check と同じ判定をする
+            const bool isPass = tmp.isPASS();
+            if(!isPass && tmp.qty() >= myHand.qty){ return L2_WIN; }
+            
+            if(field.isUnrivaled() || (!isPass && dominatesCards(tmp.mv(), opsHand.getCards(), field.getBoard()))){
+                tmp.setDomOthers();
+            }
+            int conRest = 0;
+            if(!isPass){
+                if(field.isDConst()){ // 支配拘束中
+                    if(!tmp.dominatesOthers()){
+                        if(hasDWorNFH(myHand.getCards() - tmp.cards(), opsHand.cards, field.tmpOrder(), field.fInfo.isTmpOrderSettled())){
+                            return L2_LOSE; // 拘束条件違反で負けとみなす
+                        }
+                    }else{
+                        conRest = 1;
+                    }
+                }else if(field.isNF() && field.isTmpOrderSettled() && tmp.dominatesOthers()){
+                    if(hasDWorNFH(myHand.getCards() - tmp.cards(), opsHand.cards, field.tmpOrder(), field.fInfo.isTmpOrderSettled())){
+                        conRest = 1;
+                    }
+                }
+                if(field.isLastAwake() || tmp.dominatesOthers()){
+                    if(dominatesCards(tmp.mv(), myHand.getCards(), field.getBoard())){
+                        tmp.setDomMe();
+                    }
+                }
+            }
+            
+            if(!isPass){
+                makeMoveAll(myHand, pnextHand, tmp.mv());
+                *pnextPlayer = procL2Field<genTA_L2FINFO(), genTA_L2MINFO(_NO)>(field, pnext, tmp);
+            }else{
+                *pnextHand = myHand;
+                *pnextPlayer = procL2Field<genTA_L2FINFO(), genTA_L2MINFO(_YES)>(field, pnext, tmp);
+            }
+            if(conRest){ pnext->setDConst(); }
+            return L2_NONE;
+        }
+        
+        int L2DfpnJudge::evaluate(MoveInfo *const mv_buf, const Hand& myHand, const Hand& opsHand, const L2Field& field){
+            // 小さいノード数制限で深さ優先の判定を試す
+            leafJudge.set(LEAF_NODE_LIMIT, mv_buf);
+            const int res = leafJudge.start_judge(myHand, opsHand, field.bd, field.fInfo);
+            nodes += leafJudge.getNodes();
+            return res;
+        }
+        
+        int L2DfpnJudge::expand(MoveInfo *const mv_buf, Child *const ch_buf, const Hand& myHand, const Hand& opsHand, const L2Field& field){
+            // 子局面を並べる
+            // 勝ちの着手があれば -1 を返す
+            const int NMoves = genMove(mv_buf, myHand, field.getBoard());
+            int NChilds = 0;
+            for(int m = 0; m < NMoves; ++m){
+                Child& ch = ch_buf[NChilds];
+                Hand nextHand;
+                ch.mi = mv_buf[m];
+                const int res = procMove(ch.mi, myHand, opsHand, field, &nextHand, &ch.field, &ch.nextPlayer);
+                if(res == L2_WIN){ return -1; }
+                if(res == L2_LOSE){ continue; }
+                ch.hash = ch.nextPlayer ? fieldHash(opsHand, nextHand, ch.field) : fieldHash(nextHand, opsHand, ch.field);
+                if(!L2::dfpnTable.read(ch.hash, &ch.pn, &ch.dn)){
+                    ch.pn = ch.dn = 1;
+                }
+                ++NChilds;
+            }
+            return NChilds;
+        }
+        
+        void L2DfpnJudge::mid(const int depth, MoveInfo *const mv_buf, Child *const ch_buf,
+                              const Hand& myHand, const Hand& opsHand, const L2Field& field, const uint64_t hash,
+                              const uint32_t thpn, const uint32_t thdn, uint32_t *const ppn, uint32_t *const pdn){
+            assert(depth < 256);
+            ++nodes;
+            
+            // 初めての局面ではまず深さ優先で判定してみる
+            uint32_t pn, dn;
+            if(!L2::dfpnTable.read(hash, &pn, &dn)){
+                const int res = evaluate(mv_buf, myHand, opsHand, field);
+                pn = dn = 1;
+                if(res == L2_WIN){ pn = 0; dn = INF; }
+                else if(res == L2_LOSE){ pn = INF; dn = 0; }
+            }
+            // 読み切っているか閾値を超えていれば展開しない
+            if(pn == 0 || dn == 0 || pn >= thpn || dn >= thdn){
+                L2::dfpnTable.regist(hash, pn, dn);
+                *ppn = pn; *pdn = dn;
+                return;
+            }
+            // 子局面を並べる場所が無ければ展開しない
+            // 閾値に達したことにして返し、呼び出し元がこの局面ばかり選び続けないようにする
+            if(ch_buf + N_MAX_MOVES > childBuf.data() + childBuf.size()){
+                *ppn = std::max(pn, thpn); *pdn = std::max(dn, thdn);
+                return;
+            }
+            
+            const int NChilds = expand(mv_buf, ch_buf, myHand, opsHand, field);
+            if(NChilds <= 0){ // 勝ちの着手がある か 全ての着手が負け
+                pn = (NChilds < 0) ? 0 : INF;
+                dn = (NChilds < 0) ? INF : 0;
+                L2::dfpnTable.regist(hash, pn, dn);
+                *ppn = pn; *pdn = dn;
+                return;
+            }
+            
+#ifdef USE_L2BOOK
+            const int startNodes = nodes;
+#endif
+            while(1){
+                // 子局面の値を自分から見た値に直して、
+                // 証明数は最小値、反証数は和(読み切っていないのに無限大にならないようにする)
+                // 証明数が同じなら L2Judge と同じく後ろの着手を先に読む
+                int best = -1;
+                uint32_t bestPn = INF, secondPn = INF;
+                uint64_t sumDn = 0;
+                bool lost = true;
+                for(int c = NChilds - 1; c >= 0; --c){
+                    Child& ch = ch_buf[c];
+                    L2::dfpnTable.read(ch.hash, &ch.pn, &ch.dn);
+                    const uint32_t cpn = ch.nextPlayer ? ch.dn : ch.pn;
+                    const uint32_t cdn = ch.nextPlayer ? ch.pn : ch.dn;
+                    if(cpn < bestPn){
+                        secondPn = bestPn;
+                        bestPn = cpn;
+                        best = c;
+                    }else if(cpn < secondPn){
+                        secondPn = cpn;
+                    }
+                    if(cdn != 0){ lost = false; }
+                    sumDn += cdn;
+                }
+                if(bestPn == 0){
+                    pn = 0; dn = INF;
+                }else if(lost){
+                    pn = INF; dn = 0;
+                }else{
+                    pn = bestPn; dn = (uint32_t)std::min(sumDn, (uint64_t)INF - 1);
+                }
+                
+                if(pn >= thpn || dn >= thdn || nodes > NODE_LIMIT){ break; }
+                if(TIME_LIMIT && clock.stop() > TIME_LIMIT){ break; }
+                
+                // 最も証明数の小さい子局面を、2番目の証明数を超えるか反証数の余裕を使い切るまで読む
+                // 2番目の証明数には少し余裕を持たせ、子局面の間を行き来し過ぎないようにする
+                const Child& ch = ch_buf[best];
+                const uint32_t cdn = ch.nextPlayer ? ch.pn : ch.dn;
+                const uint32_t nthpn = std::min(thpn, secondPn + secondPn / 4 + 1);
+                const uint32_t nthdn = thdn - dn + cdn;
+                
+                Hand nextHand;
+                if(ch.mi.isPASS()){
+                    nextHand = myHand;
+                }else{
+                    makeMoveAll(myHand, &nextHand, ch.mi.mv());
+                }
+                uint32_t npn, ndn;
+                if(ch.nextPlayer){
+                    mid(depth + 1, mv_buf, ch_buf + NChilds, opsHand, nextHand, ch.field, ch.hash, nthdn, nthpn, &npn, &ndn);
+                }else{
+                    mid(depth + 1, mv_buf, ch_buf + NChilds, nextHand, opsHand, ch.field, ch.hash, nthpn, nthdn, &npn, &ndn);
+                }
+                // 置換表から追い出されても同じ子局面を読み直し続けないように、返り値も覚えておく
+                ch_buf[best].pn = npn;
+                ch_buf[best].dn = ndn;
+                L2::dfpnTable.regist(ch.hash, npn, ndn);
+            }
+            
+            L2::dfpnTable.regist(hash, pn, dn);
+#ifdef USE_L2BOOK
+            // 読み切った空場局面はプレイアウト中の L2Judge からも使えるようにする
+            if((pn == 0 || dn == 0) && field.isNF()){
+                L2::book.regist(pn == 0 ? L2_WIN : L2_LOSE,
+                                knitL2NullFieldHashKey(myHand.hash, opsHand.hash, NullBoardToHashKey(field.bd)),
+                                nodes - startNodes);
+            }
+#endif
+            *ppn = pn; *pdn = dn;
+        }
+        
+        int L2DfpnJudge::solve(const Hand& myHand, const Hand& opsHand, const L2Field& field){
+            uint32_t pn, dn;
+            mid(0, buf, childBuf.data(), myHand, opsHand, field, fieldHash(myHand, opsHand, field), INF, INF, &pn, &dn);
+            if(pn == 0){ return L2_WIN; }
+            if(dn == 0){ return L2_LOSE; }
+            return L2_DRAW;
+        }
+        
+        int L2DfpnJudge::start_judge(const Hand& myHand, const Hand& opsHand, const Board bd, const FieldAddInfo fInfo){
+            assert(myHand.any() && myHand.examAll() && opsHand.any() && opsHand.examAll());
+            L2Field field;
+            init();
+            convL2Field(bd, fInfo, &field);
+            return solve(myHand, opsHand, field);
+        }
+        
+        int L2DfpnJudge::start_check(const MoveInfo mi, const Hand& myHand, const Hand& opsHand, const Board bd, const FieldAddInfo fInfo){
+            assert(myHand.any() && myHand.examAll() && opsHand.any() && opsHand.examAll());
+            L2Field field, nextField;
+            Hand nextHand;
+            int nextPlayer;
+            init();
+            convL2Field(bd, fInfo, &field);
+            MoveInfo tmp = mi;
+            const int res = procMove(tmp, myHand, opsHand, field, &nextHand, &nextField, &nextPlayer);
+            if(res != L2_NONE){ return res; }
+            if(nextPlayer == 0){
+                return solve(nextHand, opsHand, nextField);
+            }else{
+                return L2_WIN + L2_LOSE - solve(opsHand, nextHand, nextField);
+            }
+        }
+    }
+}
@@ -13,6 +13,8 @@
 #include "../logic/mate.hpp"
 #include "../logic/appliedLogic.hpp"
 
+#include "l2TableBase.hpp"
+
 namespace UECda{
     namespace Fuji{
         
@@ -39,9 +41,18 @@ namespace UECda{
             // L2関連
             
             //#ifdef USE_L2BOOK
-            constexpr int BOOK_SIZE = (1 << 18);
-            TwoValueBook<BOOK_SIZE> book("L2Book");
+            // 全スレッドで共通の置換表(大きさは FujiGokoro::initGame で設定し直す)
+            TwoValueBucketBook book("L2Book", (uint64_t)L2_BOOK_MB << 20);
+            
+            // スレッドごとの置換表
+            // 共通の置換表より先に引き、共通の置換表で見つかった結果も写しておく
+            // 同じ着手決定中のプレイアウトで繰り返し現れる局面を共有メモリに触れずに返す
+            constexpr int THREAD_BOOK_SIZE = (1 << 16);
+            using ThreadBook = TwoValueBook<THREAD_BOOK_SIZE>;
             //#endif
+            
+            // 手札の少ない空場局面の勝敗表(読み込まれていなければ使わない)
+            L2TableBase tablebase;
         }
         
         enum{
@@ -275,10 +286,10 @@ namespace UECda{
             static AtomicAnalyzer<2, 8, Analysis::TYPE_SEARCH> ana;
             int mode; // 呼び出しモード
             
-            const int NODE_LIMIT;
+            int NODE_LIMIT;
             
-            MoveInfo *const buf;
-            //TwoValueBook<L2::BOOK_SIZE>& book;
+            MoveInfo *buf;
+            L2::ThreadBook *threadBook; // nullptr なら共通の置換表のみ使う
             
             int nodes;
             int childs;
@@ -304,14 +315,45 @@ namespace UECda{
             L2Judge(int nl,MoveInfo *const argMI)
             :
             NODE_LIMIT(nl),
-            buf(argMI)
-            //book(L2::book)
+            buf(argMI),
+            threadBook(nullptr)
             {
                 init();
             }
             
+            L2Judge():
+            NODE_LIMIT(0), buf(nullptr), threadBook(nullptr){
+                init();
+            }
+            
             ~L2Judge(){}
             
+            int getNodes()const noexcept{ return nodes; }
+            
+            // スレッドごとに使い回す場合の設定
+            void set(int nl, MoveInfo *const argMI, L2::ThreadBook *const argBook = nullptr){
+                NODE_LIMIT = nl;
+                buf = argMI;
+                threadBook = argBook;
+            }
+            
+            // 置換表の読み書き
+            int readBook(const uint64_t hash){
+                if(threadBook == nullptr){ return L2::book.read(hash); }
+                int res = threadBook->read(hash);
+                if(res == -1){
+                    res = L2::book.read(hash);
+                    if(res != -1){ threadBook->regist(res, hash); }
+                }
+                return res;
+            }
+            void registBook(const int result, const uint64_t hash, const uint64_t searchNodes){
+                // 他のスレッドも使えるように共通の置換表にも書く
+                // 共通の置換表では探索ノード数の多かった結果を残しやすくする
+                if(threadBook != nullptr){ threadBook->regist(result, hash); }
+                L2::book.regist(result, hash, searchNodes);
+            }
+            
             // IS_NF 空場
             // DOM_PROC 支配進行
             
@@ -418,6 +460,16 @@ namespace UECda{
                     ana.restart(mode, 5);
                     if(E_LEVEL <= 3)break; // fallthrough
                 case 4:
+#ifdef USE_L2TABLEBASE
+                    // 勝敗表を検索
+                    if((IS_NF == _YES) || (IS_NF != _NO && field.isNF())){
+                        res = L2::tablebase.read(myHand.cards, opsHand.cards, field.bd);
+                        if(res != -1){
+                            DERR << Space(2 * depth) << "-TABLEBASE" << endl;
+                            return res;
+                        }
+                    }
+#endif
                     // 局面登録を検索
 #ifdef USE_L2BOOK
                     // NFのみ
@@ -430,8 +482,7 @@ namespace UECda{
                         ASSERT(opsHand.exam_hash(), cerr << opsHand.toDebugString(););
                         
                         fhash = knitL2NullFieldHashKey(myHand.hash, opsHand.hash, NullBoardToHashKey(field.bd));
-                        res = L2::book.read(fhash);
-                        //res = book.read(fhash);
+                        res = readBook(fhash);
                         if(res != -1){ // 結果が既に登録されていた
 #ifdef DEBUG
                             DERR << Space(2 * depth);
@@ -495,6 +546,8 @@ namespace UECda{
                     
                     if(nodes > NODE_LIMIT){ DERR << "Last2P Node over!" << endl; failed = 1; return L2_DRAW; }
                     
+                    const int startNodes = nodes;
+                    
                     // 合法手の抽出
                     ana.restart(mode, 1);
                     
@@ -516,8 +569,7 @@ namespace UECda{
 #ifdef USE_L2BOOK
                         if(IS_NF){
                             ASSERT(fhash == knitL2NullFieldHashKey(myHand.hash, opsHand.hash, NullBoardToHashKey(field.bd)), cerr << fhash << endl;);
-                            L2::book.regist(L2_WIN, fhash);
-                            //book.regist(L2_WIN, fhash);
+                            registBook(L2_WIN, fhash, nodes - startNodes);
                         }
                         ana.restart(mode,3);
 #endif
@@ -527,8 +579,7 @@ namespace UECda{
 #ifdef USE_L2BOOK
                         if(IS_NF){
                             ASSERT(fhash == knitL2NullFieldHashKey(myHand.hash, opsHand.hash, NullBoardToHashKey(field.bd)), cerr << fhash << endl;);
-                            L2::book.regist(L2_LOSE, fhash);
-                            //book.regist(L2_LOSE,fhash);
+                            registBook(L2_LOSE, fhash, nodes - startNodes);
                         }
 #endif
                         ana.restart(mode,3);
@@ -0,0 +1,277 @@
+/*
+ l2TableBase.hpp
+ Katsuki Ohto
+ */
+
+// ラスト2人の空場局面の勝敗表(テーブルベース)
+// 手番側と相手の手札の枚数の合計が小さい局面を全て解いてファイルに置き、
+// 読み出し側はファイルをメモリマップして引く
+// 作成は test/l2_tablebase_generator.cc
+
+// 形式
+// 64バイトのヘッダの後に、局面ごとに2ビットの値(0...未解決 1 + 結果...解決済み)が並ぶ
+// 局面の番号は (オーダー, 手番側枚数 a, 相手枚数 b) ごとの区画の先頭からの
+// 手番側の手札の組み合わせ番号 * C(53 - a, b) + 相手の手札の(手番側の札を除いた中での)組み合わせ番号
+// 組み合わせ番号は昇順に並べた札番号 c_i から sum C(c_i, i + 1) で計算する
+
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../structure/primitive/prim.hpp"
+#include "../../structure/hand.hpp"
+
+namespace UECda{
+    namespace Fuji{
+        
+        class L2TableBase{
+        public:
+            static constexpr int VERSION = 1;
+            static constexpr int MAX_TOTAL_LIMIT = 10; // 扱える合計枚数の上限
+            
+            struct Header{
+                char magic[8];
+                uint32_t version;
+                uint32_t maxTotal;
+                uint64_t positions;
+                uint64_t bytes; // ヘッダを含むファイルの大きさ
+                uint8_t reserved[32];
+            };
+            static_assert(sizeof(Header) == 64, "header must be 64 bytes");
+            
+            L2TableBase():
+            header_(nullptr), data_(nullptr), mapped_(nullptr), mappedBytes_(0){}
+            
+            ~L2TableBase(){
+                close();
+            }
+            
+            bool loaded()const noexcept{ return data_ != nullptr; }
+            int maxTotal()const noexcept{ return loaded() ? header_->maxTotal : 0; }
+            
+            // ファイルをメモリマップして読み込む
+            bool load(const std::string& path){
+                close();
+                const int fd = open(path.c_str(), O_RDONLY);
+                if(fd < 0){ return false; }
+                struct stat st;
+                if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)){
+                    ::close(fd);
+                    return false;
+                }
+                void *const p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if(p == MAP_FAILED){ return false; }
+                mapped_ = p;
+                mappedBytes_ = st.st_size;
+                if(!attach(static_cast<const uint8_t*>(p), st.st_size)){
+                    close();
+                    return false;
+                }
+                return true;
+            }
+            
+            // メモリ上のファイルイメージを使う(作成中の表を引く場合など)
+            bool attach(const uint8_t *const image, const uint64_t bytes){
+                const Header *const header = reinterpret_cast<const Header*>(image);
+                if(bytes < sizeof(Header)
+                   || memcmp(header->magic, magic(), sizeof(header->magic))
+                   || header->version != VERSION
+                   || header->maxTotal < 2 || header->maxTotal > MAX_TOTAL_LIMIT
+                   || header->bytes != fileBytes(header->maxTotal)
+                   || bytes < header->bytes){
+                    return false;
+                }
+                header_ = header;
+                data_ = image + sizeof(Header);
+                setOffsets(header->maxTotal, offset_);
+                return true;
+            }
+            
+            void close(){
+                if(mapped_ != nullptr){
+                    munmap(mapped_, mappedBytes_);
+                    mapped_ = nullptr;
+                    mappedBytes_ = 0;
+                }
+                header_ = nullptr;
+                data_ = nullptr;
+            }
+            
+            // 空場で myCards 側から始める局面の結果
+            // 表の範囲外か未解決なら -1
+            int read(const Cards myCards, const Cards opsCards, const Board bd)const noexcept{
+                if(data_ == nullptr){ return -1; }
+                const int a = countCards(myCards), b = countCards(opsCards);
+                if(a == 0 || b == 0 || a + b > (int)header_->maxTotal){ return -1; }
+                const uint32_t order = bd.prmOrder();
+                if((uint64_t)bd != (uint64_t)OrderToNullBoard(order)){ return -1; }
+                const uint64_t index = offset_[order][a][b] + positionIndex(myCards, opsCards, a, b);
+                const int value = (data_[index >> 2] >> ((index & 3) * 2)) & 3;
+                return value - 1;
+            }
+            
+            // 以下は作成用
+            
+            static uint64_t sectionPositions(const int a, const int b){
+                return binomial(N_CARDS, a) * binomial(N_CARDS - a, b);
+            }
+            static uint64_t positions(const int maxTotal){
+                uint64_t offset[2][MAX_TOTAL_LIMIT + 1][MAX_TOTAL_LIMIT + 1];
+                return setOffsets(maxTotal, offset);
+            }
+            static uint64_t fileBytes(const int maxTotal){
+                return sizeof(Header) + (positions(maxTotal) + 3) / 4;
+            }
+            
+            // ファイルイメージのヘッダを書き、値を全て未解決にする
+            static void initImage(uint8_t *const image, const int maxTotal){
+                Header *const header = reinterpret_cast<Header*>(image);
+                memset(image, 0, fileBytes(maxTotal));
+                memcpy(header->magic, magic(), sizeof(header->magic));
+                header->version = VERSION;
+                header->maxTotal = maxTotal;
+                header->positions = positions(maxTotal);
+                header->bytes = fileBytes(maxTotal);
+            }
+            static void writeImage(uint8_t *const image, const int maxTotal,
+                                   const Cards myCards, const Cards opsCards, const Board bd, const int result){
+                uint64_t offset[2][MAX_TOTAL_LIMIT + 1][MAX_TOTAL_LIMIT + 1];
+                setOffsets(maxTotal, offset);
+                const int a = countCards(myCards), b = countCards(opsCards);
+                const uint64_t index = offset[bd.prmOrder()][a][b] + positionIndex(myCards, opsCards, a, b);
+                uint8_t& byte = image[sizeof(Header) + (index >> 2)];
+                byte = (byte & ~(3 << ((index & 3) * 2))) | ((result + 1) << ((index & 3) * 2));
+            }
+            
+            // 合計枚数の少ない局面から順に全局面を judge_t::start_judge で解いて書き込む
+            // 書き込み中の表を attach しておけば、途中の局面の探索で小さい局面を引ける
+            // 解けなかった(L2_DRAW)局面は未解決のまま残し、その数を返す
+            template<class judge_t>
+            static uint64_t generate(uint8_t *const image, const int maxTotal, judge_t& judge){
+                uint64_t unsolved = 0;
+                FieldAddInfo fInfo;
+                fInfo.init();
+                for(int total = 2; total <= maxTotal; ++total){
+                    for(int a = 1; a < total; ++a){
+                        const int b = total - a;
+                        for(int order = 0; order < 2; ++order){
+                            const Board bd = OrderToNullBoard(order);
+                            iterateSubsets(N_CARDS, a, [&](const uint64_t myBits){
+                                iterateSubsets(N_CARDS - a, b, [&](const uint64_t packed){
+                                    // 詰めた番号を手番側の札を除いた番号に戻す
+                                    uint64_t opsBits = 0, rest = packed;
+                                    const uint64_t freeBits = ((1ULL << N_CARDS) - 1) & ~myBits;
+                                    uint64_t f = freeBits;
+                                    for(int i = 0; rest; ++i){
+                                        const uint64_t lowest = f & -f;
+                                        if(rest & (1ULL << i)){
+                                            opsBits |= lowest;
+                                            rest &= ~(1ULL << i);
+                                        }
+                                        f &= f - 1;
+                                    }
+                                    Hand myHand, opsHand;
+                                    myHand.setAll(indexBitsToCards(myBits));
+                                    opsHand.setAll(indexBitsToCards(opsBits));
+                                    const int result = judge.start_judge(myHand, opsHand, bd, fInfo);
+                                    if(result == 0 || result == 2){ // L2_WIN, L2_LOSE
+                                        writeImage(image, maxTotal, myHand.cards, opsHand.cards, bd, result);
+                                    }else{
+                                        ++unsolved;
+                                    }
+                                });
+                            });
+                        }
+                    }
+                }
+                return unsolved;
+            }
+            
+            // 札を 0 ~ 52 の番号のビット集合に変換
+            static uint64_t cardsToIndexBits(const Cards c)noexcept{
+                return ((c & CARDS_ALL_PLAIN) >> 4) | ((c & CARDS_JOKER) ? (1ULL << 52) : 0ULL);
+            }
+            static Cards indexBitsToCards(const uint64_t bits)noexcept{
+                return ((bits & ((1ULL << 52) - 1)) << 4) | ((bits >> 52) ? CARDS_JOKER : CARDS_NULL);
+            }
+            
+        private:
+            static const char *magic()noexcept{
+                static const char m[8] = {'L', '2', 'T', 'B', 'A', 'S', 'E', 0};
+                return m;
+            }
+            
+            const Header *header_;
+            const uint8_t *data_;
+            void *mapped_;
+            uint64_t mappedBytes_;
+            uint64_t offset_[2][MAX_TOTAL_LIMIT + 1][MAX_TOTAL_LIMIT + 1];
+            
+            static uint64_t binomial(const int n, const int k)noexcept{
+                static const BinomialTable table;
+                return (k < 0 || n < k) ? 0 : table.c[n][k];
+            }
+            struct BinomialTable{
+                uint64_t c[N_CARDS + 1][MAX_TOTAL_LIMIT + 1];
+                BinomialTable(){
+                    for(int n = 0; n <= N_CARDS; ++n){
+                        for(int k = 0; k <= MAX_TOTAL_LIMIT; ++k){
+                            c[n][k] = (k == 0) ? 1 : ((n == 0) ? 0 : c[n - 1][k - 1] + c[n - 1][k]);
+                        }
+                    }
+                }
+            };
+            
+            // 区画の先頭位置を計算して全局面数を返す
+            static uint64_t setOffsets(const int maxTotal, uint64_t offset[2][MAX_TOTAL_LIMIT + 1][MAX_TOTAL_LIMIT + 1]){
+                uint64_t sum = 0;
+                for(int order = 0; order < 2; ++order){
+                    for(int a = 1; a < maxTotal; ++a){
+                        for(int b = 1; a + b <= maxTotal; ++b){
+                            offset[order][a][b] = sum;
+                            sum += sectionPositions(a, b);
+                        }
+                    }
+                }
+                return sum;
+            }
+            
+            // n ビット中 k ビットが立った集合を昇順に全て呼ぶ
+            template<class callback_t>
+            static void iterateSubsets(const int n, const int k, const callback_t& callback){
+                uint64_t bits = (1ULL << k) - 1;
+                while(bits < (1ULL << n)){
+                    callback(bits);
+                    const uint64_t lowest = bits & -bits;
+                    const uint64_t ripple = bits + lowest;
+                    bits = ripple | (((bits ^ ripple) >> 2) / lowest);
+                }
+            }
+            
+            static uint64_t rank(uint64_t bits)noexcept{
+                uint64_t r = 0;
+                for(int i = 1; bits; ++i){
+                    r += binomial(bsf64(bits), i);
+                    bits &= bits - 1;
+                }
+                return r;
+            }
+            static uint64_t positionIndex(const Cards myCards, const Cards opsCards, const int a, const int b)noexcept{
+                const uint64_t myBits = cardsToIndexBits(myCards);
+                uint64_t opsBits = cardsToIndexBits(opsCards);
+                // 相手の札は手番側の札を除いた中での番号に詰める
+                uint64_t packed = 0;
+                while(opsBits){
+                    const int c = bsf64(opsBits);
+                    packed |= 1ULL << (c - countBits64(myBits & ((1ULL << c) - 1)));
+                    opsBits &= opsBits - 1;
+                }
+                return rank(myBits) * binomial(N_CARDS - a, b) + rank(packed);
+            }
+        };
+    }
+}
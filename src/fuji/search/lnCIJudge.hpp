@@ -13,9 +13,13 @@ namespace UECda{
         namespace LnCI{
             
 #ifdef USE_LNCIBOOK
-            constexpr int BOOK_SIZE = (1 << 18) - 3;
-            const std::string book_name = "LnCIBook";
-            BitBook<11 * N_PLAYERS, BOOK_SIZE> book(book_name);
+            // 空場局面の探索結果を全スレッドで共有する
+            // 結果は手番の席から順に並べた各席の (報酬 + 1) (10ビットずつ)
+            // 0 の席は報酬が求まっていない
+            constexpr int BOOK_REWARD_BITS = 10;
+            constexpr uint64_t BOOK_REWARD_MASK = (1ULL << BOOK_REWARD_BITS) - 1ULL;
+            constexpr int BOOK_BITS = BOOK_REWARD_BITS * N_PLAYERS;
+            BitBucketBook<BOOK_BITS> book("LnCIBook", (uint64_t)LNCI_BOOK_MB << 20);
 #endif
         }
         
@@ -46,15 +50,22 @@ namespace UECda{
         private:
             static AtomicAnalyzer<1, 8, Analysis::TYPE_SEARCH> ana;
             
-            const static int nodes_limit = 12000;
-            const static int depth_limit = 30;
+            // 時間の予算を確かめる間隔(節点数, 2のべき乗)
+            constexpr static int TIME_CHECK_INTERVAL = 16;
+            
+            int nodes_limit; // 探索に使える節点数
+            long time_limit; // 探索に使える時間(マイクロ秒、0なら無制限)
+            ClockMicS clock;
             
         public:
             
+            constexpr static int DEFAULT_NODES_LIMIT = 12000;
+            
             int nodes;
             int childs;
             
             MoveInfo *const mv_buf;
+            const uint16_t *const gameReward; // 階級ごとの報酬
             
             // 席順。
             // 局面ハッシュ値計算を簡単にするため、上がったプレーヤーの分を詰めていく
@@ -104,8 +115,75 @@ namespace UECda{
                 }
             }
             
-            LnCIJudge(MoveInfo *const arg_buf)
-            :mv_buf(arg_buf)
+#ifdef USE_LNCIBOOK
+            // 置換表のキーと値
+            // キーは手番の席から順に手札ハッシュ値を並べるので、
+            // プレーヤー番号が違っても席順と手札が同じなら同じ局面として扱う
+            // 値は上がったプレーヤーを詰めた席順で持ち、読み出す時に今のプレーヤー番号に戻す
+            template<int N, class field_t>
+            uint64_t bookHash(const field_t& field, const int s, const Board bd){
+                switch(N){
+                    case 3:
+                        return knitHash_L3CI_NF(field.hand[getSeatPlayer<N>(s)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 1) % N)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 2) % N)].hash,
+                                                bd);
+                    case 4:
+                        return knitHash_L4CI_NF(field.hand[getSeatPlayer<N>(s)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 1) % N)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 2) % N)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 3) % N)].hash,
+                                                bd);
+                    case 5:
+                        return knitHash_L5CI_NF(field.hand[getSeatPlayer<N>(s)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 1) % N)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 2) % N)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 3) % N)].hash,
+                                                field.hand[getSeatPlayer<N>((s + 4) % N)].hash,
+                                                bd);
+                    default: UNREACHABLE; break;
+                }
+                return 0ULL;
+            }
+            
+            template<int N>
+            uint64_t packBookReward(const BitArray64<11, N_PLAYERS>& reward, const int s, const BitSet32 conPlayers){
+                // 結果を知りたいプレーヤーの報酬だけを入れる
+                uint64_t bits = 0ULL;
+                for(int i = 0; i < N; ++i){
+                    const int p = getSeatPlayer<N>((s + i) % N);
+                    if(conPlayers.test(p)){
+                        ASSERT(reward[p] < LnCI::BOOK_REWARD_MASK, cerr << reward << endl);
+                        bits |= ((uint64_t)reward[p] + 1ULL) << (i * LnCI::BOOK_REWARD_BITS);
+                    }
+                }
+                return bits;
+            }
+            
+            template<int N>
+            bool unpackBookReward(BitArray64<11, N_PLAYERS> *const reward, const uint64_t bits, const int s, const BitSet32 conPlayers){
+                // 結果を知りたいプレーヤーの報酬が全て入っている場合のみ使う
+                for(int i = 0; i < N; ++i){
+                    const int p = getSeatPlayer<N>((s + i) % N);
+                    if(conPlayers.test(p) && !((bits >> (i * LnCI::BOOK_REWARD_BITS)) & LnCI::BOOK_REWARD_MASK)){
+                        return false;
+                    }
+                }
+                for(int i = 0; i < N; ++i){
+                    const uint64_t code = (bits >> (i * LnCI::BOOK_REWARD_BITS)) & LnCI::BOOK_REWARD_MASK;
+                    if(code){
+                        const int p = getSeatPlayer<N>((s + i) % N);
+                        reward->set(p, code - 1ULL);
+                    }
+                }
+                return true;
+            }
+#endif
+            
+            LnCIJudge(MoveInfo *const arg_buf, const uint16_t *const arg_reward,
+                      const int arg_nodes_limit = DEFAULT_NODES_LIMIT, const long arg_time_limit = 0)
+            :nodes_limit(arg_nodes_limit), time_limit(arg_time_limit),
+            mv_buf(arg_buf), gameReward(arg_reward)
             {}
             
             ~LnCIJudge(){}
@@ -119,8 +197,11 @@ namespace UECda{
                 assert(!(*reward)); // 検討が終わるまでrewardには書き込まれない設定
                 assert(lnf.exam());
                 
+                if(++nodes > nodes_limit){ return -1; } // 打ち切り
+                if(time_limit && !(nodes & (TIME_CHECK_INTERVAL - 1)) && clock.stop() > time_limit){ return -1; }
+                
                 constexpr int bestClass = N_PLAYERS - N;
-                const int bestRew = game_reward[bestClass];
+                const int bestRew = gameReward[bestClass];
                 
                 const int ts = lnf.turnSeat;
                 const int tp = getSeatPlayer<N>(ts);
@@ -177,7 +258,7 @@ namespace UECda{
                         }while(tmp);
                         
                         DERR << Space(depth) << "p:" << tp << " CIPW" << endl;
-                        reward->set(tp, game_reward[bestClass]);
+                        reward->set(tp, gameReward[bestClass]);
                         return 1;
                         
                     JUDGE_SEQ:
@@ -185,9 +266,9 @@ namespace UECda{
                             int NMoves = genAllSeq(buf, field.hand[tp].cards);
                             for(int m = 0; m < NMoves; ++m){
                                 const MoveInfo& mv = buf[m];
-                                if(mv.q() >= field.hand[tp].qty){
+                                if(mv.qty() >= field.hand[tp].qty){
                                     DERR << Space(depth) << "p:" << tp << " CIPW" << endl;
-                                    reward->set(tp, game_reward[bestClass]);
+                                    reward->set(tp, gameReward[bestClass]);
                                     return 1;//1手なので支配判定いらず
                                 }else{
                                     Board nbd = bd;
@@ -197,11 +278,11 @@ namespace UECda{
                                     nbd.procOrder(mv.mv());
                                     
                                     // 階段の支配性判定
-                                    if(mv.q() < 4){ // 高速化のため、4枚以上なら支配とする
+                                    if(mv.qty() < 4){ // 高速化のため、4枚以上なら支配とする
                                         tmp = pla_flag;
                                         do{
                                             int p = bsf32(tmp);
-                                            if(mv.q() > field.hand[p].qty){
+                                            if(mv.qty() > field.hand[p].qty){
                                                 tmp &= (tmp - 1);
                                                 continue;
                                             }
@@ -223,7 +304,7 @@ namespace UECda{
                                         tmp &= (tmp - 1);
                                     }while(tmp);
                                     DERR << Space(depth) << "p:" << tp << " CIPW" << endl;
-                                    reward->set(tp, game_reward[bestClass]);
+                                    reward->set(tp, gameReward[bestClass]);
                                     return 1;
                                     
                                     // PPW判定
@@ -232,9 +313,9 @@ namespace UECda{
                                     tmp = pla_flag;
                                     do{
                                         int p = bsf32(tmp);
-                                        if(judgeHandPPW_NF(nextHand.cards, nextHand.pqr, nextHand.jk, field.hand[p].nd, bd)){
+                                        if(judgeHandPPW_NF(nextHand.cards, nextHand.pqr, nextHand.jk, field.hand[p].getND(), bd)){
                                             DERR << Space(depth) << "p:" << tp << " CIPW" << endl;
-                                            reward->set(tp, game_reward[bestClass]);
+                                            reward->set(tp, gameReward[bestClass]);
                                             return 1;
                                         }
                                         tmp &= (tmp - 1);
@@ -244,6 +325,7 @@ namespace UECda{
                         }
                     NOT_MATE:;
                     }
+                    // fall through
                     case 2:
                     {
                         // 探索
@@ -252,7 +334,7 @@ namespace UECda{
                         //int brcount;
                         BitArray64<11, N_PLAYERS> retReward;
                         
-                        int NMoves = gMIG.genMove<IS_NF>(buf, field.hand[tp].getCards(), bd);
+                        int NMoves = genMove<IS_NF>(buf, field.hand[tp], bd);
                         
                         assert(NMoves >= 1);
                         
@@ -270,7 +352,7 @@ namespace UECda{
                             
                             if(!mv.isPASS()){
                                 // パスでない手
-                                if(mv.q() >= field.hand[tp].getQty()){ // あがり
+                                if(mv.qty() >= field.hand[tp].getQty()){ // あがり
                                     
                                     DERR << Space(depth) << "p:" << tp << " won." << endl;
                                     
@@ -278,7 +360,7 @@ namespace UECda{
                                     newConPlayers.reset(tp);
                                     
                                     if(!newConPlayers.any()){ // 結果を返す必要の有るプレーヤーが全員上がったため、上の階層に戻る
-                                        reward->set(tp, (uint64_t)game_reward[bestClass]);
+                                        reward->set(tp, (uint64_t)gameReward[bestClass]);
                                         return 1;
                                     }else{
                                         
@@ -304,7 +386,7 @@ namespace UECda{
                                                     
                                                     int p = getSeatPlayer<N - 1>(s);
                                                     if(nf.isAwake(p)){
-                                                        if(nf.bd.getQty() > field.hand[p].qty || dominatesHand(nf.bd, field.hand[p])){
+                                                        if(nf.bd.qty() > field.hand[p].qty || dominatesHand(nf.bd, field.hand[p])){
                                                             // 支配しているのでasleepにする
                                                             assert(lnf.ps.isAwake(p)); // 元々awake
                                                             
@@ -383,13 +465,13 @@ namespace UECda{
                                             
                                             int res = lj.start_judge(field.hand[newtp], field.hand[opsp], nf.bd, fieldInfo); // L2探索
                                             if(res == L2_WIN){
-                                                reward->set(newtp, (uint64_t)game_reward[N_PLAYERS - 2]);
+                                                reward->set(newtp, (uint64_t)gameReward[N_PLAYERS - 2]);
                                             }else if(res == L2_LOSE){
-                                                reward->set(opsp, (uint64_t)game_reward[N_PLAYERS - 2]);
+                                                reward->set(opsp, (uint64_t)gameReward[N_PLAYERS - 2]);
                                             }else{
                                                 // L2判定失敗
                                                 // 報酬山分け
-                                                uint64_t r = (uint64_t)(game_reward[N_PLAYERS - 2] / 2);
+                                                uint64_t r = (uint64_t)(gameReward[N_PLAYERS - 2] / 2);
                                                 reward->set(newtp, r);
                                                 reward->set(opsp, r);
                                             }
@@ -397,7 +479,7 @@ namespace UECda{
                                             
                                             // 場合によっては上がり着手が複数ある可能性もあるが、
                                             // 即あがりの手は他プレーヤーに影響を与えにくいのでこの着手で確定としよう
-                                            reward->set(tp, (uint64_t)game_reward[bestClass]);
+                                            reward->set(tp, (uint64_t)gameReward[bestClass]);
                                             
                                             DERR << "to L2 " << *reward << endl;
                                             
@@ -416,39 +498,17 @@ namespace UECda{
 #ifdef USE_LNCIBOOK
                                                 // ここで置換表を見る
                                                 // 次のターンはN-1人になっているはず
-                                                uint64_t next_hash;
-                                                switch(N - 1){
-                                                        assert(N - 1 != 2); // L2なのにL2メソッドに入っていない
-                                                    case 3:{
-                                                        next_hash = knitHash_L3CI_NF(field.hand[getSeatPlayer<N - 1>(s)].hash,
-                                                                                     field.hand[getSeatPlayer<N - 1>((s + 1) % (N - 1))].hash,
-                                                                                     field.hand[getSeatPlayer<N - 1>((s + 2) % (N - 1))].hash,
-                                                                                     nf.bd);
-                                                    }break;
-                                                    case 4:{
-                                                        next_hash = knitHash_L4CI_NF(field.hand[getSeatPlayer<N - 1>(s)].hash,
-                                                                                     field.hand[getSeatPlayer<N - 1>((s + 1) % (N - 1))].hash,
-                                                                                     field.hand[getSeatPlayer<N - 1>((s + 2) % (N - 1))].hash,
-                                                                                     field.hand[getSeatPlayer<N - 1>((s + 3) % (N - 1))].hash,
-                                                                                     nf.bd);
-                                                    }break;
-                                                    default: UNREACHABLE; break;
-                                                }
-                                                
-                                                // 置換表を見る。read関数では、インデックスとハッシュ値の上位9(64-11*5)ビットを認証
-                                                uint64_t bookrew = LnCI::book.read(next_hash);
-                                                if(bookrew && holdsBits((uint64_t)REWARD_MASK, bookrew)){
-                                                    // 報酬列にビット包括関係があれば、同じ局面だろうと判定
-                                                    // 現在、プレーヤーの並びも同一である必要あり。
-                                                    // 異なるプレーヤーが同じ手札になった時の局面を同一視するためには、修正が必要
-                                                    *reward = bookrew;
-                                                    reward->set(tp, (uint64_t)game_reward[bestClass]);
+                                                constexpr int NN = cmax<int>(N - 1, 3);
+                                                const uint64_t nextHash = bookHash<NN>(field, s, nf.bd);
+                                                const uint64_t bookRew = LnCI::book.read(nextHash);
+                                                if(bookRew && unpackBookReward<NN>(reward, bookRew, s, newConPlayers)){
+                                                    reward->set(tp, (uint64_t)gameReward[bestClass]);
                                                     
                                                     DERR << Space(depth) << "BOOK " << (*reward) << endl;
                                                     
                                                     return 1;
                                                 }
-                                                
+                                                const int startNodes = nodes;
 #endif
                                                 
                                                 REWARD_MASK ^= (1023ULL << (tp * 11)); // 上がったプレーヤー分を外す
@@ -456,10 +516,10 @@ namespace UECda{
                                                 ret = turn<cmax<int>(N - 1, 3), _YES>(reward, depth + 1, buf + NMoves, nf, field, newConPlayers);
                                                 
 #ifdef USE_LNCIBOOK
-                                                if(newConPlayers.count() >= N - 1 - 1){
+                                                if(ret != -1){
                                                     // 置換表に結果を登録
                                                     DERR << Space(depth) << "REGIST " << *reward << endl;
-                                                    LnCI::book.regist((uint64_t)*reward, next_hash);
+                                                    LnCI::book.regist(packBookReward<NN>(*reward, s, newConPlayers), nextHash, nodes - startNodes);
                                                 }
 #endif
                                             }else{ // 流れていない
@@ -473,7 +533,7 @@ namespace UECda{
                                             
                                             // 場合によっては上がり着手が複数ある可能性もあるが、
                                             // 即あがりの手は他プレーヤーに影響を与えにくいのでこの着手で確定としよう
-                                            reward->set(tp, (uint64_t)game_reward[bestClass]);
+                                            reward->set(tp, (uint64_t)gameReward[bestClass]);
                                             return ret;
                                         }
                                     }
@@ -495,7 +555,7 @@ namespace UECda{
                                             int p = getSeatPlayer<N>(s);
                                             
                                             if(nf.isAwake(p)){
-                                                if(nf.bd.getQty() > field.hand[p].qty || dominatesHand(nf.bd, field.hand[p])){
+                                                if(nf.bd.qty() > field.hand[p].qty || dominatesHand(nf.bd, field.hand[p])){
                                                     // 支配しているのでasleepにする
                                                     assert(lnf.ps.isAlive(p) && lnf.ps.isAwake(p)); // 元々alive&&awake
                                                     
@@ -527,6 +587,7 @@ namespace UECda{
                             }else{ // パスの時
                                 nf.bd = bd;
                                 nf.ps = lnf.ps;
+                                nf.PMOwnerSeat = lnf.PMOwnerSeat;
                                 
                                 if(lnf.isSoloAwake()){
                                     // 残り1人 場を流す
@@ -553,7 +614,7 @@ namespace UECda{
                                         int p = getSeatPlayer<N>(s);
                                         
                                         if(nf.isAwake(p)){
-                                            if(nf.bd.getQty() > field.hand[p].qty || dominatesHand(nf.bd, field.hand[p])){
+                                            if(nf.bd.qty() > field.hand[p].qty || dominatesHand(nf.bd, field.hand[p])){
                                                 // 支配しているのでasleepにする
                                                 
                                                 assert(lnf.ps.isAlive(p) && lnf.ps.isAwake(p));//元々alive&&awake
@@ -601,12 +662,12 @@ namespace UECda{
                                 // ここで置換表を見る
                                 
                                 // 手札のハッシュ値のみ更新
-                                uint64_t next_hash, hash_dist;
+                                uint64_t hash_dist;
                                 Cards dc;
                                 
                                 if(!mv.isPASS()){
-                                    dc = mv.c<_NO>();
-                                    hash_dist = genHash_Cards(dc);
+                                    dc = mv.cards<_NO>();
+                                    hash_dist = CardsToHashKey(dc);
                                     field.hand[tp].hash ^= hash_dist;
                                 }else{
                                     hash_dist = 0ULL; // warning回避
@@ -614,54 +675,21 @@ namespace UECda{
                                 }
                                 
 #ifdef USE_LNCIBOOK
-                                
-                                switch(N){
-                                        assert(3 <= N && N <= N_PLAYERS); // L2なのにL2メソッドに入っていない等
-                                    case 3:{
-                                        next_hash = knitHash_L3CI_NF(field.hand[getSeatPlayer<N>(s)].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 1) % (N))].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 2) % (N))].hash,
-                                                                     nf.bd);
-                                    }break;
-                                    case 4:{
-                                        next_hash = knitHash_L4CI_NF(field.hand[getSeatPlayer<N>(s)].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 1) % (N))].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 2) % (N))].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 3) % (N))].hash,
-                                                                     nf.bd);
-                                    }break;
-                                    case 5:{
-                                        next_hash = knitHash_L5CI_NF(field.hand[getSeatPlayer<N>(s)].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 1) % (N))].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 2) % (N))].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 3) % (N))].hash,
-                                                                     field.hand[getSeatPlayer<N>((s + 4) % (N))].hash,
-                                                                     nf.bd);
-                                    }break;
-                                    default: UNREACHABLE; break;
-                                }
-#endif
-                                
-                                // 置換表を見る。read関数では、インデックスとハッシュ値の上位9(64-11*5)ビットを認証
-#ifdef USE_LNCIBOOK
-                                uint64_t bookrew = LnCI::book.read( next_hash );
-#else 
-                                constexpr uint64_t bookrew = 0ULL;
-#endif
-                                if(bookrew && holdsBits((uint64_t)REWARD_MASK, bookrew)){ // 結果あり
-                                    // 報酬列にビット包括関係があれば、同じ局面だろうと判定
-                                    // 現在、プレーヤーの並びも同一である必要あり。
-                                    // 異なるプレーヤーが同じ手札になった時の局面を同一視するためには、修正が必要
-                                    newReward = bookrew;
-                                    
-                                    DERR << Space(depth) << "BOOK " << (*reward) << endl;
+                                const uint64_t nextHash = bookHash<N>(field, s, nf.bd);
+                                const uint64_t bookRew = LnCI::book.read(nextHash);
+                                if(bookRew && unpackBookReward<N>(&newReward, bookRew, s, newConPlayers)){ // 結果あり
+                                    DERR << Space(depth) << "BOOK " << newReward << endl;
                                     
                                     // 手札ハッシュ値を元に戻すのを忘れないよう注意
                                     if(!mv.isPASS()){
                                         field.hand[tp].hash ^= hash_dist;
                                     }
-                                }else{
-                                    
+                                }else
+#endif
+                                {
+#ifdef USE_LNCIBOOK
+                                    const int startNodes = nodes;
+#endif
                                     if(!mv.isPASS()){
                                         field.hand[tp].makeMove(mv.mv(), dc); // 手札(ハッシュ値以外)更新
                                     }
@@ -669,21 +697,19 @@ namespace UECda{
                                     if(!mv.isPASS()){
                                         field.hand[tp].unmakeMoveAll(mv.mv(), dc, hash_dist); // 手札を戻す
                                     }
-                                    if(ret == -1){ return -1; }//打ち切り
+                                    if(ret == -1){ return -1; } // 打ち切り
 #ifdef USE_LNCIBOOK
-                                    if(newConPlayers.count() >= N - 1){
-                                        // 置換表に結果を登録
-                                        DERR << Space(depth) << "RESIST " << newReward << endl;
-                                        LnCI::book.regist((uint64_t)newReward, next_hash);
-                                    }
+                                    // 置換表に結果を登録
+                                    DERR << Space(depth) << "REGIST " << newReward << endl;
+                                    LnCI::book.regist(packBookReward<N>(newReward, s, newConPlayers), nextHash, nodes - startNodes);
 #endif
                                 }
                             }else{ // 流れていない
                                 uint64_t hash_dist;
                                 Cards dc;
                                 if(!mv.isPASS()){
-                                    dc = mv.c<_NO>();
-                                    hash_dist = genHash_Cards(dc);
+                                    dc = mv.cards<_NO>();
+                                    hash_dist = CardsToHashKey(dc);
                                     field.hand[tp].makeMoveAll(mv.mv(), dc, hash_dist); // 手札更新
                                 }else{
                                     hash_dist = 0ULL; // warning回避
@@ -694,6 +720,7 @@ namespace UECda{
                                     // 手札を戻す
                                     field.hand[tp].unmakeMoveAll(mv.mv(), dc, hash_dist);
                                 }
+                                if(ret == -1){ return -1; } // 打ち切り
                             }
                             
                             rew = (int)(newReward[tp]);
@@ -746,17 +773,43 @@ namespace UECda{
             }
             
             
+            template<int N, class field_t>
+            int startTurn(BitArray64<11, N_PLAYERS> *const reward, const LnField& lnf, field_t& field, const BitSet32 conPlayers){
+                // 置換表で見つかった場合はすぐに帰る
+                // 見つからなかった場合、置換表に結果登録
+                if(!lnf.bd.isNF()){
+                    return turn<N, _NO>(reward, 0, mv_buf, lnf, field, conPlayers);
+                }
+#ifdef USE_LNCIBOOK
+                const uint64_t hash = bookHash<N>(field, lnf.turnSeat, lnf.bd);
+                const uint64_t bookRew = LnCI::book.read(hash);
+                if(bookRew && unpackBookReward<N>(reward, bookRew, lnf.turnSeat, conPlayers)){
+                    return 0;
+                }
+#endif
+                const int ret = turn<N, _YES>(reward, 0, mv_buf, lnf, field, conPlayers);
+#ifdef USE_LNCIBOOK
+                if(ret != -1){
+                    LnCI::book.regist(packBookReward<N>(*reward, lnf.turnSeat, conPlayers), hash, nodes);
+                }
+#endif
+                return ret;
+            }
+            
             template<class field_t>
             int start(BitArray64<11, N_PLAYERS> *const reward, field_t& field, const BitSet32 conPlayers){
                 // 開始
+                // 予算の全部を使って最後まで読む(読み切れなければ -1 を返す)
+                // 深さ制限をかけると最高報酬での打ち切りが起きにくくなり、読み切りが遅くなるので反復深化はしない
                 
                 ana.start();
+                clock.start();
                 
                 LnField lnf;
                 
                 lnf.bd = field.bd;
                 lnf.ps = field.ps;
-                lnf.PMOwnerSeat = field.getPMOwner();
+                lnf.PMOwnerSeat = field.getPlayerSeat(field.getPMOwner());
                 lnf.turnSeat = field.getPlayerSeat(field.getTurnPlayer());
                 
                 assert(lnf.exam());
@@ -778,170 +831,54 @@ namespace UECda{
                 }
                 REWARD_MASK = mask;
                 
-                int ret;
-                
-                // 置換表で見つかった場合はすぐに帰る
-                // 見つからなかった場合、置換表に結果登録
-                
-                
-                switch(lnf.getNAlivePlayers()){
-                    case 3:{
-                        infoSeatPlayer3 = field.infoSeatPlayer;
-                        
-                        // すでに上がったブレーヤーの席を詰める
+                // すでに上がったブレーヤーの席を詰める
+                BitArray32<4, N_PLAYERS> seatPlayer = field.infoSeatPlayer;
+                for(int s = N_PLAYERS - 1; s >= 0; --s){
+                    const int p = seatPlayer[s];
+                    if(!lnf.isAlive(p)){
+                        seatPlayer.remove(s);
                         
-                        int s;
-                        for(s = N_PLAYERS - 1; s >= 0; --s){
-                            int p = infoSeatPlayer3[s];
-                            if(!lnf.isAlive(p)){
-                                infoSeatPlayer3.remove(s);
-                                
-                                assert(holdsBits((uint64_t)REWARD_MASK, uint64_t(1023ULL << (p * 11))));
-                                
-                                REWARD_MASK ^= (1023ULL << (p * 11));
-                                if(lnf.PMOwnerSeat > s){
-                                    --lnf.PMOwnerSeat;
-                                }
-                                if(lnf.turnSeat > s){
-                                    --lnf.turnSeat;
-                                }
-                            }
-                        }
-                        
-                        if(field.isNF()){
-                            
-                            s = lnf.turnSeat;
-                            /*
-                             uint64_t hash=knitHash_L3CI(field.hand[infoSeatPlayer3[s]].hash,
-                             field.hand[infoSeatPlayer3[(s+1)%3]].hash,
-                             field.hand[infoSeatPlayer3[(s+2)%3]].hash,
-                             lnf.bd);
-                             uint64_t bookrew=LnCI::book.read( hash );
-                             if( bookrew && holdsBits( REWARD_MASK, bookrew ) ){//結果あり。
-                             *reward=bookrew;
-                             ret=0;
-                             }else{
-                             */
-                            ret = turn<3, _YES>(reward, 0, mv_buf, lnf, field, conPlayers);
-                            
-                            //if( ret != -1 ){
-                            //	LnCI::book.regist( (uint64_t)*reward, hash );
-                            //}
-                            //}
-                        }else{
-                            ret = turn<3, _NO>(reward, 0, mv_buf, lnf, field, conPlayers);
-                        }
-                    }break;
-                    case 4:{
-                        infoSeatPlayer4 = field.infoSeatPlayer;
-                        // すでに上がったブレーヤーの席を詰める
-                        /*uint32_t dead=((1<<N_PLAYERS)-1) & (~lnf.infoPlayerState);
-                         
-                         assert( countBits32(dead) == 1 );
-                         
-                         //pが上がったプレーヤーのプレーヤー番号
-                         int p=bsr32(dead);
-                         int s=field.infoSeat[p];
-                         
-                         assert( !field.isAlive(p) );
-                         
-                         assert( holdsBits( REWARD_MASK, 1023ULL<<(p*12)) );
-                         
-                         REWARD_MASK^=(1023ULL<<(p*12));
-                         
-                         infoSeatPlayer4.remove(s);
-                         
-                         if( lnf.turnSeat == 4 ){
-                         lnf.turnSeat=3;
-                         }
-                         if( lnf.PMOwnerSeat == 4 ){
-                         lnf.PMOwnerSeat=0;
-                         }*/
-                        int s;
-                        for(s = N_PLAYERS - 1; s >= 0; --s){
-                            int p = infoSeatPlayer4[s];
-                            if(!lnf.isAlive(p)){
-                                infoSeatPlayer4.remove(s);
-                                
-                                assert(holdsBits((uint64_t)REWARD_MASK, uint64_t(1023ULL << (p * 11))));
-                                
-                                REWARD_MASK ^= (1023ULL << (p * 11));
-                                if(lnf.PMOwnerSeat > s){
-                                    --lnf.PMOwnerSeat;
-                                }
-                                if(lnf.turnSeat > s){
-                                    --lnf.turnSeat;
-                                }
-                                break;
-                            }
-                        }
+                        assert(holdsBits((uint64_t)REWARD_MASK, uint64_t(1023ULL << (p * 11))));
                         
-                        if(field.isNF()){
-                            
-                            //s=lnf.turnSeat;
-                            
-                            /*uint64_t hash=knitHash_L4CI(field.hand[infoSeatPlayer4[s]].hash,
-                             field.hand[infoSeatPlayer4[(s+1)%4]].hash,
-                             field.hand[infoSeatPlayer4[(s+2)%4]].hash,
-                             field.hand[infoSeatPlayer4[(s+3)%4]].hash,
-                             lnf.bd);
-                             uint64_t bookrew=LnCI::book.read( hash );
-                             if( bookrew && holdsBits( REWARD_MASK, bookrew ) ){//結果あり。
-                             *reward=bookrew;
-                             ret=0;
-                             }else{*/
-                            ret=turn<4, _YES>(reward, 0, mv_buf, lnf, field, conPlayers);
-                            
-                            //if( ret != -1 ){
-                            //	LnCI::book.regist( (uint64_t)*reward, hash );
-                            //}
-                            //}
-                        }else{
-                            ret=turn<4, _NO>(reward, 0, mv_buf, lnf, field, conPlayers);
+                        REWARD_MASK ^= (1023ULL << (p * 11));
+                        if(lnf.PMOwnerSeat > s){
+                            --lnf.PMOwnerSeat;
                         }
-                    }break;
-#if N_PLAYERS >= 5
-                    case 5:{
-                        infoSeatPlayer5 = field.infoSeatPlayer;
-                        if(field.isNF()){
-                            
-                            //int s=lnf.turnSeat;
-                            
-                            /*uint64_t hash=knitHash_L5CI(field.hand[infoSeatPlayer5[s]].hash,
-                             field.hand[infoSeatPlayer5[(s+1)%5]].hash,
-                             field.hand[infoSeatPlayer5[(s+2)%5]].hash,
-                             field.hand[infoSeatPlayer5[(s+3)%5]].hash,
-                             field.hand[infoSeatPlayer5[(s+4)%5]].hash,
-                             lnf.bd);
-                             uint64_t bookrew=LnCI::book.read( hash );
-                             if( bookrew && holdsBits( REWARD_MASK, bookrew ) ){//結果あり。
-                             *reward=bookrew;
-                             ret=0;
-                             }else{*/
-                            ret=turn<5, _YES>(reward, 0, mv_buf, lnf, field, conPlayers);
-                            
-                            //if( ret != -1 ){
-                            //	LnCI::book.regist( (uint64_t)*reward, hash );
-                            //}
-                            //}
-                        }else{
-                            ret=turn<5, _NO>(reward, 0, mv_buf, lnf, field, conPlayers);
+                        if(lnf.turnSeat > s){
+                            --lnf.turnSeat;
                         }
-                    }break;
-#endif // N_PLAYERS >= 5
-                    default: UNREACHABLE; break;
+                    }
+                }
+                
+                if(lnf.PMOwnerSeat >= (int)lnf.getNAlivePlayers()){
+                    lnf.PMOwnerSeat = 0; // 席が無くなったので、次のプレーヤーが出した事にしておく
+                }
+                
+                int ret;
+                switch(lnf.getNAlivePlayers()){
+                    case 3:
+                        infoSeatPlayer3 = seatPlayer;
+                        ret = startTurn<3>(reward, lnf, field, conPlayers);
+                        break;
+                    case 4:
+                        infoSeatPlayer4 = seatPlayer;
+                        ret = startTurn<4>(reward, lnf, field, conPlayers);
+                        break;
+                    case 5:
+                        infoSeatPlayer5 = seatPlayer;
+                        ret = startTurn<5>(reward, lnf, field, conPlayers);
+                        break;
+                    default: UNREACHABLE; ret = -1; break;
                 }
                 
                 if(ret == -1){
                     // 失敗
                     ana.addFailure();
                 }else{
-                    assert((uint64_t)(*reward) != 0ULL); // 成功のとき報酬が付いてなかったらおかしい
+                    // 置換表から知りたいプレーヤーの分だけを得た場合は、最下位の報酬0のみのこともある
                     assert(holdsBits((uint64_t)REWARD_MASK, (uint64_t)(*reward))); // 変な所に報酬値がある
                 }
                 
-                //DERR<<"BA64 : "<<sizeof(BitArray64<12,N_PLAYERS>)<<endl;
-                
                 ana.end();
                 
                 return ret;
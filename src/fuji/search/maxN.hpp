@@ -99,7 +99,6 @@ namespace UECda{
                         for(int p = 0; p < N_PLAYERS; ++p){
                             if(anyCards(c[p])){
                                 tfield.setHand(p, c[p]);
-                                tfield.setOpsHand(p, subtrCards(field.getRemCards(), c[p]));
                             }
                         }
                         cerr << tfield.toDebugString();
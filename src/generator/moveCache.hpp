@@ -0,0 +1,87 @@
+/*
+ moveCache.hpp
+ Katsuki Ohto
+ */
+
+// 着手生成結果のキャッシュ
+// 1回の着手決定の中では、自分の手札は全ての世界で共通で、終盤の局面もよく一致するので
+// 同じ (手札, 場) に対する着手生成が何度も行われる
+// 手札のハッシュ値と場から表の位置を決め、カード集合と場を丸ごと比較して一致すれば生成結果を写す
+
+#pragma once
+
+#include "../structure/primitive/prim.hpp"
+#include "../structure/primitive/prim2.hpp"
+#include "../structure/hash/hashGenerator.hpp"
+
+namespace UECda{
+    
+    template<int N_ENTRIES, int N_MOVES>
+    class MoveCache{
+        // スレッドごとに持つ直接写像のキャッシュ
+        // 着手数が N_MOVES を超える生成結果は登録しない
+    public:
+        void clear()noexcept{
+            for(int i = 0; i < N_ENTRIES; ++i){
+                entry_[i].num = -1;
+            }
+        }
+        
+        MoveCache(){
+            clear();
+        }
+        
+        template<class generator_t>
+        int genMove(MoveInfo *const mv, const Cards c, const uint64_t hash, const Board bd,
+                    const generator_t& generator){
+            // generator は (mv, c, bd) を引数にとって生成した着手数を返す関数
+            ana.start();
+            const uint32_t boardKey = BoardToKey(bd);
+            Entry& e = entry_[index(hash, boardKey)];
+            if(e.num >= 0 && e.cards == c && e.board == boardKey){
+                // ヒット
+                memcpy(mv, e.mv, e.num * sizeof(MoveInfo));
+                ana.end(0);
+                return e.num;
+            }
+            const int num = generator(mv, c, bd);
+            if(num <= N_MOVES){
+                e.cards = c;
+                e.board = boardKey;
+                e.num = num;
+                memcpy(e.mv, mv, num * sizeof(MoveInfo));
+                ana.end(1);
+            }else{
+                ana.end(2); // 着手が多すぎて登録しなかった
+            }
+            return num;
+        }
+    
+    private:
+        struct Entry{
+            Cards cards;
+            uint32_t board;
+            int num; // -1 なら空き
+            MoveInfo mv[N_MOVES];
+        };
+        
+        Entry entry_[N_ENTRIES];
+        
+        // 0 : ヒット 1 : 登録 2 : 登録せず
+        static AtomicAnalyzer<3, 1> ana;
+        
+        constexpr static uint64_t MASK = N_ENTRIES - 1;
+        static_assert((N_ENTRIES & MASK) == 0, "N_ENTRIES must be a power of 2.");
+        
+        static uint32_t BoardToKey(const Board bd)noexcept{
+            // 空場での生成は場に依らないのでまとめる
+            return bd.isNF() ? 0 : (uint32_t)BoardToHashKey(bd);
+        }
+        static uint64_t index(const uint64_t hash, const uint32_t boardKey)noexcept{
+            return ((hash ^ (boardKey * 0x9e3779b97f4a7c15ULL)) >> 20) & MASK;
+        }
+    };
+    
+    template<int N_ENTRIES, int N_MOVES>
+    AtomicAnalyzer<3, 1> MoveCache<N_ENTRIES, N_MOVES>::ana("MoveCache");
+}
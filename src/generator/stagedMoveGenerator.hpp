@@ -0,0 +1,136 @@
+/*
+ stagedMoveGenerator.hpp
+ Katsuki Ohto
+ */
+
+// 種類ごとの段階的な着手生成
+// パス、シングル、グループ、階段の順に、必要になった種類だけを生成する
+// 階段以外の着手数は生成前に分かる
+// 全ての段階を順に生成した結果は genMoveByTable と同一
+
+#pragma once
+
+#include "../structure/primitive/prim.hpp"
+#include "../structure/primitive/prim2.hpp"
+#include "tableMoveGenerator.hpp"
+
+namespace UECda{
+    
+    enum MoveStage{
+        MOVE_STAGE_PASS = 0,
+        MOVE_STAGE_SINGLE,
+        MOVE_STAGE_GROUP,
+        MOVE_STAGE_SEQ,
+        N_MOVE_STAGES,
+    };
+    
+    inline bool mayMakeSeq(const Cards c)noexcept{
+        // 3枚以上の階段を作れる可能性があるか(Hand::seq と同じ判定)
+        const Cards nj = maskJOKER(c);
+        const Cards p4 = polymRanks<2>(nj);
+        const Cards p8 = polymJump(nj);
+        if(containsJOKER(c)){
+            return anyCards(p4 | p8 | (p4 >> 4));
+        }else{
+            return anyCards(p4 & p8);
+        }
+    }
+    
+    class StagedMoveGenerator{
+    public:
+        void set(const Cards c, const Board bd){
+            c_ = c; bd_ = bd;
+            for(int st = 0; st < N_MOVE_STAGES; ++st){
+                count_[st] = 0;
+            }
+            if(bd.isNF()){
+                count_[MOVE_STAGE_SINGLE] = countCards(c);
+                count_[MOVE_STAGE_GROUP] = countLeadGroupsByTable(c);
+                count_[MOVE_STAGE_SEQ] = mayMakeSeq(c) ? -1 : 0;
+            }else{
+                count_[MOVE_STAGE_PASS] = 1;
+                if(bd.isSeq()){
+                    count_[MOVE_STAGE_SEQ] = mayMakeSeq(c) ? -1 : 0;
+                }else{
+                    switch(bd.qty()){
+                        case 0: break;
+                        case 1: count_[MOVE_STAGE_SINGLE] = countFollowSingles(c, bd); break;
+                        case 2: case 3: case 4: count_[MOVE_STAGE_GROUP] = countFollowGroupsByTable(c, bd); break;
+                        default: break;
+                    }
+                }
+            }
+        }
+        
+        StagedMoveGenerator(const Cards c, const Board bd){
+            set(c, bd);
+        }
+        
+        int count(int st)const noexcept{
+            // 段階 st の着手数 (階段は生成するまで分からない場合 -1)
+            return count_[st];
+        }
+        bool empty(int st)const noexcept{
+            return count_[st] == 0;
+        }
+        
+        template<class move_t>
+        int generate(move_t *const mv, int st){
+            // 段階 st の着手を生成して数を返す
+            int cnt = 0;
+            switch(st){
+                case MOVE_STAGE_PASS:
+                    if(count_[st]){ mv->setNULL(); cnt = 1; }
+                    break;
+                case MOVE_STAGE_SINGLE:
+                    if(count_[st]){
+                        cnt = bd_.isNF() ? genAllSingle(mv, c_) : genFollowSingle(mv, c_, bd_);
+                    }
+                    break;
+                case MOVE_STAGE_GROUP:
+                    if(count_[st]){
+                        cnt = bd_.isNF() ? genLeadGroupsByTable(mv, c_) : genFollowGroupByTable(mv, c_, bd_);
+                    }
+                    break;
+                case MOVE_STAGE_SEQ:
+                    if(count_[st]){
+                        cnt = bd_.isNF() ? genAllSeq(mv, c_) : genFollowSeq(mv, c_, bd_);
+                        count_[st] = cnt;
+                    }
+                    break;
+                default: UNREACHABLE; break;
+            }
+            assert(count_[st] == cnt);
+            return cnt;
+        }
+        template<class move_t>
+        int generateAll(move_t *const mv0){
+            move_t *mv = mv0;
+            for(int st = 0; st < N_MOVE_STAGES; ++st){
+                mv += generate(mv, st);
+            }
+            return mv - mv0;
+        }
+    
+    private:
+        Cards c_;
+        Board bd_;
+        int count_[N_MOVE_STAGES];
+        
+        static int countFollowSingles(Cards c, const Board bd)noexcept{
+            // genFollowSingle の生成数
+            if(bd.isSingleJOKER()){
+                return containsS3(c) ? 1 : 0;
+            }
+            int cnt = 0;
+            if(containsJOKER(c)){
+                subtrJOKER(&c);
+                cnt = 1;
+            }
+            if(bd.suitsLocked()){
+                c &= SuitsToCards(bd.suits());
+            }
+            return cnt + countCards(c & BoardToValidCards(bd));
+        }
+    };
+}
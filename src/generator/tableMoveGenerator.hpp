@@ -0,0 +1,301 @@
+/*
+ tableMoveGenerator.hpp
+ Katsuki Ohto
+ */
+
+// 表引きによる着手生成
+// グループの着手はランクごとの4ビット(スート)の形だけで決まるので、
+// あらかじめ形ごとの着手列(ランク部分を除いたもの)を作っておき、ランクを足して書き出す
+// 出力(着手の並びも含めて)は moveGenerator.hpp の genMove と同一
+// シングル、階段は moveGenerator.hpp のものをそのまま使う
+
+#pragma once
+
+#include <immintrin.h>
+
+#include "../structure/primitive/prim.hpp"
+#include "../structure/primitive/prim2.hpp"
+#include "moveGenerator.hpp"
+
+namespace UECda{
+    
+    struct GroupMoveList{
+        // 1ランク分のグループの着手列
+        alignas(16) uint64_t move[32]; // ランク以外の部分
+        int num;
+    };
+    
+    inline void setGroupMoveList(GroupMoveList *const dst, const MoveInfo *const mv, int num){
+        // 1ランクだけの手札から通常の着手生成で作った着手列を登録する
+        dst->num = 0;
+        for(int i = 0; i < num; ++i){
+            if(!mv[i].mv().isGroup()){ continue; }
+            assert(dst->num < 32);
+            dst->move[dst->num++] = mv[i].data() & ~(uint64_t)MOVE_FLAG_RANK;
+        }
+    }
+    
+    struct GroupMoveTable{
+        // 空場 (ジョーカー有無, スート)
+        GroupMoveList lead[2][16];
+        // 場のグループ (枚数 - 2, ジョーカー有無, スート)
+        GroupMoveList follow[3][2][16];
+        // スートしばりのある場のグループ (枚数 - 2, ジョーカー有無, しばりスート, スート)
+        GroupMoveList locked[2][2][16][16];
+        
+        GroupMoveTable(){
+            // 着手生成表の初期化
+            MoveInfo buf[N_MAX_MOVES];
+            for(int jk = 0; jk < 2; ++jk){
+                for(uint32_t x = 0; x < 16; ++x){
+                    const Cards c = RankSuitsToCards(RANK_4, x) | (jk ? CARDS_JOKER : CARDS_NULL);
+                    setGroupMoveList(&lead[jk][x], buf, genLead(buf, c));
+                    for(int q = 2; q <= 4; ++q){
+                        // しばり無し
+                        Move bm;
+                        bm.setNULL();
+                        bm.setGroup(q, RANK_3, SUITS_ALL >> (4 - q));
+                        const Board bd = MoveToBoard(bm);
+                        int num = 0;
+                        switch(q){
+                            case 2: num = genFollowDouble(buf, c, bd); break;
+                            case 3: num = genFollowTriple(buf, c, bd); break;
+                            case 4: num = genFollowQuadruple(buf, c, bd); break;
+                            default: UNREACHABLE; break;
+                        }
+                        setGroupMoveList(&follow[q - 2][jk][x], buf, num);
+                    }
+                    for(uint32_t s = 0; s < 16; ++s){
+                        // しばり有り
+                        const int q = countSuits(s);
+                        if(q != 2 && q != 3){ continue; }
+                        Move bm;
+                        bm.setNULL();
+                        bm.setGroup(q, RANK_3, s);
+                        Board bd = MoveToBoard(bm);
+                        bd.setExceptOrder(MOVE_FLAG_SUITSLOCK);
+                        const int num = (q == 2) ? genFollowDouble(buf, c, bd) : genFollowTriple(buf, c, bd);
+                        setGroupMoveList(&locked[q - 2][jk][s][x], buf, num);
+                    }
+                }
+            }
+        }
+    };
+    
+    inline const GroupMoveTable& groupMoveTable(){
+        // 最初に使う時に作る(全翻訳単位で1つ)
+        static const GroupMoveTable table;
+        return table;
+    }
+    
+    template<class move_t>
+    inline move_t *writeGroupMoves(move_t *mv, const GroupMoveList& list, int r4x){
+        // ランク r4x の着手列を書き出す
+        const uint64_t add = ((uint64_t)r4x << MOVE_LCT_RANK4X) | (r4x == RANK4X_8 ? MOVE_FLAG_INEVITDOM : 0);
+        for(int i = 0; i < list.num; ++i){
+            *mv = move_t(list.move[i] | add);
+            ++mv;
+        }
+        return mv;
+    }
+    template<>
+    inline MoveInfo *writeGroupMoves(MoveInfo *mv, const GroupMoveList& list, int r4x){
+        // 64ビットの着手は2つずつまとめて書き出す
+        static_assert(sizeof(MoveInfo) == sizeof(uint64_t), "MoveInfo is not 64 bit.");
+        const uint64_t add = ((uint64_t)r4x << MOVE_LCT_RANK4X) | (r4x == RANK4X_8 ? MOVE_FLAG_INEVITDOM : 0);
+        const __m128i add2 = _mm_set1_epi64x(add);
+        int i = 0;
+        for(; i + 1 < list.num; i += 2){
+            const __m128i m = _mm_load_si128(reinterpret_cast<const __m128i*>(list.move + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(mv + i), _mm_or_si128(m, add2));
+        }
+        if(i < list.num){
+            mv[i] = MoveInfo(list.move[i] | add);
+            ++i;
+        }
+        return mv + i;
+    }
+    
+    template<class move_t, class table_t>
+    inline move_t *writeGroupMovesOfRanks(move_t *mv, Cards ranks, const Cards c, const table_t& table){
+        // ranks に含まれるランクについて、8 を先にして残りを昇順に書き出す
+        if(ranks & CARDS_8){
+            mv = writeGroupMoves(mv, table[(c >> RANK4X_8) & 15U], RANK4X_8);
+            ranks = maskCards(ranks, CARDS_8);
+        }
+        while(ranks){
+            const int r4x = IntCardToRank4x(popIntCardLow(&ranks));
+            mv = writeGroupMoves(mv, table[(c >> r4x) & 15U], r4x);
+        }
+        return mv;
+    }
+    
+    // 引数の型がHandとCardsのどちらでもOKにするためのサブルーチン
+    template<class hand_t>
+    inline Cards QRInGenByTable(const hand_t& hand){
+        assert(hand.exam_qr());
+        return hand.qr;
+    }
+    template<>
+    inline Cards QRInGenByTable(const Cards& c){
+        return CardsToQR(c);
+    }
+    template<class hand_t>
+    inline Cards PQRInGenByTable(const hand_t& hand, Cards valid){
+        assert(hand.exam_pqr());
+        return hand.pqr & valid;
+    }
+    template<>
+    inline Cards PQRInGenByTable(const Cards& c, Cards valid){
+        return CardsToPQR(c & valid);
+    }
+    
+    template<class move_t, class hand_t>
+    int genLeadGroupsByTable(move_t *const mv0, const hand_t& hand){
+        // 空場でのグループのみ生成
+        const Cards c = Cards(hand);
+        const int jk = containsJOKER(c) ? 1 : 0;
+        move_t *mv = mv0;
+        // ジョーカーがあれば1枚から、無ければ2枚以上あるランクからグループを作る
+        Cards x;
+        if(jk){
+            x = maskJOKER(c);
+        }else{
+            x = QRInGenByTable(hand) & PQR_234;
+        }
+        const Cards x8 = x & CARDS_8;
+        x = maskCards(x, CARDS_8);
+        const GroupMoveList *const table = groupMoveTable().lead[jk];
+        while(x){
+            const int r4x = IntCardToRank4x(pickIntCardLow(x));
+            mv = writeGroupMoves(mv, table[(c >> r4x) & 15U], r4x);
+            x = maskCards(x, Rank4xToCards(r4x));
+        }
+        if(x8){ // 8切りは最後に生成
+            mv = writeGroupMoves(mv, table[(c >> RANK4X_8) & 15U], RANK4X_8);
+        }
+        return mv - mv0;
+    }
+    
+    template<class move_t, class hand_t>
+    int genLeadByTable(move_t *const mv0, const hand_t& hand){
+        move_t *mv = mv0 + genAllSingle(mv0, Cards(hand)); // シングルはここで生成
+        mv += genLeadGroupsByTable(mv, hand);
+        mv += genAllSeq(mv, Cards(hand)); // 階段を生成
+        return mv - mv0;
+    }
+    
+    inline Cards BoardToValidCards(const Board bd)noexcept{
+        // 場より強いランクのカード
+        const int br4x = bd.rank4x();
+        if(!bd.isTmpOrderRev()){ // 通常
+            return RankRange4xToCards(br4x + 4, RANK4X_MAX);
+        }else{ // オーダー逆転中
+            return RankRange4xToCards(RANK4X_MIN, br4x - 4);
+        }
+    }
+    
+    template<class move_t, class hand_t>
+    int genFollowGroupByTable(move_t *const mv0, const hand_t& hand, const Board bd){
+        const Cards c = Cards(hand);
+        const int jk = containsJOKER(c) ? 1 : 0;
+        const int q = bd.qty();
+        const Cards valid = BoardToValidCards(bd);
+        move_t *mv = mv0;
+        if(q == 4 || !bd.suitsLocked()){ // スートしばりなし
+            // 枚数の多いランクから順に生成
+            // 各枚数の中では 8 を先にしてランクの昇順
+            const Cards pqr = PQRInGenByTable(hand, valid);
+            const auto& table = groupMoveTable().follow[q - 2][jk];
+            const int minQty = q - jk; // ジョーカーで補える枚数まで
+            for(int n = 4; n >= minQty; --n){
+                mv = writeGroupMovesOfRanks(mv, pqr & QtyToPQR(n), c, table);
+            }
+        }else{ // スートしばりあり
+            const uint32_t s = bd.suits();
+            // しばりスート以外を仮想的に加えて、4枚(ジョーカーがあれば3枚)ある箇所から生成
+            const Cards vc = (c & valid) | SuitsToCards(SUITS_ALL - s);
+            const auto& table = groupMoveTable().locked[q - 2][jk][s];
+            mv = writeGroupMovesOfRanks(mv, CardsToFR(vc), c, table);
+            if(jk){
+                mv = writeGroupMovesOfRanks(mv, CardsTo3R(vc), c, table);
+            }
+        }
+        return mv - mv0;
+    }
+    
+    // 生成せずに着手数だけを数える
+    template<class table_t>
+    inline int countGroupMovesOfRanks(Cards ranks, const Cards c, const table_t& table){
+        int cnt = 0;
+        while(ranks){
+            const int r4x = IntCardToRank4x(popIntCardLow(&ranks));
+            cnt += table[(c >> r4x) & 15U].num;
+        }
+        return cnt;
+    }
+    
+    template<class hand_t>
+    int countLeadGroupsByTable(const hand_t& hand){
+        const Cards c = Cards(hand);
+        const int jk = containsJOKER(c) ? 1 : 0;
+        Cards x;
+        if(jk){
+            const Cards nj = maskJOKER(c);
+            x = (nj | (nj >> 1) | (nj >> 2) | (nj >> 3)) & PQR_1; // ランクごとに1ビット
+        }else{
+            x = QRInGenByTable(hand) & PQR_234;
+        }
+        return countGroupMovesOfRanks(x, c, groupMoveTable().lead[jk]);
+    }
+    
+    template<class hand_t>
+    int countFollowGroupsByTable(const hand_t& hand, const Board bd){
+        const Cards c = Cards(hand);
+        const int jk = containsJOKER(c) ? 1 : 0;
+        const int q = bd.qty();
+        const Cards valid = BoardToValidCards(bd);
+        if(q == 4 || !bd.suitsLocked()){
+            const Cards pqr = PQRInGenByTable(hand, valid);
+            Cards ranks = CARDS_NULL;
+            for(int n = 4; n >= q - jk; --n){
+                ranks |= pqr & QtyToPQR(n);
+            }
+            return countGroupMovesOfRanks(ranks, c, groupMoveTable().follow[q - 2][jk]);
+        }else{
+            const uint32_t s = bd.suits();
+            const Cards vc = (c & valid) | SuitsToCards(SUITS_ALL - s);
+            const Cards ranks = jk ? (CardsToFR(vc) | CardsTo3R(vc)) : CardsToFR(vc);
+            return countGroupMovesOfRanks(ranks, c, groupMoveTable().locked[q - 2][jk][s]);
+        }
+    }
+    
+    template<class move_t, class hand_t>
+    inline int genFollowByTable(move_t *mv, const hand_t& c, const Board bd){
+        // 返り値は、生成した手の数
+        int ret = 1;
+        mv->setNULL();
+        ++mv;
+        if(!bd.isSeq()){
+            switch(bd.qty()){
+                case 0: break;
+                case 1: ret += genFollowSingle(mv, c, bd); break;
+                case 2: case 3: case 4: ret += genFollowGroupByTable(mv, c, bd); break;
+                default: break;
+            }
+        }else{
+            ret += genFollowSeq(mv, c, bd);
+        }
+        return ret;
+    }
+    
+    template<int IS_NF = _BOTH, class move_t, class hand_t>
+    int genMoveByTable(move_t *mv, const hand_t& c, const Board bd){
+        if(IS_NF == _YES || (IS_NF != _NO && bd.isNF())){
+            return genLeadByTable(mv, c);
+        }else{
+            return genFollowByTable(mv, c, bd);
+        }
+        UNREACHABLE;
+    }
+}
@@ -81,6 +81,7 @@
 #include "../CppCommon/src/util/softmaxClassifier.hpp"
 #include "../CppCommon/src/util/selection.hpp"
 #include "../CppCommon/src/util/lock.hpp"
+#include "../CppCommon/src/util/thread.hpp"
 #include "../CppCommon/src/util/io.hpp"
 #include "../CppCommon/src/util/pd.hpp"
 #include "../CppCommon/src/util/statistics.hpp"
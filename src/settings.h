@@ -10,6 +10,7 @@
 #define UECDA_SETTINGS_H_
 
 #include <cfloat>
+#include <cstdint>
 
 // プロフィール
 #define MY_MC_NAME "Blauweregen"
@@ -34,6 +35,13 @@
 
 //#define FIXED_N_PLAYOUTS (8000) // プレイアウト回数を固定(デバッグ、実験用)
 
+// 思考時間(ミリ秒)
+// 1試合あたりの持ち時間と、1回の着手決定の上限時間
+// 持ち時間を0以下にすると時間管理を行わず、プレイアウト回数で打ち切る(既定)
+// 時間管理を使う場合はここに正の値を設定する(大会版以外では -tg, -td でも指定できる)
+constexpr double GAME_TIME_BUDGET = 0;
+constexpr double DECISION_TIME_BUDGET = 200;
+
 // 戦略設定
 
 // 思考レベル(0~＋∞だが、6以上の場合は計算時間解析が上手く行かないかも)
@@ -41,10 +49,40 @@
 #define THINKING_LEVEL (8)
 
 // 並列化
-// スレッド数(ビルド時決定)
+// 標準のスレッド数(起動時に -th オプションか設定ファイルで変更可)
 // 0以下を設定すると勝手に1になります
 #define N_THREADS (8)
 
+// 仮想世界プールの大きさ(全スレッドで共有)
+constexpr int MAX_N_WORLDS = 512;
+
+// 相手の手番中に仮想世界を作っておく(pondering)
+// UECdaでは他人の手番中に重い処理をしないのが暗黙の了解なので、標準ではオフ
+//#define PONDERING
+
+// ルート直下の探索木(自分の次の手番まで展開し、次の着手決定に統計を引き継ぐ)
+//#define SEARCH_TREE
+
+// 探索木の大きさ(全スレッドで共有)
+constexpr int TREE_NODES = 1 << 14;
+constexpr int TREE_EDGES = 1 << 17;
+
+// プレイアウト中の着手生成を表引きで行う(生成される着手は通常の着手生成と同じ)
+#define TABLE_MOVE_GENERATOR
+
+// プレイアウト中の着手生成をパス、シングル、グループ、階段の種類ごとに行い、
+// 必勝手が見つかればそれより後の種類の生成と必勝判定を省く(MOVE_CACHE が優先)
+// 必勝手は最初に見つかった種類の中からしか選ばれず、パスやシングルの必勝手に偏るので標準ではオフ
+//#define STAGED_MOVE_GENERATION
+
+// プレイアウト中の着手生成結果をスレッドごとにキャッシュする
+// ヒット率はアナライザ(MoveCache)で確認できる。効果がはっきりしないので標準ではオフ
+//#define MOVE_CACHE
+
+// 着手生成キャッシュの大きさ(スレッドごと)と、登録する最大着手数
+constexpr int MOVE_CACHE_ENTRIES = 1 << 8;
+constexpr int MOVE_CACHE_MOVES = 64;
+
 // 末端報酬を階級リセットから何試合前まで計算するか
 constexpr int N_REWARD_CALCULATED_GAMES = 32;
 
@@ -55,7 +93,10 @@ constexpr int N_REWARD_CALCULATED_GAMES = 32;
 
 // 置換表設定
 #define USE_L2BOOK // ラスト2人置換表を使う
-//#define USE_LNCIBOOK // 3人以上の完全情報置換表を使う
+constexpr int L2_BOOK_MB = 4; // ラスト2人置換表の大きさ(MB, 起動時に変更可)
+//#define USE_L2TABLEBASE // 手札の少ないラスト2人空場局面の勝敗表を(ファイルがあれば)使う
+#define USE_LNCIBOOK // 3人以上の完全情報置換表を使う
+constexpr int LNCI_BOOK_MB = 4; // 3人以上の完全情報置換表の大きさ(MB)
 
 // プレー関数メインの設定
 #define SEARCH_ROOT_MATE // 必勝探索を行う
@@ -92,12 +133,24 @@ constexpr int N_REWARD_CALCULATED_GAMES = 32;
 using policy_value_t = float;
 //using policy_value_t = double;
 
+// プレイアウト中の方策計算を局面不変値の事前計算と特徴番号列の一括加算で行う
+// 1局面あたりの着手数が少ないため、policy_test では通常版より 1-3% 遅いので標準ではオフ
+//#define FAST_PLAY_POLICY
+// プレイアウト中の方策計算に整数に量子化したパラメータを使う(FAST_PLAY_POLICY のときのみ)
+// ルートでの着手の評価と学習には元の精度のパラメータを使う
+// プレイアウトの分布が変わるうえ、policy_test では float より遅いので標準ではオフ
+//#define QUANTIZED_PLAY_POLICY
+using quantized_policy_value_t = int16_t;
+
 // softmax方策の温度設定
 constexpr double SIMULATION_TEMPERATURE_CHANGE = 1.0;//DBL_MAX;
 constexpr double SIMULATION_TEMPERATURE_PLAY = 1.1;//DBL_MAX;
 // softmaxの増幅パラメータ
 constexpr double SIMULATION_AMPLIFY_COEF = 0.22;
 constexpr double SIMULATION_AMPLIFY_EXPONENT = 2;
+// プレイアウト中のsoftmaxの重み計算に近似指数関数を使う
+// 選択確率の相対誤差は 2e-8 程度 (CppCommon/src/util/selection.hpp を参照)
+#define FAST_SOFTMAX_SAMPLING
 // 方策そのままでプレーするとき
 constexpr double TEMPERATURE_CHANGE = 1;//DBL_MAX;
 constexpr double TEMPERATURE_PLAY = 0;//DBL_MAX;
@@ -118,8 +171,16 @@ enum DealType{
     REJECTION,
 };
 
+// ルートでの探索の打ち切り判定のアルゴリズム
+enum StoppingRule{
+    REGRET, // 時間あたりのリグレットの減少が見合わなくなったら打ち切る
+    RACING, // 信頼区間が最善手と重ならなくなった候補を除外し、1つになったら打ち切る
+    PROB_BEST, // 最善手が最善である確率が十分高くなったら打ち切る
+};
+
 constexpr Selector SIMULATION_SELECTOR = Selector::POLY_BIASED;
 constexpr DealType MONTECARLO_DEAL_TYPE = DealType::REJECTION;
+constexpr StoppingRule ROOT_STOPPING_RULE = StoppingRule::REGRET; // RACING, PROB_BEST は -sr で選択(実験用)
 
 // プレーヤー人数
 #define N_NORMAL_PLAYERS (5)
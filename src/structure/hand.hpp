@@ -26,6 +26,7 @@ namespace UECda{
         
         uint32_t qty; // 総枚数
         uint32_t jk; // ジョーカー枚数
+        mutable bool dirty2ndHalf; // 後半が未計算
         
         Cards p4; // ランク重合型(隣り合ったランク)
         Cards p8; // ランク重合型(一つ飛んだランク)
@@ -33,8 +34,8 @@ namespace UECda{
         
         BitArray64<4, 16> qr; // ランク枚数型
         Cards pqr; // ランク枚数位置型
-        Cards sc; // 圧縮型
-        Cards nd[2]; // 無支配型(通常、革命)
+        mutable Cards sc; // 圧縮型
+        mutable Cards nd[2]; // 無支配型(通常、革命)
         
         uint64_t hash; // ハッシュ値
         
@@ -48,6 +49,10 @@ namespace UECda{
         // その他
         // hash
         
+        // 後半は前半だけの更新をすると未計算の印が付き、getSC(), getND() で読む時に pqr から計算する
+        // 未計算の間は makeMove() も前半だけを更新する
+        // 直接 sc, nd を読む場合は先に prepare2ndHalf() を呼ぶこと
+        
         // (未実装)必勝判定のとき
         // cards, qty, jk, p4, p8, seq, pqrを更新
         // qrは使わなさそう?
@@ -60,9 +65,19 @@ namespace UECda{
         uint32_t getQty()const noexcept{ return qty; }
         uint64_t getHash()const noexcept{ return hash; }
         Cards getPQR()const noexcept{ return pqr; }
-        Cards getSC()const noexcept{ return sc; }
+        Cards getSC()const noexcept{ prepare2ndHalf(); return sc; }
         uint32_t getJKQty()const noexcept{ return jk; }
-        Cards getND(int i)const{ assert(i == 0 || i == 1); return nd[i]; }
+        Cards getND(int i)const{ assert(i == 0 || i == 1); prepare2ndHalf(); return nd[i]; }
+        const Cards* getND()const noexcept{ prepare2ndHalf(); return nd; }
+        
+        void prepare2ndHalf()const noexcept{
+            // 後半が未計算なら前半から計算する
+            if(dirty2ndHalf){
+                sc = PQRToSC(pqr);
+                PQRToND(pqr, jk, nd);
+                dirty2ndHalf = false;
+            }
+        }
         
         constexpr uint64_t containsJOKER()const noexcept{ return ::containsJOKER(cards); }
         constexpr uint64_t containsS3()const noexcept{ return ::containsS3(cards); }
@@ -115,6 +130,7 @@ namespace UECda{
             
             // 無支配ゾーンの初期化はpqrからの変換にて
             PQRToND(pqr, jk, nd);
+            dirty2ndHalf = false;
             
             // チェック
             assert(exam());
@@ -143,6 +159,7 @@ namespace UECda{
                 seq = p4 & p8;
             }
             pqr = QRToPQR(qr);
+            dirty2ndHalf = true;
             
             assert(exam1stHalf());
         }
@@ -169,6 +186,7 @@ namespace UECda{
             p4 = p8 = CARDS_NULL;
             qty = 0;
             jk = 0;
+            dirty2ndHalf = true;
             hash = 0ULL;
         }
         
@@ -245,8 +263,14 @@ namespace UECda{
                     pqr = ((pqr & mask & PQR_234) >> 1) | (pqr & ~mask);
                 }
             }
+            dirty2ndHalf = true;
             assert(exam1stHalf());
         }
+        FORCE_INLINE void makeMove1stHalfAll(Move mv, Cards dc, uint32_t dq, uint64_t dhash)noexcept{
+            makeMove1stHalf(mv, dc, dq);
+            hash ^= dhash;
+            assert(exam_hash());
+        }
         
         FORCE_INLINE void makeMove(const Move mv)noexcept{
             makeMove(mv, mv.cards<_NO>());
@@ -257,6 +281,12 @@ namespace UECda{
         void makeMove(const Move mv, const Cards dc, uint32_t dq)noexcept{
             // 普通、パスやカードが0枚になるときはこの関数には入らない。
             
+            // 後半が未計算なら前半だけ進める
+            if(dirty2ndHalf){
+                makeMove1stHalf(mv, dc, dq);
+                return;
+            }
+            
             // 更新するものは最初にチェック
             assert(exam());
             assert(!mv.isPASS());
@@ -465,6 +495,9 @@ namespace UECda{
         
         void unmakeMove(const Move mv, const Cards dc, uint32_t dq)noexcept{
             // カードが増えない時は入らない
+            // 後半は差分で戻すので計算しておく
+            prepare2ndHalf();
+            
             // 更新するものは最初にチェック
             assert(exam());
             assert(!mv.isPASS());
@@ -746,6 +779,7 @@ namespace UECda{
             return true;
         }
         bool exam_sc()const{
+            if(dirty2ndHalf){ return true; } // 未計算
             for(int r4x = RANK4X_IMG_MIN; r4x <= RANK4X_IMG_MAX; r4x += 4){
                 Cards rc = Rank4xToCards(r4x) & cards;
                 uint32_t rq = countCards(rc);
@@ -784,6 +818,7 @@ namespace UECda{
         bool exam_nd_by_pqr()const{
             // 無支配型をpqrからの変形によって確かめる
             // pqr -> nd は正確と仮定
+            if(dirty2ndHalf){ return true; } // 未計算
             Cards tmpnd[2];
             PQRToND(pqr, ::containsJOKER(cards) ? 1 : 0, tmpnd);
             if(nd[0] != tmpnd[0]){
@@ -943,6 +978,7 @@ namespace UECda{
             dst->qr = arg.qr;
             dst->pqr = arg.pqr;
         }
+        dst->dirty2ndHalf = true;
         assert(dst->exam1stHalf());
     }
     
@@ -956,6 +992,12 @@ namespace UECda{
     void makeMove(const Hand& arg, Hand *const dst, const Move mv, const Cards dc, uint32_t dq)noexcept{
         // 普通、パスやカードが0枚になるときはこの関数には入らない。
         
+        // 後半が未計算なら前半だけ進める
+        if(arg.dirty2ndHalf){
+            makeMove1stHalf(arg, dst, mv, dc, dq);
+            return;
+        }
+        
         // 更新するものは最初にチェック
         assert(arg.exam());
         assert(!mv.isPASS());
@@ -1112,6 +1154,7 @@ namespace UECda{
             dst->pqr = arg.pqr;
             dst->sc = arg.sc;
         }
+        dst->dirty2ndHalf = false;
         assert(dst->exam());
     }
     
@@ -218,29 +218,42 @@ namespace UECda{
         return knitCardsCardsHashKey(ckey0, ckey1) ^ boardKey;
     }
     
+    // 保存したL2置換表が同じハッシュ値の定義で作られたかを確かめるための値
+    // 鍵の表や合成方法が変われば変わるように、実際にいくつかの局面のハッシュ値を合成して作る
+    uint64_t L2HashKeyTag(){
+        uint64_t tag = 0;
+        for(int ic = 0; ic < 64; ++ic){
+            tag = crossBits64(tag, cardsHashKeyTable[ic]);
+        }
+        tag ^= L2NullFieldToHashKey(CARDS_D3 | CARDS_JOKER, CARDS_S3, OrderToNullBoard(ORDER_NORMAL));
+        tag ^= L2NullFieldToHashKey(CARDS_S3, CARDS_D3 | CARDS_JOKER, OrderToNullBoard(ORDER_REVERSED));
+        return tag;
+    }
+    
     /**************************局面:Ln完全情報**************************/
     
     // L2以外で、神視点から局面を見た際のハッシュ値
     // 探索結果の再利用や完全情報仮定しての求解に利用
     
     // L2と同じ構成方法だが、クロスの順番を手番ではなく主観的なものにしたい場合には手番情報などを追加した方が良い
+    // 3人以上では交叉させると1人あたりのビット数が足りず置換表で衝突するので、回転させて重ねる
 
     // すでにハッシュ値が部分的に計算されている場合
     constexpr uint64_t knitHash_L3CI_NF(uint64_t h0, uint64_t h1, uint64_t h2,
                                         Board bd)noexcept{
-        return crossHash(h0, h1, h2) ^ NullBoardToHashKey(bd);
+        return stackHash(h0, h1, h2) ^ NullBoardToHashKey(bd);
     }
     
     constexpr uint64_t knitHash_L4CI_NF(uint64_t h0, uint64_t h1,
                                         uint64_t h2, uint64_t h3,
                                         Board bd)noexcept{
-        return crossHash(h0, h1, h2, h3) ^ NullBoardToHashKey(bd);
+        return stackHash(h0, h1, h2, h3) ^ NullBoardToHashKey(bd);
     }
     
     constexpr uint64_t knitHash_L5CI_NF(uint64_t h0, uint64_t h1, uint64_t h2,
                                         uint64_t h3, uint64_t h4,
                                         Board bd)noexcept{
-        return crossHash(h0, h1, h2, h3, h4) ^ NullBoardToHashKey(bd);
+        return stackHash(h0, h1, h2, h3, h4) ^ NullBoardToHashKey(bd);
     }
     
     
@@ -534,9 +534,7 @@ namespace UECda{
         // set card info
         for(int p = 0; p < N_PLAYERS; ++p){
             Cards c = field.hand[p].cards;
-            field.hand[p].setAll(c);
-            field.opsHand[p].set(subtrCards(CARDS_ALL, c));
-            field.opsHand[p].setHash(HASH_CARDS_ALL ^ field.hand[p].hash);
+            field.setHand(p, c);
             field.addAttractedPlayer(p);
         }
         field.fillRemHand(CARDS_ALL);
@@ -549,7 +547,7 @@ namespace UECda{
             if(field.getPlayerClass(change.from()) >= HINMIN){
                 // subtr present cards
                 field.hand[change.from()].subtrAll(change.cards());
-                field.opsHand[change.from()].addAll(change.cards());
+                field.invalidateOpsHand();
             }else{
                 int ret = changeCallback(field, change.from(), change.to(), change.cards());
                 if(ret <= -2){
@@ -573,9 +571,7 @@ namespace UECda{
         // カード交換が終わった後から棋譜を読み始める時の初期設定
         for(int p = 0; p < N_PLAYERS; ++p){
             Cards tmp = Cards(hand[p]);
-            field.hand[p].setAll(tmp);
-            field.opsHand[p].set(subtrCards(CARDS_ALL, tmp));
-            field.opsHand[p].setHash(HASH_CARDS_ALL ^ field.hand[p].hash);
+            field.setHand(p, tmp);
             field.addAttractedPlayer(p);
         }
         field.fillRemHand(CARDS_ALL);
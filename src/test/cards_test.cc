@@ -7,6 +7,8 @@
 // カード集合の前のランクやスートのテストも含む
 
 #include "../include.h"
+#include "../structure/hand.hpp"
+#include "../generator/moveGenerator.hpp"
 
 using namespace UECda;
 
@@ -347,6 +349,46 @@ int testND(const std::vector<Cards>& sample){
     return 0;
 }
 
+int testHandMakeMove(const std::vector<Cards>& sample){
+    // 手札進行のテスト
+    // 毎回全体を更新する場合と、後半(sc, nd)を読む時まで計算しない場合を比べる
+    uint64_t time[3] = {0};
+    MoveInfo buffer[N_MAX_MOVES];
+    XorShift64 dice(0);
+    for(Cards c : sample){
+        if(!anyCards(c)){ continue; }
+        Hand eager, lazy;
+        eager.setAll(c);
+        lazy.set1stHalf(c);
+        while(1){
+            const int moves = genLead(buffer, eager.getCards());
+            const Move mv = buffer[dice.rand() % moves].mv();
+            const Cards dc = mv.cards<_NO>();
+            if(dc == eager.getCards()){ break; } // 上がりは進行しない
+            
+            cl.start();
+            eager.makeMove(mv, dc, mv.qty());
+            time[0] += cl.restart();
+            lazy.makeMove1stHalf(mv, dc, mv.qty());
+            time[1] += cl.restart();
+            lazy.prepare2ndHalf();
+            time[2] += cl.stop();
+            
+            if(lazy.getCards() != eager.getCards() || lazy.getPQR() != eager.getPQR()
+               || lazy.getSC() != eager.getSC()
+               || lazy.getND(0) != eager.getND(0) || lazy.getND(1) != eager.getND(1)){
+                cerr << "inconsistent lazy Hand after " << mv << endl;
+                cerr << eager.toDebugString() << lazy.toDebugString();
+                return -1;
+            }
+        }
+    }
+    cerr << "hand makeMove           : " << time[0] << " clock" << endl;
+    cerr << "hand makeMove1stHalf    : " << time[1] << " clock" << endl;
+    cerr << "hand prepare2ndHalf     : " << time[2] << " clock" << endl;
+    return 0;
+}
+
 int main(int argc, char* argv[]){
     
     std::vector<Cards> sample;
@@ -423,5 +465,11 @@ int main(int argc, char* argv[]){
     }
     cerr << "passed ENR test." << endl << endl;
     
+    if(testHandMakeMove(sample)){
+        cerr << "failed Hand makeMove test." << endl;
+        return -1;
+    }
+    cerr << "passed Hand makeMove test." << endl << endl;
+    
     return 0;
 }
@@ -0,0 +1,72 @@
+/*
+ l2_tablebase_generator.cc
+ Katsuki Ohto
+ */
+
+// ラスト2人空場局面の勝敗表を作成してファイルに書き出す
+// 使い方: l2_tablebase_generator -n 合計枚数の上限 -o 出力ファイル
+// 出力を思考の入力ディレクトリに l2_tablebase.dat として置くと読み込まれる
+
+#include "../include.h"
+#include "../generator/moveGenerator.hpp"
+#include "../fuji/montecarlo/playout.h"
+#include "../fuji/search/l2Judge.hpp"
+
+using namespace UECda;
+using namespace UECda::Fuji;
+
+MoveInfo buffer[8192];
+
+int main(int argc, char* argv[]){
+    
+    int maxTotal = 4;
+    std::string outputPath = "l2_tablebase.dat";
+    int nodeLimit = 4000000;
+    
+    for(int c = 1; c < argc; ++c){
+        if(!strcmp(argv[c], "-n")){ // max total number of cards
+            maxTotal = atoi(argv[c + 1]);
+        }else if(!strcmp(argv[c], "-o")){ // output path
+            outputPath = std::string(argv[c + 1]);
+        }else if(!strcmp(argv[c], "-nl")){ // node limit of each search
+            nodeLimit = atoi(argv[c + 1]);
+        }
+    }
+    if(maxTotal < 2 || maxTotal > L2TableBase::MAX_TOTAL_LIMIT){
+        cerr << "max total must be in [2, " << L2TableBase::MAX_TOTAL_LIMIT << "]." << endl;
+        return -1;
+    }
+    
+    const uint64_t bytes = L2TableBase::fileBytes(maxTotal);
+    cerr << L2TableBase::positions(maxTotal) << " positions, " << bytes << " bytes." << endl;
+    
+    std::vector<uint8_t> image(bytes);
+    L2TableBase::initImage(image.data(), maxTotal);
+    
+    // 作成中の表を探索から引けるようにする
+    L2::tablebase.attach(image.data(), bytes);
+    
+    ClockMicS clms;
+    clms.start();
+    L2Judge judge(nodeLimit, buffer);
+    const uint64_t unsolved = L2TableBase::generate(image.data(), maxTotal, judge);
+    cerr << "generated in " << clms.stop() / 1000000.0 << " sec. (" << unsolved << " unsolved)" << endl;
+    L2::tablebase.close();
+    
+    std::ofstream ofs(outputPath, std::ios::binary);
+    if(!ofs){
+        cerr << "failed to open " << outputPath << "." << endl;
+        return -1;
+    }
+    ofs.write(reinterpret_cast<const char*>(image.data()), bytes);
+    ofs.close();
+    
+    // 書き出したファイルが読めるか
+    if(!L2::tablebase.load(outputPath)){
+        cerr << "failed to load " << outputPath << "." << endl;
+        return -1;
+    }
+    cerr << "wrote " << outputPath << "." << endl;
+    
+    return 0;
+}
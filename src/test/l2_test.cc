@@ -10,6 +10,7 @@
 #include "../structure/log/minLog.hpp"
 #include "../fuji/montecarlo/playout.h"
 #include "../fuji/search/l2Judge.hpp"
+#include "../fuji/search/l2DfpnJudge.hpp"
 
 using namespace UECda;
 using namespace UECda::Fuji;
@@ -158,12 +159,297 @@ int testRecordL2(const logs_t& mLogs){
     return 0;
 }
 
+template<class logs_t>
+int testReusedL2Judge(const logs_t& mLogs){
+    // スレッドごとに使い回す判定器と置換表で、毎回作る判定器と同じ結果になるか
+    // 同じ局面を2周して、2周目で置換表が効いているかも確認する
+    std::vector<Hand> myHands, oppHands;
+    std::vector<Board> boards;
+    std::vector<FieldAddInfo> fieldInfos;
+    Field field;
+    
+    iterateGameLogAfterChange
+    (field, mLogs,
+     [&](const auto& field){}, // first callback
+     [&](const auto& field, const auto move, const uint64_t time)->int{ // play callback
+         if(field.getNAlivePlayers() == 2){
+             const int turnPlayer = field.getTurnPlayer();
+             const int oppPlayer = field.ps.searchOpsPlayer(turnPlayer);
+             myHands.push_back(field.getHand(turnPlayer));
+             oppHands.push_back(field.getHand(oppPlayer));
+             boards.push_back(field.getBoard());
+             fieldInfos.push_back(field.fieldInfo);
+         }
+         return 0;
+     },
+     [&](const auto& field){}); // last callback
+    
+    const int n = myHands.size();
+    std::vector<int> answer(n);
+    
+#ifdef USE_L2BOOK
+    L2::book.init();
+#endif
+    cl.start();
+    for(int i = 0; i < n; ++i){
+        L2Judge judge(65536, buffer);
+        answer[i] = judge.start_judge(myHands[i], oppHands[i], boards[i], fieldInfos[i]);
+    }
+    const uint64_t newJudgeTime = cl.stop();
+    
+#ifdef USE_L2BOOK
+    L2::book.init();
+    static L2::ThreadBook threadBook;
+    threadBook.init();
+    L2Judge reusedJudge;
+    reusedJudge.set(65536, buffer, &threadBook);
+#else
+    L2Judge reusedJudge(65536, buffer);
+#endif
+    uint64_t reusedJudgeTime[2] = {0};
+    for(int t = 0; t < 2; ++t){
+        cl.start();
+        for(int i = 0; i < n; ++i){
+            const int result = reusedJudge.start_judge(myHands[i], oppHands[i], boards[i], fieldInfos[i]);
+            // ノード数制限で判定できなかった場合は置換表の有無で結果が変わりうる
+            if(result != answer[i] && result != L2_DRAW && answer[i] != L2_DRAW){
+                cerr << "inconsistent L2 judge result " << result << " <-> " << answer[i] << endl;
+                cerr << myHands[i] << oppHands[i] << boards[i] << endl;
+                return -1;
+            }
+        }
+        reusedJudgeTime[t] = cl.stop();
+    }
+    cerr << n << " positions" << endl;
+    cerr << "judge time (new judge)      = " << newJudgeTime / (double)max(n, 1) << endl;
+    cerr << "judge time (reused, 1st)    = " << reusedJudgeTime[0] / (double)max(n, 1) << endl;
+    cerr << "judge time (reused, 2nd)    = " << reusedJudgeTime[1] / (double)max(n, 1) << endl;
+    return 0;
+}
+
+template<class logs_t>
+int testL2TableBase(const logs_t& mLogs, const std::string& tablebasePath){
+    // 小さい勝敗表を作り、全局面が埋まるか(番号付けが全単射か)と探索結果との一致を確認
+    // 勝敗表ファイルが与えられれば、棋譜中の局面の判定時間を勝敗表の有無で比較する
+    constexpr int MAX_TOTAL = 3;
+    std::vector<uint8_t> image(L2TableBase::fileBytes(MAX_TOTAL));
+    L2TableBase::initImage(image.data(), MAX_TOTAL);
+    L2::tablebase.attach(image.data(), image.size());
+    L2Judge generator(300000, buffer);
+    if(L2TableBase::generate(image.data(), MAX_TOTAL, generator)){
+        cerr << "unsolved positions in tablebase" << endl;
+        return -1;
+    }
+    uint64_t filled = 0;
+    for(uint64_t i = sizeof(L2TableBase::Header); i < image.size(); ++i){
+        for(int j = 0; j < 4; ++j){
+            if((image[i] >> (j * 2)) & 3){ ++filled; }
+        }
+    }
+    if(filled != L2TableBase::positions(MAX_TOTAL)){
+        cerr << "tablebase has " << filled << " entries for " << L2TableBase::positions(MAX_TOTAL) << " positions" << endl;
+        return -1;
+    }
+    
+    // 勝敗表を使わない探索と比べる
+    L2TableBase tablebase;
+    tablebase.attach(image.data(), image.size());
+    L2::tablebase.close();
+    for(int i = 0; i < 10000; ++i){
+        const int total = 2 + mt() % (MAX_TOTAL - 1);
+        const int a = 1 + mt() % (total - 1);
+        Cards myCards = CARDS_NULL, opsCards = CARDS_NULL;
+        for(int j = 0; j < total; ++j){
+            Cards c;
+            do{
+                c = L2TableBase::indexBitsToCards(1ULL << (mt() % N_CARDS));
+            }while(c & (myCards | opsCards));
+            if(j < a){ myCards |= c; }else{ opsCards |= c; }
+        }
+        Hand myHand, opsHand;
+        myHand.setAll(myCards);
+        opsHand.setAll(opsCards);
+        const Board bd = OrderToNullBoard(mt() % 2);
+        FieldAddInfo fieldInfo;
+        fieldInfo.init();
+#ifdef USE_L2BOOK
+        L2::book.init();
+#endif
+        L2Judge judge(300000, buffer);
+        const int answer = judge.start_judge(myHand, opsHand, bd, fieldInfo);
+        const int result = tablebase.read(myCards, opsCards, bd);
+        if(result != answer){
+            cerr << "tablebase " << result << " <-> search " << answer << endl;
+            cerr << myHand << opsHand << bd << endl;
+            return -1;
+        }
+    }
+    
+    if(tablebasePath.size()){
+        if(!L2::tablebase.load(tablebasePath)){
+            cerr << "failed to load " << tablebasePath << endl;
+            return -1;
+        }
+        std::vector<int> answer;
+        uint64_t judgeTime[2] = {0};
+        for(int t = 0; t < 2; ++t){
+            if(t == 0){ L2::tablebase.close(); }else{ L2::tablebase.load(tablebasePath); }
+#ifdef USE_L2BOOK
+            L2::book.init();
+#endif
+            int n = 0;
+            Field field;
+            iterateGameLogAfterChange
+            (field, mLogs,
+             [&](const auto& field){}, // first callback
+             [&](const auto& field, const auto move, const uint64_t time)->int{ // play callback
+                 if(field.getNAlivePlayers() == 2){
+                     const int turnPlayer = field.getTurnPlayer();
+                     const int oppPlayer = field.ps.searchOpsPlayer(turnPlayer);
+                     cl.start();
+                     L2Judge judge(65536, buffer);
+                     const int result = judge.start_judge(field.getHand(turnPlayer), field.getHand(oppPlayer),
+                                                          field.getBoard(), field.fieldInfo);
+                     judgeTime[t] += cl.stop();
+                     if(t == 0){
+                         answer.push_back(result);
+                     }else if(result != answer[n] && result != L2_DRAW && answer[n] != L2_DRAW){
+                         cerr << "inconsistent L2 judge result with tablebase" << endl;
+                         return -2;
+                     }
+                     ++n;
+                 }
+                 return 0;
+             },
+             [&](const auto& field){}); // last callback
+        }
+        cerr << "judge time without tablebase = " << judgeTime[0] / (double)max((int)answer.size(), 1) << endl;
+        cerr << "judge time with tablebase    = " << judgeTime[1] / (double)max((int)answer.size(), 1);
+        cerr << " (up to " << L2::tablebase.maxTotal() << " cards)" << endl;
+        L2::tablebase.close();
+    }
+    return 0;
+}
+
+template<class logs_t>
+int testL2Dfpn(const logs_t& mLogs){
+    // 証明数探索の判定が、十分なノード数での深さ優先の判定と一致するか
+    // 深さ優先の判定が小さいノード数制限で打ち切られる局面を、同じくらいのノード数でどれだけ読み切れるかも見る
+    // 時間制限を超えて探索していないか
+    std::vector<Hand> myHands, oppHands;
+    std::vector<Board> boards;
+    std::vector<FieldAddInfo> fieldInfos;
+    Field field;
+    
+    iterateGameLogAfterChange
+    (field, mLogs,
+     [&](const auto& field){}, // first callback
+     [&](const auto& field, const auto move, const uint64_t time)->int{ // play callback
+         if(field.getNAlivePlayers() == 2){
+             const int turnPlayer = field.getTurnPlayer();
+             const int oppPlayer = field.ps.searchOpsPlayer(turnPlayer);
+             myHands.push_back(field.getHand(turnPlayer));
+             oppHands.push_back(field.getHand(oppPlayer));
+             boards.push_back(field.getBoard());
+             fieldInfos.push_back(field.fieldInfo);
+         }
+         return 0;
+     },
+     [&](const auto& field){}); // last callback
+    
+    constexpr int SMALL_LIMIT = 8192;
+    constexpr long TIME_LIMIT = 1000, TIME_SLACK = 1000; // microsec
+    const int n = myHands.size();
+    int hard = 0, dfsSolved = 0, dfpnSolved = 0, overCount = 0;
+    uint64_t dfsTime = 0, dfpnTime = 0;
+    long maxLimitedTime = 0;
+    for(int i = 0; i < n; ++i){
+#ifdef USE_L2BOOK
+        L2::book.init();
+#endif
+        L2Judge judge(1 << 24, buffer);
+        const int answer = judge.start_judge(myHands[i], oppHands[i], boards[i], fieldInfos[i]);
+        
+#ifdef USE_L2BOOK
+        L2::book.init();
+#endif
+        L2::dfpnTable.init();
+        L2DfpnJudge dfpn(1 << 22, buffer);
+        const int result = dfpn.start_judge(myHands[i], oppHands[i], boards[i], fieldInfos[i]);
+        if(result != answer && result != L2_DRAW && answer != L2_DRAW){
+            cerr << "inconsistent L2 df-pn result " << result << " <-> " << answer << endl;
+            cerr << myHands[i] << oppHands[i] << boards[i] << " " << fieldInfos[i] << endl;
+            return -1;
+        }
+        
+        // 小さいノード数制限での比較
+#ifdef USE_L2BOOK
+        L2::book.init();
+#endif
+        L2Judge smallJudge(SMALL_LIMIT, buffer);
+        cl.start();
+        const int dfsResult = smallJudge.start_judge(myHands[i], oppHands[i], boards[i], fieldInfos[i]);
+        const uint64_t t0 = cl.stop();
+        if(dfsResult != L2_DRAW){ continue; }
+        hard += 1;
+        
+#ifdef USE_L2BOOK
+        L2::book.init();
+#endif
+        L2::dfpnTable.init();
+        L2DfpnJudge smallDfpn(SMALL_LIMIT * 16, buffer);
+        L2Judge largeJudge(SMALL_LIMIT * 16, buffer);
+        cl.start();
+        const int dfpnResult = smallDfpn.start_judge(myHands[i], oppHands[i], boards[i], fieldInfos[i]);
+        dfpnTime += cl.stop();
+#ifdef USE_L2BOOK
+        L2::book.init();
+#endif
+        cl.start();
+        const int largeResult = largeJudge.start_judge(myHands[i], oppHands[i], boards[i], fieldInfos[i]);
+        dfsTime += t0 + cl.stop();
+        if(dfpnResult != L2_DRAW){ dfpnSolved += 1; }
+        if(largeResult != L2_DRAW){ dfsSolved += 1; }
+        if(dfpnResult != answer && dfpnResult != L2_DRAW && answer != L2_DRAW){
+            cerr << "inconsistent L2 df-pn result " << dfpnResult << " <-> " << answer << endl;
+            cerr << myHands[i] << oppHands[i] << boards[i] << " " << fieldInfos[i] << endl;
+            return -1;
+        }
+        
+        // 時間制限での打ち切り
+#ifdef USE_L2BOOK
+        L2::book.init();
+#endif
+        L2::dfpnTable.init();
+        L2DfpnJudge limitedDfpn(1 << 30, buffer, TIME_LIMIT);
+        ClockMicS clms;
+        clms.start();
+        limitedDfpn.start_judge(myHands[i], oppHands[i], boards[i], fieldInfos[i]);
+        const long limitedTime = clms.stop();
+        maxLimitedTime = max(maxLimitedTime, limitedTime);
+        if(limitedTime > TIME_LIMIT + TIME_SLACK){ overCount += 1; }
+    }
+    cerr << n << " positions, " << hard << " unsolved in " << SMALL_LIMIT << " nodes" << endl;
+    cerr << "solved in " << SMALL_LIMIT * 16 << " nodes : dfs " << dfsSolved << " (" << dfsTime / (double)max(hard, 1) << " clock)"
+    << " df-pn " << dfpnSolved << " (" << dfpnTime / (double)max(hard, 1) << " clock)" << endl;
+    cerr << "df-pn in " << TIME_LIMIT << " micsec : max " << maxLimitedTime << " micsec, over " << overCount << endl;
+    // 他のプロセスに割り込まれて超えることもあるので、超えた探索の割合で判定する
+    if(overCount * 10 > hard){
+        cerr << "L2 df-pn search exceeded time limit " << TIME_LIMIT << " micsec in " << overCount << " / " << hard << " searches" << endl;
+        return -1;
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]){
     std::vector<std::string> logFileNames;
+    std::string tablebasePath;
     
     for(int c = 1; c < argc; ++c){
         if(!strcmp(argv[c], "-l")){
             logFileNames.push_back(std::string(argv[c + 1]));
+        }else if(!strcmp(argv[c], "-tb")){
+            tablebasePath = std::string(argv[c + 1]);
         }
     }
     mt.seed(1);
@@ -180,5 +466,23 @@ int main(int argc, char* argv[]){
     }
     cerr << "passed record L2 judge test." << endl;
     
+    if(testReusedL2Judge(mLogs)){
+        cerr << "failed reused L2 judge test." << endl;
+        return -1;
+    }
+    cerr << "passed reused L2 judge test." << endl;
+    
+    if(testL2TableBase(mLogs, tablebasePath)){
+        cerr << "failed L2 tablebase test." << endl;
+        return -1;
+    }
+    cerr << "passed L2 tablebase test." << endl;
+    
+    if(testL2Dfpn(mLogs)){
+        cerr << "failed L2 df-pn test." << endl;
+        return -1;
+    }
+    cerr << "passed L2 df-pn test." << endl;
+    
     return 0;
 }
@@ -0,0 +1,264 @@
+/*
+ lnci_test.cc
+ Katsuki Ohto
+ */
+
+// 3人以上の完全情報探索(LnCIJudge)と置換表の動作テスト
+
+#include "../include.h"
+#include "../generator/moveGenerator.hpp"
+#include "../structure/log/minLog.hpp"
+#include "../fuji/montecarlo/playout.h"
+#include "../fuji/search/l2Judge.hpp"
+#include "../fuji/search/lnCIJudge.hpp"
+
+using namespace UECda;
+using namespace UECda::Fuji;
+
+MoveInfo buffer[8192];
+Clock cl;
+std::mt19937 mt;
+XorShift64 dice;
+
+// 階級ごとの報酬
+const uint16_t gameReward[N_PLAYERS] = {400, 300, 200, 100, 0};
+
+void setRandomField(Field *const pfield, const int players, const int totalQty){
+    // ジョーカー無しで totalQty 枚を players 人に配った空場局面を作る
+    Field& field = *pfield;
+    field.init1G();
+    field.setMoveBuffer(buffer);
+    field.setDice(&dice);
+    field.bd = OrderToNullBoard(dice.rand() % 2 ? ORDER_NORMAL : ORDER_REVERSED);
+    field.clearSeats();
+    field.clearClasses();
+    
+    int seatPlayer[N_PLAYERS];
+    for(int p = 0; p < N_PLAYERS; ++p){ seatPlayer[p] = p; }
+    std::shuffle(seatPlayer, seatPlayer + N_PLAYERS, mt);
+    
+    Cards rest = pickNBits64(subtrCards(CARDS_ALL, CARDS_JOKER), totalQty, countCards(CARDS_ALL) - 1 - totalQty, &dice);
+    Cards rem = rest;
+    for(int p = 0; p < N_PLAYERS; ++p){
+        if(p < players){
+            // 最後のプレーヤーに残りを全て渡し、それ以外は1枚以上
+            const int restQty = countCards(rest);
+            const int qty = (p == players - 1) ? restQty : 1 + dice.rand() % (restQty - (players - 1 - p));
+            const Cards c = pickNBits64(rest, qty, restQty - qty, &dice);
+            field.setHand(p, c);
+            rest = subtrCards(rest, c);
+        }else{
+            field.hand[p].init();
+            field.ps.setDead(p);
+        }
+        field.setPlayerClass(p, p);
+        field.setClassPlayer(p, p);
+        field.setPlayerSeat(seatPlayer[p], p);
+        field.setSeatPlayer(p, seatPlayer[p]);
+    }
+    field.setTurnPlayer(0);
+    field.setPMOwner(0);
+    field.setRemHand(rem);
+    field.prepareForPlay();
+}
+
+template<class logs_t>
+void collectFields(const logs_t& mLogs, std::vector<Field> *const pfields, std::vector<BitSet32> *const pconPlayers){
+    // 棋譜中の局面と、ランダムに作った局面を集める
+    // 結果を知りたいプレーヤーは局面ごとに変える
+    std::vector<Field>& fields = *pfields;
+    std::vector<BitSet32>& conPlayers = *pconPlayers;
+    Field field;
+    
+    iterateGameLogAfterChange
+    (field, mLogs,
+     [&](const auto& field){}, // first callback
+     [&](const auto& field, const auto move, const uint64_t time)->int{ // play callback
+         if(field.getNAlivePlayers() >= 3 && field.isLnCISituation()){
+             const int turnPlayer = field.getTurnPlayer();
+             BitSet32 cp;
+             cp.set(turnPlayer);
+             if(fields.size() % 2){ cp.set(field.ps.searchOpsPlayer(turnPlayer)); }
+             fields.push_back(field);
+             conPlayers.push_back(cp);
+         }
+         return 0;
+     },
+     [&](const auto& field){}); // last callback
+    
+    for(int i = 0; i < 3000; ++i){
+        const int players = 3 + i % (N_PLAYERS - 2);
+        setRandomField(&field, players, players + 2 + dice.rand() % (12 - players - 2));
+        BitSet32 cp;
+        cp.set(field.getTurnPlayer());
+        if(i % 2){ cp.set(1 + dice.rand() % (players - 1)); }
+        fields.push_back(field);
+        conPlayers.push_back(cp);
+    }
+}
+
+int testLnCIBook(const std::vector<Field>& fields, const std::vector<BitSet32>& conPlayers){
+    // 置換表を毎回空にした場合と使い回した場合の探索結果が一致するか
+    // 報酬のマスクが正しく働いているかも確かめる
+    const int n = fields.size();
+    std::vector<BitArray64<11, N_PLAYERS>> answer(n);
+    std::vector<int> answerResult(n);
+    
+    uint64_t coldTime = 0, coldNodes = 0;
+    for(int i = 0; i < n; ++i){
+#ifdef USE_LNCIBOOK
+        LnCI::book.init();
+#endif
+        Field f = fields[i];
+        LnCIJudge judge(buffer, gameReward);
+        answer[i] = 0ULL;
+        cl.start();
+        answerResult[i] = judge.start(&answer[i], f, conPlayers[i]);
+        coldTime += cl.stop();
+        coldNodes += judge.nodes;
+    }
+
+#ifdef USE_LNCIBOOK
+    LnCI::book.init();
+#endif
+    uint64_t warmTime[2] = {0}, warmNodes[2] = {0};
+    int failures = 0;
+    for(int t = 0; t < 2; ++t){
+        for(int i = 0; i < n; ++i){
+            Field f = fields[i];
+            LnCIJudge judge(buffer, gameReward);
+            BitArray64<11, N_PLAYERS> reward = 0ULL;
+            cl.start();
+            const int result = judge.start(&reward, f, conPlayers[i]);
+            warmTime[t] += cl.stop();
+            warmNodes[t] += judge.nodes;
+            if(result == -1 || answerResult[i] == -1){
+                if(t == 0){ failures += 1; }
+                continue;
+            }
+            for(int p = 0; p < N_PLAYERS; ++p){
+                if(conPlayers[i].test(p) && reward[p] != answer[i][p]){
+                    cerr << "inconsistent LnCI reward of player " << p << " " << reward << " <-> " << answer[i] << endl;
+                    cerr << f.toDebugString() << endl;
+                    return -1;
+                }
+            }
+        }
+    }
+    cerr << n << " positions (" << failures << " aborted)" << endl;
+    cerr << "search (cleared book) = " << coldTime / (double)max(n, 1) << " clock, " << coldNodes / (double)max(n, 1) << " nodes" << endl;
+    cerr << "search (shared, 1st)  = " << warmTime[0] / (double)max(n, 1) << " clock, " << warmNodes[0] / (double)max(n, 1) << " nodes" << endl;
+    cerr << "search (shared, 2nd)  = " << warmTime[1] / (double)max(n, 1) << " clock, " << warmNodes[1] / (double)max(n, 1) << " nodes" << endl;
+    return 0;
+}
+
+int testLnCIBudget(const std::vector<Field>& fields, const std::vector<BitSet32>& conPlayers){
+    // 節点数や時間の予算を超えて探索していないか
+    // 予算内で読み切れた場合に、十分な予算での結果と一致するか
+    const int n = fields.size();
+    for(const int limit : {20, 60, 200}){
+        int solvedCount = 0, abortCount = 0;
+        uint64_t sumNodes = 0;
+        for(int i = 0; i < n; ++i){
+#ifdef USE_LNCIBOOK
+            LnCI::book.init();
+#endif
+            Field f = fields[i];
+            LnCIJudge full(buffer, gameReward, 1 << 30);
+            BitArray64<11, N_PLAYERS> answer = 0ULL;
+            if(full.start(&answer, f, conPlayers[i]) == -1){
+                cerr << "could not finish LnCI search without budget" << endl;
+                cerr << f.toDebugString() << endl;
+                return -1;
+            }
+#ifdef USE_LNCIBOOK
+            LnCI::book.init();
+#endif
+            LnCIJudge judge(buffer, gameReward, limit);
+            BitArray64<11, N_PLAYERS> reward = 0ULL;
+            const int result = judge.start(&reward, f, conPlayers[i]);
+            sumNodes += judge.nodes;
+            if(judge.nodes > limit + 1){
+                cerr << "LnCI search exceeded node budget " << judge.nodes << " / " << limit << endl;
+                return -1;
+            }
+            if(result == -1){
+                abortCount += 1;
+            }else{
+                solvedCount += 1;
+                for(int p = 0; p < N_PLAYERS; ++p){
+                    if(conPlayers[i].test(p) && reward[p] != answer[p]){
+                        cerr << "inconsistent LnCI reward of player " << p << " " << reward << " <-> " << answer << endl;
+                        cerr << f.toDebugString() << endl;
+                        return -1;
+                    }
+                }
+            }
+        }
+        cerr << "budget " << limit << " nodes : solved " << solvedCount
+        << " aborted " << abortCount << " (" << sumNodes / (double)max(n, 1) << " nodes)" << endl;
+    }
+    
+    // 時間の予算を超えて探索していないか
+    // 時間を確かめるまでの数節点と開始時の準備の分は超えてもよいことにする
+    // 他のプロセスに割り込まれて超えることもあるので、超えた探索の割合で判定する
+    constexpr double TIME_SLACK = 20;
+    for(const long limit : {1L, 20L, 100L}){
+#ifdef USE_LNCIBOOK
+        LnCI::book.init();
+#endif
+        int overCount = 0;
+        double sumTime = 0, maxTime = 0;
+        for(int i = 0; i < n; ++i){
+            Field f = fields[i];
+            ClockMicS clms;
+            clms.start();
+            LnCIJudge judge(buffer, gameReward, 1 << 30, limit);
+            BitArray64<11, N_PLAYERS> reward = 0ULL;
+            judge.start(&reward, f, conPlayers[i]);
+            const double time = clms.stop();
+            sumTime += time;
+            maxTime = max(maxTime, time);
+            if(time > limit + TIME_SLACK){ overCount += 1; }
+        }
+        cerr << "budget " << limit << " micsec : " << sumTime / (double)max(n, 1) << " micsec (max " << maxTime << ")"
+        << " over " << overCount << endl;
+        if(overCount * 100 > n){
+            cerr << "LnCI search exceeded time budget " << limit << " micsec in " << overCount << " / " << n << " searches" << endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    std::vector<std::string> logFileNames;
+    
+    for(int c = 1; c < argc; ++c){
+        if(!strcmp(argv[c], "-l")){
+            logFileNames.push_back(std::string(argv[c + 1]));
+        }
+    }
+    mt.seed(1);
+    dice.srand(1);
+    
+    MinMatchLogAccessor<MinMatchLog<MinGameLog<MinPlayLog>>, 256> mLogs(logFileNames);
+    
+    std::vector<Field> fields;
+    std::vector<BitSet32> conPlayers;
+    collectFields(mLogs, &fields, &conPlayers);
+    
+    if(testLnCIBook(fields, conPlayers)){
+        cerr << "failed LnCI book test." << endl;
+        return -1;
+    }
+    cerr << "passed LnCI book test." << endl;
+    
+    if(testLnCIBudget(fields, conPlayers)){
+        cerr << "failed LnCI budget test." << endl;
+        return -1;
+    }
+    cerr << "passed LnCI budget test." << endl;
+    
+    return 0;
+}
@@ -47,12 +47,10 @@ int outputMateJudgeResult(){
     for(int p = 0; p < N_PLAYERS; ++p){
         if(anyCards(c[p])){
             field.setHand(p, c[p]);
-            field.setOpsHand(p, subtrCards(rem, c[p]));
         }else{
             field.hand[p].qty = 0;
             field.ps.setDead(p);
         }
-        field.setOpsHand(p, subtrCards(rem, c[p]));
         field.setPlayerClass(p, p);
         field.setClassPlayer(p, p);
         field.setPlayerSeat(p, p);
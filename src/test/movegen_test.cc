@@ -14,12 +14,16 @@
 
 #include "../include.h"
 #include "../generator/moveGenerator.hpp"
+#include "../generator/tableMoveGenerator.hpp"
+#include "../generator/moveCache.hpp"
+#include "../generator/stagedMoveGenerator.hpp"
 #include "../structure/log/minLog.hpp"
 #include "../fuji/montecarlo/playout.h"
 
 using namespace UECda;
 
 MoveInfo buffer[8192];
+MoveInfo tableBuffer[8192];
 MoveGenerator<MoveInfo, Cards> mgCards;
 MoveGenerator<MoveInfo, Hand> mgHand;
 Clock cl;
@@ -87,6 +91,131 @@ int testMoveValidity(const move_t *const mv0, const int moves, const field_t& fi
     
 }
 
+int compareMoves(const MoveInfo *const mv0, const int moves0, const MoveInfo *const mv1, const int moves1){
+    // 2つの着手列が並びまで同じか
+    if(moves0 != moves1){ return -1; }
+    for(int i = 0; i < moves0; ++i){
+        if(mv0[i].data() != mv1[i].data()){ return -1; }
+    }
+    return 0;
+}
+
+template<class hand_t>
+int testTableGenerationCase(const hand_t& hand, const Board bd){
+    const int moves = genMove(buffer, hand, bd);
+    const int tableMoves = genMoveByTable(tableBuffer, hand, bd);
+    StagedMoveGenerator staged(Cards(hand), bd);
+    for(int st = 0; st < N_MOVE_STAGES; ++st){
+        // 生成前に分かる着手数が正しいか
+        const int cnt = staged.count(st);
+        const int generated = staged.generate(tableBuffer + tableMoves, st);
+        if(cnt >= 0 && cnt != generated){
+            cerr << "wrong count of stage " << st << " " << cnt << " <-> " << generated;
+            cerr << " " << OutCards(Cards(hand)) << " on " << bd << endl;
+            return -1;
+        }
+    }
+    if(compareMoves(buffer, moves, tableBuffer + tableMoves, staged.generateAll(tableBuffer + tableMoves))){
+        cerr << "different moves by staged generator " << OutCards(Cards(hand)) << " on " << bd << endl;
+        return -1;
+    }
+    if(compareMoves(buffer, moves, tableBuffer, tableMoves)){
+        cerr << "different moves by table generator " << OutCards(Cards(hand)) << " on " << bd << endl;
+        cerr << moves << " :";
+        for(int m = 0; m < moves; ++m){ cerr << " " << buffer[m]; }
+        cerr << endl << tableMoves << " :";
+        for(int m = 0; m < tableMoves; ++m){ cerr << " " << tableBuffer[m]; }
+        cerr << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int testTableGeneration(){
+    // 表引きによる着手生成が通常の着手生成と同じ着手列を返すか
+    // 場は全てのカードから生成されるシングルとグループに、スートしばりとオーダー逆転を加えたもの
+    std::vector<Board> boards;
+    boards.push_back(OrderToNullBoard(ORDER_NORMAL));
+    boards.push_back(OrderToNullBoard(ORDER_REVERSED));
+    const int leads = genLead(buffer, CARDS_ALL);
+    for(int m = 0; m < leads; ++m){
+        const Move mv = buffer[m].mv();
+        if(mv.isSeq() && mv.qty() > 3){ continue; } // 階段は通常の着手生成をそのまま使うので一部のみ
+        for(int lock = 0; lock < 2; ++lock){
+            for(int rev = 0; rev < 2; ++rev){
+                Board bd = MoveToBoard(mv);
+                if(lock){ bd.setExceptOrder(MOVE_FLAG_SUITSLOCK); }
+                if(rev){ bd.flipTmpOrder(); }
+                boards.push_back(bd);
+            }
+        }
+    }
+    
+    // 1ランクのみの手札は全パターン
+    for(int r = RANK_3; r <= RANK_2; ++r){
+        for(uint32_t s = 0; s < 16; ++s){
+            for(int jk = 0; jk < 2; ++jk){
+                const Cards c = RankSuitsToCards(r, s) | (jk ? CARDS_JOKER : CARDS_NULL);
+                for(const Board& bd : boards){
+                    if(testTableGenerationCase(c, bd)){ return -1; }
+                }
+            }
+        }
+    }
+    // ランダムな手札
+    for(int i = 0; i < 2000; ++i){
+        const unsigned int n = 1 + mt() % N_MAX_OWNED_CARDS_PLAY; // 1枚あたりの含まれやすさ
+        Cards c = CARDS_NULL;
+        for(Cards tmp = CARDS_ALL; tmp;){
+            const IntCard ic = popIntCardLow(&tmp);
+            if(mt() % N_CARDS < n){ c |= IntCardToCards(ic); }
+        }
+        if(!anyCards(c)){ continue; }
+        Hand hand;
+        hand.set(c);
+        for(const Board& bd : boards){
+            if(testTableGenerationCase(c, bd)){ return -1; }
+            if(testTableGenerationCase(hand, bd)){ return -1; }
+        }
+    }
+    return 0;
+}
+
+int testMoveCache(const std::vector<std::string>& logs){
+    // 着手生成キャッシュから得た着手列が通常の着手生成と同じか
+    // 棋譜中の局面を2周して、2周目はヒットするようにする
+    MinMatchLogAccessor<MinMatchLog<MinGameLog<MinPlayLog>>, 256> mLogs(logs);
+    auto cache = std::make_unique<MoveCache<1 << 14, 128>>();
+    Field field;
+    
+    for(int i = 0; i < 2; ++i){
+        if(iterateGameLogAfterChange
+           (field, mLogs,
+            [&](const auto& field){}, // first callback
+            [&](const auto& field, const auto move, const uint64_t time)->int{ // play callback
+                int turnPlayer = field.getTurnPlayer();
+                Board bd = field.getBoard();
+                const Hand& hand = field.getHand(turnPlayer);
+                
+                int moves = genMove(buffer, hand.getCards(), bd);
+                int cachedMoves = cache->genMove(tableBuffer, hand.getCards(), CardsToHashKey(hand.getCards()), bd,
+                                                 [](MoveInfo *const mv, const Cards c, const Board bd)->int{
+                                                     return genMove(mv, c, bd);
+                                                 });
+                if(compareMoves(buffer, moves, tableBuffer, cachedMoves)){
+                    cerr << "different moves by cache " << OutCards(hand.getCards()) << " on " << bd << endl;
+                    return -4;
+                }
+                return 0;
+            },
+            [&](const auto& field){} // last callback
+            )){
+               return -1;
+           }
+    }
+    return 0;
+}
+
 int testRecordMoves(const std::vector<std::string>& logs){
     // 棋譜中の局面においてテスト
     MinMatchLogAccessor<MinMatchLog<MinGameLog<MinPlayLog>>, 256> mLogs(logs);
@@ -176,6 +305,51 @@ int testRecordMoves(const std::vector<std::string>& logs){
     cerr << "generation time (cards) = " << genTime[0] / (double)genCount[0] << endl;
     cerr << "generation time (hand)  = " << genTime[1] / (double)genCount[1] << endl;
     
+    // 表引きによる着手生成との比較
+    uint64_t tableTime[2] = {0};
+    uint64_t referenceTime[2] = {0};
+    if(iterateGameLogAfterChange
+       (field, mLogs,
+        [&](const auto& field){}, // first callback
+        [&](const auto& field, const auto move, const uint64_t time)->int{ // play callback
+            int turnPlayer = field.getTurnPlayer();
+            Board bd = field.getBoard();
+            Cards cards = field.getCards(turnPlayer);
+            const Hand& hand = field.getHand(turnPlayer);
+            
+            cl.start();
+            int moves = genMove(buffer, cards, bd);
+            referenceTime[0] += cl.stop();
+            cl.start();
+            int tableMoves = genMoveByTable(tableBuffer, cards, bd);
+            tableTime[0] += cl.stop();
+            if(compareMoves(buffer, moves, tableBuffer, tableMoves)){
+                cerr << "different moves by table generator " << OutCards(cards) << " on " << bd << endl;
+                return -4;
+            }
+            
+            cl.start();
+            moves = genMove(buffer, hand, bd);
+            referenceTime[1] += cl.stop();
+            cl.start();
+            tableMoves = genMoveByTable(tableBuffer, hand, bd);
+            tableTime[1] += cl.stop();
+            if(compareMoves(buffer, moves, tableBuffer, tableMoves)){
+                cerr << "different moves by table generator " << OutCards(hand.getCards()) << " on " << bd << endl;
+                return -4;
+            }
+            return 0;
+        },
+        [&](const auto& field){} // last callback
+        )){
+           cerr << "failed table generation test on record." << endl;
+           return -1;
+       }
+    cerr << "generation time (cards, reference) = " << referenceTime[0] / (double)genCount[0] << endl;
+    cerr << "generation time (cards, table)     = " << tableTime[0] / (double)genCount[0] << endl;
+    cerr << "generation time (hand, reference)  = " << referenceTime[1] / (double)genCount[1] << endl;
+    cerr << "generation time (hand, table)      = " << tableTime[1] / (double)genCount[1] << endl;
+    
     // 着手生成の一貫性
     if(iterateGameLogAfterChange
        (field, mLogs,
@@ -243,11 +417,21 @@ int main(int argc, char* argv[]){
         return -1;
     }
     cerr << "passed case test." << endl;
+    if(testTableGeneration()){
+        cerr << "failed table generation test." << endl;
+        return -1;
+    }
+    cerr << "passed table generation test." << endl;
     if(testRecordMoves(logFileNames)){
         cerr << "failed record moves generation test." << endl;
         return -1;
     }
     cerr << "passed record moves generation test." << endl;
+    if(testMoveCache(logFileNames)){
+        cerr << "failed move cache test." << endl;
+        return -1;
+    }
+    cerr << "passed move cache test." << endl;
     
     return 0;
 }
@@ -21,6 +21,8 @@ XorShift64 dice((unsigned int)time(NULL));
 
 ChangePolicy<policy_value_t> changePolicy;
 PlayPolicy<policy_value_t> playPolicy;
+QuantizedPlayPolicy<int16_t> quantizedPlayPolicy;
+QuantizedPlayPolicy<int8_t> quantized8PlayPolicy;
 
 using namespace UECda::PlayPolicySpace;
 using namespace UECda::ChangePolicySpace;
@@ -153,6 +155,140 @@ int testPlayPolicyWithRecord(const logs_t& mLog){
     return 0;
 }
 
+template<class logs_t>
+int testPlayPolicyFast(const logs_t& mLog){
+    // 高速版の方策計算が通常版と同じ点を出すか確認し、速度を比較
+    int trials = 0;
+    uint64_t time[2] = {0};
+    
+    cerr << "fast play policy : " << endl;
+    
+    Field field;
+    bool failed = false;
+    iterateGameLogAfterChange
+    (field, mLog,
+     [](const auto& field)->void{}, // first callback
+     [&](const auto& field, Move pl, uint32_t tm)->int{ // play callback
+         MoveInfo play[N_MAX_MOVES];
+         double score[2][N_MAX_MOVES];
+         
+         const int turnPlayer = field.getTurnPlayer();
+         const int moves = genMove(play, field.getCards(turnPlayer), field.getBoard());
+         
+         // 他の処理による揺らぎを除くため、交互に何度か測って最小値を取る
+         Clock clock;
+         uint64_t minTime[2] = {UINT64_MAX, UINT64_MAX};
+         for(int j = 0; j < 16; ++j){
+             clock.start();
+             calcPlayPolicyScoreSlow<0>(score[0], play, moves, field, playPolicy);
+             minTime[0] = min(minTime[0], clock.restart());
+             calcPlayPolicyScoreFast(score[1], play, moves, field, playPolicy);
+             minTime[1] = min(minTime[1], clock.stop());
+         }
+         time[0] += minTime[0];
+         time[1] += minTime[1];
+         
+         for(int m = 0; m < moves; ++m){
+             if(fabs(score[0][m] - score[1][m]) > 1e-4 * max(1.0, fabs(score[0][m]))){
+                 cerr << OutCards(field.getCards(turnPlayer)) << " " << field.getBoard() << " " << play[m];
+                 cerr << " slow = " << score[0][m] << " fast = " << score[1][m] << endl;
+                 failed = true;
+                 return -1;
+             }
+         }
+         trials += 1;
+         return 0;
+     },
+     [](const auto& field)->void{}); // last callback
+    
+    if(failed){ return -1; }
+    cerr << "slow : " << time[0] / (double)trials << " clock";
+    cerr << " fast : " << time[1] / (double)trials << " clock" << endl;
+    return 0;
+}
+
+double calcPolicyKLDivergence(const double *const score0, const double *const score1, const int moves, const double temp){
+    // 2つの方策の点から softmax 確率を作り KL(p0 || p1) を計算
+    double maxScore[2] = {-DBL_MAX, -DBL_MAX};
+    for(int m = 0; m < moves; ++m){
+        maxScore[0] = max(maxScore[0], score0[m]);
+        maxScore[1] = max(maxScore[1], score1[m]);
+    }
+    double sum[2] = {0};
+    for(int m = 0; m < moves; ++m){
+        sum[0] += exp((score0[m] - maxScore[0]) / temp);
+        sum[1] += exp((score1[m] - maxScore[1]) / temp);
+    }
+    double kl = 0;
+    for(int m = 0; m < moves; ++m){
+        const double lp0 = (score0[m] - maxScore[0]) / temp - log(sum[0]);
+        const double lp1 = (score1[m] - maxScore[1]) / temp - log(sum[1]);
+        kl += exp(lp0) * (lp0 - lp1);
+    }
+    return kl;
+}
+
+template<class logs_t>
+int testQuantizedPlayPolicy(const logs_t& mLog){
+    // 量子化した方策と元の方策の確率分布の違いと速度を比較
+    int trials = 0;
+    double klSum[2] = {0}, klMax[2] = {0};
+    int sameBest[2] = {0};
+    uint64_t time[2] = {0};
+    
+    cerr << "quantized play policy : " << endl;
+    
+    Field field;
+    iterateGameLogAfterChange
+    (field, mLog,
+     [](const auto& field)->void{}, // first callback
+     [&](const auto& field, Move pl, uint32_t tm)->int{ // play callback
+         MoveInfo play[N_MAX_MOVES];
+         double score[3][N_MAX_MOVES];
+         
+         const int turnPlayer = field.getTurnPlayer();
+         const int moves = genMove(play, field.getCards(turnPlayer), field.getBoard());
+         
+         Clock clock;
+         uint64_t minTime[2] = {UINT64_MAX, UINT64_MAX};
+         for(int j = 0; j < 16; ++j){
+             clock.start();
+             calcPlayPolicyScoreFast(score[0], play, moves, field, playPolicy);
+             minTime[0] = min(minTime[0], clock.restart());
+             calcPlayPolicyScoreFast(score[1], play, moves, field, quantizedPlayPolicy);
+             minTime[1] = min(minTime[1], clock.stop());
+         }
+         time[0] += minTime[0];
+         time[1] += minTime[1];
+         calcPlayPolicyScoreFast(score[2], play, moves, field, quantized8PlayPolicy);
+         
+         const int best = std::max_element(score[0], score[0] + moves) - score[0];
+         for(int i = 0; i < 2; ++i){
+             const double kl = calcPolicyKLDivergence(score[0], score[1 + i], moves, SIMULATION_TEMPERATURE_PLAY);
+             klSum[i] += kl;
+             klMax[i] = max(klMax[i], kl);
+             if(std::max_element(score[1 + i], score[1 + i] + moves) - score[1 + i] == best){
+                 sameBest[i] += 1;
+             }
+         }
+         trials += 1;
+         return 0;
+     },
+     [](const auto& field)->void{}); // last callback
+    
+    const char *const name[2] = {"int16", "int8"};
+    for(int i = 0; i < 2; ++i){
+        cerr << name[i] << " : KL mean = " << klSum[i] / trials << " max = " << klMax[i];
+        cerr << " same best = " << sameBest[i] / (double)trials << endl;
+    }
+    cerr << "float : " << time[0] / (double)trials << " clock";
+    cerr << " int16 : " << time[1] / (double)trials << " clock" << endl;
+    
+    // 16ビットならば確率分布はほぼ変わらないはず
+    if(klSum[0] / trials > 1e-4){ return -1; }
+    return 0;
+}
+
 template<class logs_t>
 int testSelector(const logs_t& mLog){
     // 方策の最終段階の実験
@@ -338,6 +474,8 @@ int main(int argc, char* argv[]){
     
     changePolicy.fin(DIRECTORY_PARAMS_IN + "change_policy_param.dat");
     playPolicy.fin(DIRECTORY_PARAMS_IN + "play_policy_param.dat");
+    quantizedPlayPolicy.set(playPolicy);
+    quantized8PlayPolicy.set(playPolicy);
     
     outputParams();
     
@@ -346,6 +484,14 @@ int main(int argc, char* argv[]){
         
         testChangePolicyWithRecord(mLog);
         testPlayPolicyWithRecord(mLog);
+        if(testPlayPolicyFast(mLog)){
+            cerr << "failed fast play policy test." << endl;
+            return -1;
+        }
+        if(testQuantizedPlayPolicy(mLog)){
+            cerr << "failed quantized play policy test." << endl;
+            return -1;
+        }
         testSelector(mLog);
     }
     